@@ -6,7 +6,10 @@
 #include <set>
 #include <array>
 #include <fstream>
+#include <random>
 #include <cassert>
+#include <cmath>
+#include <chrono>
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/benchmark/catch_benchmark.hpp>
@@ -20,6 +23,9 @@
 #include <pluribus/cluster.hpp>
 #include <pluribus/sampling.hpp>
 #include <pluribus/mccfr.hpp>
+#include <pluribus/profiles.hpp>
+#include <pluribus/calc.hpp>
+#include <pluribus/tree_storage.hpp>
 
 using namespace pluribus;
 using std::string;
@@ -59,6 +65,66 @@ double simple_equity(const std::string& hero_str, const omp::CardRange villain,
 //   };
 // };
 
+TEST_CASE("Showdown utility", "[eval]") {
+  const omp::HandEvaluator eval;
+  const std::vector hands{Hand{"AsQs"}, Hand{"5c5h"}, Hand{"Kh5d"}, Hand{"Ah3d"}, Hand{"9s9h"}, Hand{"QhJd"}};
+  const Board board{"AcTd2h3cQd"};
+  const std::vector chips(hands.size(), 10'000);
+  SlimPokerState state{static_cast<int>(hands.size()), 10'000};
+  while(!state.is_terminal()) state.apply_in_place(Action::CHECK_CALL);
+  const RakeStructure no_rake{0.0, 0};
+
+  // one deal is shared by all showdown terminals of its traversals
+  BENCHMARK("Evaluate hands per showdown, 64 showdowns") {
+    int sum = 0;
+    for(int k = 0; k < 64; ++k) sum += utility(state, k % hands.size(), board, hands, 10'000, no_rake, eval);
+    return sum;
+  };
+  BENCHMARK("Rank hands per deal, 64 showdowns") {
+    const ShowdownRanks ranks{board, hands, eval};
+    int sum = 0;
+    for(int k = 0; k < 64; ++k) sum += utility(state, k % hands.size(), ranks, 10'000, no_rake);
+    return sum;
+  };
+}
+
+TEST_CASE("Regret matching kernels", "[calc]") {
+  const int n_clusters = 200, n_actions = 6;
+  std::vector<int> regrets(n_clusters * n_actions);
+  std::mt19937 rng{42};
+  std::uniform_int_distribution<int> dist{-1'000'000, 1'000'000};
+  for(int& r : regrets) r = dist(rng);
+  std::vector<float> freq(regrets.size());
+
+  BENCHMARK("Scalar regret matching, 200 rows") {
+    for(int c = 0; c < n_clusters; ++c) {
+      float* out = freq.data() + c * n_actions;
+      float sum = 0.0f;
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) sum += out[a_idx] = std::max(static_cast<float>(regrets[c * n_actions + a_idx]), 0.0f);
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) out[a_idx] = sum > 0 ? out[a_idx] / sum : 1.0f / n_actions;
+    }
+    return freq[0];
+  };
+  BENCHMARK("Positive part, 200 rows") {
+    float sum = 0.0f;
+    for(int c = 0; c < n_clusters; ++c) sum += positive_part(regrets.data() + c * n_actions, n_actions, freq.data() + c * n_actions);
+    return sum;
+  };
+  BENCHMARK("Regret matching, 200 rows") {
+    for(int c = 0; c < n_clusters; ++c) regret_matching(regrets.data() + c * n_actions, n_actions, freq.data() + c * n_actions);
+    return freq[0];
+  };
+  BENCHMARK("Row-wise regret matching, 200 rows") {
+    regret_matching_rows(regrets.data(), n_clusters, n_actions, freq.data());
+    return freq[0];
+  };
+  BENCHMARK("Cumulative sampling, 200 rows") {
+    int sum = 0;
+    for(int c = 0; c < n_clusters; ++c) sum += sample_cumulative(freq.data() + c * n_actions, n_actions, 0.7f);
+    return sum;
+  };
+}
+
 TEST_CASE("Isomorphism unindex", "[iso]") {
   hand_indexer_t flop_indexer;
   uint8_t flop_cards[] = {2, 3};
@@ -171,16 +237,212 @@ int call_traverse_mccfr(MCCFRSolver<StorageT>* trainer, const PokerState& state,
 //   };
 // }
 
-TEST_CASE("GSL discrete sampling", "[sampling]") {
+struct TreePath {
+  std::vector<int> action_idxs;
+  std::vector<SlimPokerState> states;
+};
+
+std::vector<TreePath> random_tree_paths(const SlimPokerState& root_state, const ActionProfile& profile, const int n_paths, const int max_depth) {
+  omp::XoroShiro128Plus rng{42};
+  std::vector<TreePath> paths(n_paths);
+  for(TreePath& path : paths) {
+    SlimPokerState state = root_state;
+    for(int d = 0; d < max_depth; ++d) {
+      const std::vector<Action> actions = valid_actions(state, profile);
+      const int a_idx = rng() % actions.size();
+      state.apply_in_place(actions[a_idx]);
+      if(state.is_terminal()) break; // terminal states have no storage node
+      path.action_idxs.push_back(a_idx);
+      path.states.push_back(state);
+    }
+  }
+  return paths;
+}
+
+TEST_CASE("Tree growth contention", "[tree]") {
+  const SolverConfig config{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}};
+  const auto tree_config = std::make_shared<const TreeStorageConfig>(
+      TreeStorageConfig{ClusterSpec{169, 200, 200, 200}, ActionMode::make_blueprint_mode(config.action_profile)});
+  const SlimPokerState root_state{2, 10'000};
+  const std::vector<TreePath> paths = random_tree_paths(root_state, config.action_profile, 1 << 14, 8);
+
+  for(const int n_threads : {1, 8, 64, 128}) {
+    BENCHMARK(std::to_string(n_threads) + " threads, grow tree") {
+      TreeStorageNode<int> root{root_state, tree_config};
+      // every path is walked by several threads, so most new children are raced for
+      #pragma omp parallel for schedule(dynamic, 64) num_threads(n_threads)
+      for(int i = 0; i < 4 * paths.size(); ++i) {
+        const TreePath& path = paths[i % paths.size()];
+        TreeStorageNode<int>* node = &root;
+        for(int d = 0; d < path.action_idxs.size(); ++d) {
+          node = node->apply_index(path.action_idxs[d], path.states[d]);
+        }
+      }
+      return root.get_arena()->bytes_allocated();
+    };
+  }
+}
+
+TEST_CASE("Node action sets", "[tree]") {
+  const SolverConfig config{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}};
+  const ActionMode mode = ActionMode::make_blueprint_mode(config.action_profile);
+  const std::vector<TreePath> paths = random_tree_paths(SlimPokerState{2, 10'000}, config.action_profile, 1 << 12, 8);
+
+  BENCHMARK("Intern valid action vectors") {
+    long sum = 0;
+    for(const TreePath& path : paths) {
+      for(const SlimPokerState& state : path.states) sum += ActionSetPool::get_instance()->intern(valid_actions(state, config.action_profile));
+    }
+    return sum;
+  };
+  BENCHMARK("Cached action set ids") {
+    long sum = 0;
+    for(const TreePath& path : paths) {
+      for(const SlimPokerState& state : path.states) sum += mode.branching_id(state);
+    }
+    return sum;
+  };
+}
+
+TreeStorageNode<float>* grow_scattered_tree(const SlimPokerState& root_state, const std::shared_ptr<const TreeStorageConfig>& tree_config,
+    const std::vector<TreePath>& paths) {
+  auto root = new TreeStorageNode<float>{root_state, tree_config};
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(int i = 0; i < paths.size(); ++i) {
+    TreeStorageNode<float>* node = root;
+    for(int d = 0; d < paths[i].action_idxs.size(); ++d) {
+      node = node->apply_index(paths[i].action_idxs[d], paths[i].states[d]);
+    }
+  }
+  return root;
+}
+
+float strategy_rollouts(const TreeStorageNode<float>* root, const std::vector<TreePath>& paths) {
+  float sum = 0.0f;
+  for(int i = 0; i < paths.size(); ++i) {
+    const TreeStorageNode<float>* node = root;
+    for(const int a_idx : paths[i].action_idxs) {
+      const int n_actions = static_cast<int>(node->get_value_actions().size());
+      sum += calculate_strategy(node->get_row((i * 7919) % node->get_n_clusters()), n_actions)[a_idx % n_actions];
+      node = node->apply_index(a_idx);
+    }
+  }
+  return sum;
+}
+
+TEST_CASE("Compacted strategy rollouts", "[tree]") {
+  const SolverConfig config{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}};
+  const auto tree_config = std::make_shared<const TreeStorageConfig>(
+      TreeStorageConfig{ClusterSpec{169, 200, 200, 200}, ActionMode::make_blueprint_mode(config.action_profile)});
+  const SlimPokerState root_state{2, 10'000};
+  const std::vector<TreePath> paths = random_tree_paths(root_state, config.action_profile, 1 << 16, 8);
+
+  const std::unique_ptr<TreeStorageNode<float>> scattered{grow_scattered_tree(root_state, tree_config, paths)};
+  BENCHMARK("Scattered tree, rollouts") {
+    return strategy_rollouts(scattered.get(), paths);
+  };
+  for(const auto& [layout, name] : {std::pair{TreeLayout::DFS, "DFS"}, std::pair{TreeLayout::VEB, "vEB"}}) {
+    const std::unique_ptr<TreeStorageNode<float>> compacted{grow_scattered_tree(root_state, tree_config, paths)};
+    compacted->compact(layout);
+    BENCHMARK(std::string{name} + " compacted tree, rollouts") {
+      return strategy_rollouts(compacted.get(), paths);
+    };
+  }
+}
+
+// mean total variation distance between the root strategies of two solvers, preflop roots have 169 clusters
+double root_strategy_distance(const TreeStorageNode<int>* a, const TreeStorageNode<int>* b, const int n_clusters = 169) {
+  const int n_actions = a->get_value_actions().size();
+  double dist = 0.0;
+  for(int c = 0; c < n_clusters; ++c) {
+    const std::vector<float> freq_a = calculate_strategy(a->get_row(c), n_actions);
+    const std::vector<float> freq_b = calculate_strategy(b->get_row(c), n_actions);
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) dist += 0.5 * std::abs(freq_a[a_idx] - freq_b[a_idx]);
+  }
+  return dist / n_clusters;
+}
+
+std::unique_ptr<TreeBlueprintSolver> train_heads_up(const uint64_t seed, const bool baselines, const long iterations) {
+  auto trainer = std::make_unique<TreeBlueprintSolver>(SolverConfig{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}});
+  trainer->set_seed(seed);
+  trainer->set_baselines(baselines);
+  trainer->solve(iterations);
+  return trainer;
+}
+
+// A/B of VR-MCCFR baselines: the disagreement of two independently seeded runs measures the sampling variance of the strategy
+TEST_CASE("Variance reduced MCCFR", "[mccfr]") {
+  constexpr long iterations = 500'000;
+  for(const bool baselines : {false, true}) {
+    const auto run_a = train_heads_up(42, baselines, iterations);
+    const auto run_b = train_heads_up(1337, baselines, iterations);
+    std::cout << (baselines ? "With" : "Without") << " baselines, root strategy distance between seeds after " << iterations
+              << " iterations: " << root_strategy_distance(run_a->get_strategy(), run_b->get_strategy()) << "\n";
+  }
+  BENCHMARK("Without baselines, 20k iterations") {
+    return train_heads_up(42, false, 20'000)->get_iteration();
+  };
+  BENCHMARK("With baselines, 20k iterations") {
+    return train_heads_up(42, true, 20'000)->get_iteration();
+  };
+}
+
+// Heads up river subgame after checks on every street, solved to showdown so that it doesn't need a blueprint. Solves in chunks until the wall
+// time is up, because an interrupted solve doesn't count the iterations of its last step.
+std::unique_ptr<TreeRealTimeSolver> solve_river(const uint64_t seed, const int task_depth, const std::chrono::milliseconds wall_time) {
+  SolverConfig config{PokerConfig{2, 0, false}, HeadsUpLiveProfile{}};
+  const std::vector checks(6, Action::CHECK_CALL);
+  config.init_board = str_to_cards("AcTd2h3cQs");
+  config.init_state = config.init_state.apply(ActionHistory{checks});
+  RealTimeSolverConfig rt_config;
+  rt_config.init_actions = checks;
+  rt_config.terminal_round = 4;
+  rt_config.terminal_bet_level = 999;
+  rt_config.task_depth = task_depth;
+  auto solver = std::make_unique<TreeRealTimeSolver>(config, rt_config);
+  solver->set_seed(seed);
+  const auto t_0 = std::chrono::steady_clock::now();
+  while(std::chrono::steady_clock::now() - t_0 < wall_time) solver->solve(50'000);
+  return solver;
+}
+
+// Real time solves are bounded by wall time, so task mode is only worth its scheduling overhead if idle threads steal enough subtrees. Compares
+// iterations per second and how far the root strategies of two seeds still disagree after the same wall time.
+TEST_CASE("Real time task parallel traversal", "[realtime]") {
+  constexpr std::chrono::seconds wall_time{10};
+  for(const int task_depth : {0, 2}) {
+    const auto t_0 = std::chrono::steady_clock::now();
+    const auto run_a = solve_river(42, task_depth, wall_time);
+    const auto run_b = solve_river(1337, task_depth, wall_time);
+    // the last chunk of each solve overruns the wall time
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t_0).count();
+    // combos blocked by the board are never sampled and agree trivially
+    std::cout << "Task depth " << task_depth << ": " << static_cast<long>((run_a->get_iteration() + run_b->get_iteration()) / seconds)
+              << " it/s, root strategy distance between seeds after " << wall_time.count() << " s: "
+              << root_strategy_distance(run_a->get_strategy(), run_b->get_strategy(), MAX_COMBOS) << "\n";
+  }
+}
+
+TEST_CASE("Discrete sampling", "[sampling]") {
   auto sparse_range = PokerRange();
   sparse_range.add_hand(Hand{"AcAh"}, 0.5);
   sparse_range.add_hand(Hand{"AcKh"}, 1.0);
   sparse_range.add_hand(Hand{"2c2h"}, 0.25);
-  GSLDiscreteDist dist{sparse_range.weights()};
+  const std::vector<double>& weights = sparse_range.weights();
+  const std::shared_ptr<gsl_ran_discrete_t> gsl_dist{gsl_ran_discrete_preproc(weights.size(), weights.data()), gsl_ran_discrete_free};
+  DiscreteDist dist{weights};
 
-  double sum = 0.0;
-  BENCHMARK("Sample") {
-    HoleCardIndexer::get_instance()->hand(dist.sample());
+  BENCHMARK("Sample, GSL") {
+    return HoleCardIndexer::get_instance()->hand(gsl_ran_discrete(GSLGlobalRNG::instance(), gsl_dist.get()));
+  };
+  BENCHMARK("Sample, alias table") {
+    return HoleCardIndexer::get_instance()->hand(dist.sample());
+  };
+  BENCHMARK("Uniform, GSL") {
+    return GSLGlobalRNG::uniform();
+  };
+  BENCHMARK("Uniform, XoroShiro128+") {
+    return FastRNG::uniform();
   };
 }
 
@@ -216,6 +478,25 @@ TEST_CASE("Round sampling", "[sampling]") {
   }
 }
 
+TEST_CASE("Deal generation", "[sampling]") {
+  MarginalRejectionSampler sampler{std::vector(6, PokerRange::full())};
+  const auto cluster = [](const int r, const Board& board, const Hand& hand, CachedIndexer& indexer) {
+    return BlueprintClusterMap::get_instance()->cluster(r, indexer.index(board, hand, r));
+  };
+  DealBuffer single{1};
+  DealBuffer deals{32};
+  BENCHMARK("Deal and cluster per iteration, 64 deals") {
+    int sum = 0;
+    for(int k = 0; k < 64; ++k) sum += single.next(sampler, {}, 0, cluster).clusters[3][0];
+    return sum;
+  };
+  BENCHMARK("Deal and cluster in blocks, 64 deals") {
+    int sum = 0;
+    for(int k = 0; k < 64; ++k) sum += deals.next(sampler, {}, 0, cluster).clusters[3][0];
+    return sum;
+  };
+}
+
 TEST_CASE("Fast uniform int sampling (OMP)", "[sampling]") {
   omp::XoroShiro128Plus rng{std::random_device{}()};
   omp::FastUniformIntDistribution<unsigned,21> dist(0, MAX_COMBOS - 1);
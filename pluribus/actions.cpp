@@ -136,6 +136,19 @@ const std::vector<Action>& ActionProfile::get_actions(const SlimPokerState& stat
   return get_actions_raw(state.get_round(), state.get_bet_level(), state.get_active(), state.is_in_position(state.get_active()));
 }
 
+uint32_t ActionProfile::get_actions_key(const SlimPokerState& state) const {
+  const bool in_position = state.is_in_position(state.get_active());
+  if(can_isolate(state)) {
+    const int iso_idx = std::min(static_cast<int>(state.get_active()), static_cast<int>(_iso_actions.size()) - 1);
+    return 1U << 24 | iso_idx << 1 | static_cast<int>(in_position);
+  }
+  const int round = state.get_round();
+  const int level_idx = std::min(static_cast<int>(state.get_bet_level()), static_cast<int>(_profile[round].size()) - 1);
+  const int pos_idx = std::min(static_cast<int>(state.get_active()), static_cast<int>(_profile[round][level_idx].size()) - 1);
+  const int ip_idx = _profile[round][level_idx][pos_idx].size() == 1 ? 0 : static_cast<int>(in_position);
+  return round << 16 | level_idx << 8 | pos_idx << 1 | ip_idx;
+}
+
 std::unordered_set<Action> ActionProfile::all_actions() const {
   std::unordered_set<Action> actions;
   for(auto& round : _profile) {
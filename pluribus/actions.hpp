@@ -87,6 +87,8 @@ public:
   const std::vector<Action>& get_actions_raw(int round, int bet_level, int pos, bool in_position) const;
   const std::vector<Action>& get_iso_actions(int pos, bool in_position) const;
   const std::vector<Action>& get_actions(const SlimPokerState& state) const;
+  // identifies the profile entry returned by get_actions, states with equal keys have the same list of actions
+  uint32_t get_actions_key(const SlimPokerState& state) const;
   const ProfileStorage& get_raw_profile() const { return _profile; }
   int n_bet_levels(const int round) const { return static_cast<int>(_profile[round].size()); }
   std::unordered_set<Action> all_actions() const;
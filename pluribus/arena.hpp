@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <omp.h>
+#include <pluribus/concurrency.hpp>
+
+namespace pluribus {
+
+constexpr size_t align_up(const size_t n, const size_t alignment) {
+  return (n + alignment - 1) & ~(alignment - 1);
+}
+
+// Bump allocator for tree storage. Every OpenMP thread allocates from its own slab cursor, so concurrent tree growth does not contend on malloc.
+// Only a thread's most recent allocation can be rolled back (see release), all other memory is released at once when the arena is destroyed.
+class TreeArena {
+public:
+  explicit TreeArena(const size_t min_slab_bytes = 1UL << 20, const size_t max_slab_bytes = 64UL << 20)
+      : _cursors(std::max(omp_get_max_threads(), 1)), _min_slab_bytes{min_slab_bytes}, _max_slab_bytes{max_slab_bytes} {}
+  ~TreeArena() {
+    for(void* slab : _slabs) std::free(slab);
+  }
+
+  TreeArena(const TreeArena&) = delete;
+  TreeArena& operator=(const TreeArena&) = delete;
+
+  void* allocate(const size_t bytes, const size_t alignment = alignof(std::max_align_t)) {
+    Cursor& cursor = _cursors[omp_get_thread_num() % _cursors.size()];
+    std::lock_guard lock(cursor.lock); // uncontended unless threads outside of an OpenMP team share an arena
+    char* begin = cursor.ptr;
+    char* ptr = reinterpret_cast<char*>(align_up(reinterpret_cast<size_t>(cursor.ptr), alignment));
+    if(!cursor.ptr || ptr + bytes > cursor.end) {
+      const size_t slab_bytes = std::max(bytes + alignment, std::min(std::max(cursor.next_slab_bytes, _min_slab_bytes), _max_slab_bytes));
+      cursor.ptr = new_slab(slab_bytes);
+      cursor.end = cursor.ptr + slab_bytes;
+      cursor.next_slab_bytes = slab_bytes * 2;
+      cursor.reserved += slab_bytes;
+      begin = cursor.ptr;
+      ptr = reinterpret_cast<char*>(align_up(reinterpret_cast<size_t>(cursor.ptr), alignment));
+    }
+    cursor.allocated += ptr + bytes - begin;
+    cursor.last = begin;
+    cursor.ptr = ptr + bytes;
+    return ptr;
+  }
+
+  // Moves the calling thread's cursor to a new slab of exactly the given size, e.g. for a tree of known size. The rest of the current slab is
+  // abandoned, later slabs follow the regular size schedule.
+  void reserve(const size_t bytes) {
+    Cursor& cursor = _cursors[omp_get_thread_num() % _cursors.size()];
+    std::lock_guard lock(cursor.lock);
+    cursor.ptr = new_slab(bytes);
+    cursor.end = cursor.ptr + bytes;
+    cursor.last = nullptr;
+    cursor.reserved += bytes;
+  }
+
+  // Returns the most recent allocation of the calling thread to its slab, including its alignment padding. Any other block is left in place until
+  // the arena is destroyed.
+  bool release(void* ptr, const size_t bytes) {
+    Cursor& cursor = _cursors[omp_get_thread_num() % _cursors.size()];
+    std::lock_guard lock(cursor.lock);
+    if(!cursor.last || static_cast<char*>(ptr) + bytes != cursor.ptr) return false;
+    cursor.allocated -= cursor.ptr - cursor.last;
+    cursor.ptr = cursor.last;
+    cursor.last = nullptr;
+    return true;
+  }
+
+  size_t bytes_allocated() const {
+    size_t sum = 0;
+    for(const Cursor& cursor : _cursors) sum += cursor.allocated;
+    return sum;
+  }
+
+  size_t bytes_reserved() const {
+    size_t sum = 0;
+    for(const Cursor& cursor : _cursors) sum += cursor.reserved;
+    return sum;
+  }
+
+private:
+  struct alignas(64) Cursor {
+    SpinLock lock;
+    char* ptr = nullptr;
+    char* end = nullptr;
+    char* last = nullptr; // cursor position before the most recent allocation, until it is released
+    size_t next_slab_bytes = 0;
+    size_t allocated = 0;
+    size_t reserved = 0;
+  };
+
+  char* new_slab(const size_t bytes) {
+    void* slab = std::malloc(bytes);
+    if(!slab) throw std::bad_alloc{};
+    std::lock_guard lock(_slab_mtx);
+    _slabs.push_back(slab);
+    return static_cast<char*>(slab);
+  }
+
+  std::vector<Cursor> _cursors;
+  std::vector<void*> _slabs;
+  std::mutex _slab_mtx;
+  size_t _min_slab_bytes;
+  size_t _max_slab_bytes;
+};
+
+}
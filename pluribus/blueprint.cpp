@@ -3,6 +3,8 @@
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <mutex>
+#include <omp.h>
 #include <vector>
 #include <cereal/cereal.hpp>
 #include <cereal/types/unordered_map.hpp>
@@ -15,6 +17,7 @@
 #include <pluribus/profiles.hpp>
 #include <pluribus/range_viewer.hpp>
 #include <pluribus/rng.hpp>
+#include <pluribus/tree_visitor.hpp>
 #include <pluribus/util.hpp>
 #include <sys/sysinfo.h>
 
@@ -54,40 +57,66 @@ std::vector<size_t> _collect_base_indexes(const TreeStorageNode<T>& strategy) {
   return base_idxs;
 }
 
+// Collects tree nodes in one buffer per thread. A buffer is saved to the next buffer file once it exceeds its thread's share of max_bytes.
 template<class T>
-void serialize_buffer(const std::string& buffer_prefix, BlueprintBuffer<T>& buffer, int& buf_idx, std::vector<std::string>& buffer_fns) {
-  Logger::log("Saving buffer " + std::to_string(buf_idx) + "...");
-  const std::string fn = buffer_prefix + std::to_string(buf_idx++) + ".bin";
-  buffer_fns.push_back(fn);
-  cereal_save(buffer, fn);
-  Logger::log("Saved buffer " + std::to_string(buf_idx - 1) + " successfully.");
-  buffer = BlueprintBuffer<T>{};
-}
-
-void tree_to_lossless_buffers(const TreeStorageNode<int>* node, const ActionHistory& history, const std::filesystem::path& buffer_dir,
-    const long long max_bytes, long long& curr_bytes, BlueprintBuffer<float>& buffer, int& buf_idx, std::vector<std::string>& buffer_fns) {
-  std::vector<float> values(node->get_n_values(), 0.0);
-  for(int c = 0; c < node->get_n_clusters(); ++c) {
-    const std::atomic<int>* base_ptr = node->get(c, 0);
-    auto freq = calculate_strategy(base_ptr, static_cast<int>(node->get_value_actions().size()));
-    for(int a_idx = 0; a_idx < node->get_value_actions().size(); ++a_idx) {
-      values[node_value_index(static_cast<int>(node->get_value_actions().size()), c, a_idx)] = freq[a_idx];
-    }
+class BufferWriter {
+public:
+  BufferWriter(const std::string& buffer_prefix, const long long max_bytes, int& buf_idx, std::vector<std::string>& buffer_fns)
+      : _prefix{buffer_prefix}, _max_bytes{max_bytes / omp_get_max_threads()}, _buf_idx{buf_idx}, _buffer_fns{buffer_fns} {}
+
+  // thread safe
+  void add(const ActionHistory& history, std::vector<T>&& values) {
+    LocalBuffer& local = _buffers.local();
+    local.bytes += static_cast<long long>(history.size() * sizeof(Action) + values.size() * sizeof(T));
+    local.buffer.entries.emplace_back(history, std::move(values));
+    if(local.bytes > _max_bytes) save(local);
   }
-  buffer.entries.emplace_back(history, values);
-  curr_bytes += static_cast<long long>(history.size() * sizeof(Action) + values.size() * sizeof(float));
-  if(curr_bytes > max_bytes) {
-    serialize_buffer((buffer_dir / "lossless_buf_").string(), buffer, buf_idx, buffer_fns);
-    curr_bytes = 0LL;
+
+  void flush() {
+    _buffers.for_each([this](LocalBuffer& local) {
+      if(!local.buffer.entries.empty()) save(local);
+    });
   }
 
-  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
-    if(node->is_allocated(a_idx)) {
-      ActionHistory next_history = history;
-      next_history.push_back(node->get_branching_actions()[a_idx]);
-      tree_to_lossless_buffers(node->apply_index(a_idx), next_history, buffer_dir, max_bytes, curr_bytes, buffer, buf_idx, buffer_fns);
+private:
+  struct LocalBuffer {
+    BlueprintBuffer<T> buffer;
+    long long bytes = 0LL;
+  };
+
+  void save(LocalBuffer& local) {
+    std::string fn;
+    {
+      std::lock_guard lock{_mutex};
+      fn = _prefix + std::to_string(_buf_idx++) + ".bin";
+      _buffer_fns.push_back(fn);
     }
+    Logger::log("Saving buffer " + fn + "...");
+    cereal_save(local.buffer, fn);
+    Logger::log("Saved buffer " + fn + " successfully.");
+    local = LocalBuffer{};
   }
+
+  std::string _prefix;
+  long long _max_bytes;
+  int& _buf_idx;
+  std::vector<std::string>& _buffer_fns;
+  PerThread<LocalBuffer> _buffers;
+  std::mutex _mutex;
+};
+
+void tree_to_lossless_buffers(const TreeStorageNode<int>* root, const ActionHistory& root_history, BufferWriter<float>& writer) {
+  TreeVisitor<const TreeStorageNode<int>> visitor;
+  visitor.track_history(root_history)->set_pre([&writer](const TreeStorageNode<int>* node, const auto& info) {
+    const int n_actions = node->get_value_actions().size();
+    std::vector<float> values(node->get_n_values(), 0.0);
+    for(int c = 0; c < node->get_n_clusters(); ++c) {
+      calculate_strategy_in_place(node->get_regret_row(c), n_actions, values.data() + node_value_index(n_actions, c, 0));
+    }
+    writer.add(*info.history, std::move(values));
+    return true;
+  });
+  visitor.visit(root);
 }
 
 long long compute_max_bytes(const double max_gb) {
@@ -114,7 +143,7 @@ LosslessMetadata build_lossless_buffers(const std::string& preflop_fn, const std
   for(int bp_idx = 0; bp_idx < all_fns.size(); ++bp_idx) {
     Logger::log("Loading blueprint " + std::to_string(bp_idx) + "...");
     TreeBlueprintSolver bp;
-    cereal_load(bp, all_fns[bp_idx]);
+    bp.load_snapshot(all_fns[bp_idx]);
     meta.n_iterations = std::max(bp.get_iteration(), meta.n_iterations);
     const TreeStorageNode<int>* tree_root = bp.get_strategy();
     if(bp_idx == 0) {
@@ -126,13 +155,9 @@ LosslessMetadata build_lossless_buffers(const std::string& preflop_fn, const std
     }
 
     Logger::log("Storing tree as buffers...");
-    long long curr_bytes = 0LL;
-    BlueprintBuffer<float> buffer;
-    tree_to_lossless_buffers(tree_root, meta.config.init_state.get_action_history(), buffer_dir, compute_max_bytes(max_gb), curr_bytes, buffer, buf_idx,
-      meta.buffer_fns);
-    if(!buffer.entries.empty()) {
-      serialize_buffer((buffer_dir / "lossless_buf_").string(), buffer, buf_idx, meta.buffer_fns);
-    }
+    BufferWriter<float> writer{(buffer_dir / "lossless_buf_").string(), compute_max_bytes(max_gb), buf_idx, meta.buffer_fns};
+    tree_to_lossless_buffers(tree_root, meta.config.init_state.get_action_history(), writer);
+    writer.flush();
   }
   Logger::log("Successfully built lossless buffers.");
   return meta;
@@ -154,7 +179,7 @@ LosslessMetadata collect_meta_data(const std::string& preflop_buf_fn, const std:
   }
   Logger::log("Buffer filenames: " + std::to_string(meta.buffer_fns.size()));
   TreeBlueprintSolver final_bp;
-  cereal_load(final_bp, final_bp_fn);
+  final_bp.load_snapshot(final_bp_fn);
   set_meta_config(meta, final_bp);
   meta.n_iterations = final_bp.get_iteration();
   return meta;
@@ -174,46 +199,46 @@ void LosslessBlueprint::build_cached(const std::string& preflop_buf_fn, const st
   build_from_meta_data(metadata, preflop);
 }
 
-void set_preflop_strategy(TreeStorageNode<float>* node, const TreeStorageNode<float>* preflop_node, const PokerState& state) {
-  if(state.get_round() > 0) return;
-  if(node->get_n_values() != preflop_node->get_n_values()) {
-    Logger::error("Preflop strategy size mismatch. Strategy values=" + std::to_string(node->get_n_values()) +
-      ", Preflop values=" + std::to_string(node->get_n_values()));
-  }
-  if(node->get_branching_actions() != preflop_node->get_branching_actions()) {
-    Logger::error("Preflop branching actions mismatch. Strategy actions=" + std::to_string(node->get_branching_actions().size()) +
-      ", Preflop actions=" + std::to_string(node->get_branching_actions().size()));
-  }
-  for(int v_idx = 0; v_idx < preflop_node->get_n_values(); ++v_idx) {
-    node->get_by_index(v_idx)->store(preflop_node->get_by_index(v_idx)->load());
-  }
-  for(int a_idx = 0; a_idx < preflop_node->get_branching_actions().size(); ++a_idx) {
-    PokerState next_state = state.apply(preflop_node->get_branching_actions()[a_idx]);
-    if(node->is_allocated(a_idx) != preflop_node->is_allocated(a_idx)) {
-      if(next_state.get_round() == 0) {
-        Logger::error("Preflop allocation mismatch for action " + preflop_node->get_branching_actions()[a_idx].to_string() + ".");
-      }
-    }
-    else if(node->is_allocated(a_idx)) {
-      set_preflop_strategy(node->apply_index(a_idx, next_state), preflop_node->apply_index(a_idx), next_state);
-    }
-  }
+void set_preflop_strategy(TreeStorageNode<float>* root, const TreeStorageNode<float>* preflop_root, const SlimPokerState& init_state) {
+  TreeVisitor<TreeStorageNode<float>, const TreeStorageNode<float>*> visitor;
+  visitor.track_state(init_state)
+      ->set_aux(preflop_root, [](const TreeStorageNode<float>* preflop_node, const int a_idx) {
+        return preflop_node->is_allocated(a_idx) ? preflop_node->apply_index(a_idx) : nullptr;
+      })
+      ->set_pre([](TreeStorageNode<float>* node, const auto& info) {
+        if(info.state->get_round() > 0) return false;
+        const TreeStorageNode<float>* preflop_node = info.aux;
+        if(node->get_n_values() != preflop_node->get_n_values()) {
+          Logger::error("Preflop strategy size mismatch. Strategy values=" + std::to_string(node->get_n_values()) +
+            ", Preflop values=" + std::to_string(preflop_node->get_n_values()));
+        }
+        if(node->get_branching_actions() != preflop_node->get_branching_actions()) {
+          Logger::error("Preflop branching actions mismatch. Strategy actions=" + std::to_string(node->get_branching_actions().size()) +
+            ", Preflop actions=" + std::to_string(preflop_node->get_branching_actions().size()));
+        }
+        for(int v_idx = 0; v_idx < preflop_node->get_n_values(); ++v_idx) {
+          node->get_by_index(v_idx)->store(preflop_node->get_by_index(v_idx)->load());
+        }
+        for(int a_idx = 0; a_idx < preflop_node->get_branching_actions().size(); ++a_idx) {
+          const Action a = preflop_node->get_branching_actions()[a_idx];
+          if(node->is_allocated(a_idx) != preflop_node->is_allocated(a_idx) && info.state->apply_copy(a).get_round() == 0) {
+            Logger::error("Preflop allocation mismatch for action " + a.to_string() + ".");
+          }
+        }
+        return true;
+      });
+  visitor.visit(root);
 }
 
-void normalize_tree(TreeStorageNode<float>* node, const PokerState& state) {
-  for(int c = 0; c < node->get_n_clusters(); ++c) {
-    std::atomic<float>* base_ptr = node->get(c, 0);
-    auto freq = calculate_strategy(base_ptr, static_cast<int>(node->get_value_actions().size()));
-    for(int a_idx = 0; a_idx < node->get_value_actions().size(); ++a_idx) {
-      base_ptr[a_idx].store(freq[a_idx]);
-    }
-  }
-  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
-    if(node->is_allocated(a_idx)) {
-      PokerState next_state = state.apply(node->get_branching_actions()[a_idx]);
-      normalize_tree(node->apply_index(a_idx, next_state), next_state);
-    }
-  }
+void normalize_tree(TreeStorageNode<float>* root) {
+  TreeVisitor<TreeStorageNode<float>> visitor;
+  visitor.set_pre([](TreeStorageNode<float>* node, const auto&) {
+    // normalized in place, the visitor owns the node
+    float* values = raw_values(node->get(0, 0));
+    regret_matching_rows(values, node->get_n_clusters(), static_cast<int>(node->get_value_actions().size()), values);
+    return true;
+  });
+  visitor.visit(root);
 }
 
 void LosslessBlueprint::build_from_meta_data(const LosslessMetadata& meta, const bool preflop) {
@@ -257,28 +282,26 @@ void LosslessBlueprint::build_from_meta_data(const LosslessMetadata& meta, const
   }
 
   Logger::log("Normalizing frequencies...");
-  normalize_tree(get_freq().get(), meta.config.init_state);
+  normalize_tree(get_freq().get());
+  compact();
   Logger::log("Lossless blueprint built.");
 }
 
-void prune_recurse(TreeStorageNode<float>* node, const SlimPokerState& state) {
-  for(const Action a : node->get_branching_actions()) {
-    if(node->is_allocated(a)) {
-      if(state.apply_copy(a).get_round() > 0) {
-        node->prune(a);
-      }
-      else {
-        SlimPokerState next_state = state.apply_copy(a);
-        if(!next_state.is_terminal()) {
-          prune_recurse(node->apply(a, next_state), next_state);
-        }
-      }
+void prune_postflop_subtrees(TreeStorageNode<float>* root, const SlimPokerState& init_state) {
+  TreeVisitor<TreeStorageNode<float>> visitor;
+  visitor.track_state(init_state)->set_pre([](TreeStorageNode<float>* node, const auto& info) {
+    if(info.state->is_terminal()) return false;
+    for(const Action a : node->get_branching_actions()) {
+      if(node->is_allocated(a) && info.state->apply_copy(a).get_round() > 0) node->prune(a);
     }
-  }
+    return true;
+  });
+  visitor.visit(root);
 }
 
 void LosslessBlueprint::prune_postflop() {
-  prune_recurse(get_freq().get(), get_config().init_state);
+  prune_postflop_subtrees(get_freq().get(), get_config().init_state);
+  compact();
 }
 
 std::unordered_map<Action, uint8_t> build_compression_map(const ActionProfile& profile) {
@@ -342,35 +365,25 @@ Action sample_biased(const std::vector<Action>& actions, const std::vector<float
   return actions[dist(GlobalRNG::instance())];
 }
 
-void tree_to_sampled_buffers(const TreeStorageNode<float>* node, const ActionHistory& history, const std::filesystem::path& buffer_dir,
-    const std::unordered_map<Action, uint8_t>& action_to_idx, const std::vector<Action>& biases, const float factor, const long long max_bytes,
-    long long& curr_bytes, BlueprintBuffer<uint8_t>& buffer, int& buf_idx, std::vector<std::string>& buffer_fns) {
-  std::vector<uint8_t> sampled(node->get_n_clusters() * biases.size(), 0);
-  for(int c = 0; c < node->get_n_clusters(); ++c) {
-    const std::atomic<float>* base_ptr = node->get(c, 0);
-    auto freq = calculate_strategy(base_ptr, static_cast<int>(node->get_value_actions().size()));
-    for(int a_idx = 0; a_idx < biases.size(); ++a_idx) {
-      Action sampled_action = sample_biased(node->get_value_actions(), freq, biases[a_idx], factor);
-      auto it = action_to_idx.find(sampled_action);
-      if(it == action_to_idx.end()) Logger::error("Sampled action missing in compression map: " + sampled_action.to_string());
-      sampled[node_value_index(static_cast<int>(biases.size()), c, a_idx)] = it->second;
-    }
-  }
-  buffer.entries.emplace_back(history, sampled);
-  curr_bytes += static_cast<long long>(history.size() * sizeof(Action) + sampled.size() * sizeof(uint8_t));
-  if(curr_bytes > max_bytes) {
-    serialize_buffer((buffer_dir / "sampled_buf_").string(), buffer, buf_idx, buffer_fns);
-    curr_bytes = 0LL;
-  }
-
-  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
-    if(node->is_allocated(a_idx)) {
-      ActionHistory next_history = history;
-      next_history.push_back(node->get_branching_actions()[a_idx]);
-      tree_to_sampled_buffers(node->apply_index(a_idx), next_history, buffer_dir, action_to_idx, biases, factor, max_bytes, curr_bytes, buffer, buf_idx,
-        buffer_fns);
+void tree_to_sampled_buffers(const TreeStorageNode<float>* root, const ActionHistory& root_history,
+    const std::unordered_map<Action, uint8_t>& action_to_idx, const std::vector<Action>& biases, const float factor, BufferWriter<uint8_t>& writer) {
+  TreeVisitor<const TreeStorageNode<float>> visitor;
+  visitor.track_history(root_history)->set_pre([&](const TreeStorageNode<float>* node, const auto& info) {
+    std::vector<uint8_t> sampled(node->get_n_clusters() * biases.size(), 0);
+    std::vector<float> freq(node->get_value_actions().size());
+    for(int c = 0; c < node->get_n_clusters(); ++c) {
+      calculate_strategy_in_place(node->get(c, 0), static_cast<int>(freq.size()), freq.data());
+      for(int a_idx = 0; a_idx < biases.size(); ++a_idx) {
+        Action sampled_action = sample_biased(node->get_value_actions(), freq, biases[a_idx], factor);
+        auto it = action_to_idx.find(sampled_action);
+        if(it == action_to_idx.end()) Logger::error("Sampled action missing in compression map: " + sampled_action.to_string());
+        sampled[node_value_index(static_cast<int>(biases.size()), c, a_idx)] = it->second;
+      }
     }
-  }
+    writer.add(*info.history, std::move(sampled));
+    return true;
+  });
+  visitor.visit(root);
 }
 
 SampledMetadata SampledBlueprint::build_sampled_buffers(const std::string& lossless_bp_fn, const std::string& buf_dir, const double max_gb,
@@ -389,14 +402,10 @@ SampledMetadata SampledBlueprint::build_sampled_buffers(const std::string& lossl
   _idx_to_action = build_decompression_map(action_to_idx);
 
   Logger::log("Storing tree as sampled buffers...");
-  long long curr_bytes = 0LL;
   int buf_idx = 0;
-  BlueprintBuffer<uint8_t> buffer;
-  tree_to_sampled_buffers(bp.get_strategy(), meta.config.init_state.get_action_history(), buffer_dir, action_to_idx, meta.biases, factor,
-    compute_max_bytes(max_gb), curr_bytes, buffer, buf_idx, meta.buffer_fns);
-  if(!buffer.entries.empty()) {
-    serialize_buffer((buffer_dir / "sampled_buf_").string(), buffer, buf_idx, meta.buffer_fns);
-  }
+  BufferWriter<uint8_t> writer{(buffer_dir / "sampled_buf_").string(), compute_max_bytes(max_gb), buf_idx, meta.buffer_fns};
+  tree_to_sampled_buffers(bp.get_strategy(), meta.config.init_state.get_action_history(), action_to_idx, meta.biases, factor, writer);
+  writer.flush();
   Logger::log("Successfully built sampled buffers.");
   return meta;
 }
@@ -447,8 +456,25 @@ void SampledBlueprint::build(const std::string& lossless_bp_fn, const std::strin
       }
     }
   }
+  compact();
   Logger::log("Sampled blueprint built.");
   _bias_to_offset = build_bias_offset_map(meta.config.init_state, bias_profile);
 }
 
+std::string SampledBlueprint::flat_metadata() const {
+  std::ostringstream os;
+  {
+    cereal::BinaryOutputArchive ar(os);
+    ar(get_config(), _idx_to_action, _bias_to_offset);
+  }
+  return os.str();
+}
+
+MappedSampledBlueprint::MappedSampledBlueprint(const std::string& fn, const bool validate_nodes) : MappedBlueprint{fn, validate_nodes} {
+  std::istringstream is{std::string{get_tree().metadata()}};
+  cereal::BinaryInputArchive ar(is);
+  SolverConfig config;
+  ar(config, _idx_to_action, _bias_to_offset);
+}
+
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <sstream>
 #include <string>
 #include <vector>
 #include <cereal/cereal.hpp>
@@ -9,6 +10,7 @@
 #include <pluribus/cereal_ext.hpp>
 #include <pluribus/config.hpp>
 #include <pluribus/debug.hpp>
+#include <pluribus/flat_storage.hpp>
 #include <pluribus/rng.hpp>
 #include <pluribus/sampling.hpp>
 #include <pluribus/tree_storage.hpp>
@@ -39,12 +41,32 @@ public:
   }
   const SolverConfig& get_config() const override { return _config; }
 
+  // Exports the strategy to the flat format, which can be opened without parsing by MappedBlueprint.
+  void save_flat(const std::string& fn) const { write_flat_tree(*get_strategy(), fn, flat_metadata()); }
+
+  // Moves the strategy into one contiguous block (see TreeStorageNode::compact). Built and pruned blueprints are compacted automatically,
+  // loaded blueprints are already laid out in DFS order.
+  void compact(const TreeLayout layout = TreeLayout::DFS) {
+    Logger::log("Compacting strategy tree...");
+    _freq->compact(layout);
+    Logger::log("Compacted strategy tree: " + std::to_string(_freq->get_arena()->bytes_allocated()) + " bytes");
+  }
+
   template <class Archive>
   void serialize(Archive& ar) {
     ar(_freq, _config);
   }
 
 protected:
+  virtual std::string flat_metadata() const {
+    std::ostringstream os;
+    {
+      cereal::BinaryOutputArchive ar(os);
+      ar(_config);
+    }
+    return os.str();
+  }
+
   void assign_freq(TreeStorageNode<T>* freq) { _freq = std::unique_ptr<TreeStorageNode<T>>{freq}; }
   std::unique_ptr<TreeStorageNode<T>>& get_freq() { return _freq; }
   void set_config(const SolverConfig& config) { _config = config; }
@@ -92,6 +114,9 @@ public:
     ar(cereal::base_class<Blueprint>(this), _idx_to_action, _bias_to_offset);
   }
 
+protected:
+  std::string flat_metadata() const override;
+
 private:
   SampledMetadata build_sampled_buffers(const std::string& lossless_bp_fn, const std::string& buf_dir, double max_gb, const ActionProfile& bias_profile,
     float factor);
@@ -100,4 +125,41 @@ private:
   std::unordered_map<Action, int> _bias_to_offset;
 };
 
+// Read-only blueprint backed by a memory mapped flat file, processes mapping the same file share its pages. The traversal viewer and LBR open
+// flat blueprints. Pluribus, the real time solver and the action providers load cereal blueprints: the real time solver walks the blueprint with
+// its own storage node type, so it cannot take a FlatTreeNode without decoupling the two.
+template <class T>
+class MappedBlueprint : public Strategy<T, FlatTreeNode<T>> {
+public:
+  explicit MappedBlueprint(const std::string& fn, const bool validate_nodes = true) : _tree{fn, validate_nodes} {
+    Logger::log("Mapped " + fn + ": " + std::to_string(_tree.n_nodes()) + " nodes");
+    std::istringstream is{std::string{_tree.metadata()}};
+    cereal::BinaryInputArchive ar(is);
+    ar(_config);
+  }
+
+  const FlatTreeNode<T>* get_strategy() const override { return _tree.root(); }
+  const SolverConfig& get_config() const override { return _config; }
+
+protected:
+  const FlatTree<T>& get_tree() const { return _tree; }
+
+private:
+  FlatTree<T> _tree;
+  SolverConfig _config;
+};
+
+using MappedLosslessBlueprint = MappedBlueprint<float>;
+
+class MappedSampledBlueprint : public MappedBlueprint<uint8_t> {
+public:
+  explicit MappedSampledBlueprint(const std::string& fn, bool validate_nodes = true);
+  Action decompress_action(const uint8_t action_idx) const { return _idx_to_action[action_idx]; }
+  int bias_offset(const Action bias) const { return _bias_to_offset.at(bias); }
+
+private:
+  std::vector<Action> _idx_to_action;
+  std::unordered_map<Action, int> _bias_to_offset;
+};
+
 }
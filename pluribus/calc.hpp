@@ -1,58 +1,194 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <type_traits>
 #include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include <pluribus/constants.hpp>
+#include <pluribus/regret_row.hpp>
 #include <pluribus/rng.hpp>
 
 namespace pluribus {
 
-int sample_action_idx(const float freq[], int n_actions);
+// Regret matching kernels over rows of at most MAX_ACTIONS values. The AVX2 versions are only compiled in when the target supports them, i.e.
+// builds configured with cmake -DNATIVE=ON on an AVX2 host. Default builds use the scalar loops, which are also the reference the AVX2 versions
+// are tested against. A row fits into two AVX2 registers. Kernels are inline so that rows of a few actions do not pay for a call.
+
+namespace kernel {
+
+namespace scalar {
+
+template <class T>
+float positive_part(const T* values, const int n, float* out) {
+  float sum = 0.0f;
+  for(int i = 0; i < n; ++i) {
+    out[i] = std::max(static_cast<float>(values[i]), 0.0f);
+    sum += out[i];
+  }
+  return sum;
+}
+
+template <class T>
+void regret_matching(const T* values, const int n, float* out) {
+  const float sum = positive_part(values, n, out);
+  for(int i = 0; i < n; ++i) out[i] = sum > 0 ? out[i] / sum : 1.0f / static_cast<float>(n);
+}
+
+inline int sample_cumulative(const float* weights, const int n, const float threshold) {
+  float cumsum = 0.0f;
+  for(int i = 0; i < n; ++i) {
+    cumsum += weights[i];
+    if(cumsum >= threshold) return i;
+  }
+  return n - 1;
+}
+
+}
+
+#if defined(__AVX2__)
+
+namespace avx2 {
+
+inline __m256i tail_mask(const int remaining) {
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32(remaining), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+template <class T>
+__m256 load_floats(const T* values, const __m256i mask) {
+  if constexpr(std::is_same_v<T, int>) return _mm256_cvtepi32_ps(_mm256_maskload_epi32(values, mask));
+  else return _mm256_maskload_ps(values, mask);
+}
+
+inline float horizontal_sum(const __m256 v) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_movehdup_ps(s));
+  return _mm_cvtss_f32(s);
+}
 
 template <class T>
-std::vector<float> calculate_strategy(const std::atomic<T>* base_ptr, const int n_actions) {
-  std::vector<float> freq;
-  freq.reserve(n_actions);
-  float sum = 0;
-  for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
-    float value = std::max(static_cast<float>(base_ptr[a_idx].load(std::memory_order_relaxed)), 0.0f);
-    freq.push_back(value);
-    sum += value;
+float positive_part(const T* values, const int n, float* out) {
+  __m256 sum = _mm256_setzero_ps();
+  for(int i = 0; i < n; i += 8) {
+    const __m256i mask = tail_mask(n - i);
+    const __m256 v = _mm256_max_ps(load_floats(values + i, mask), _mm256_setzero_ps());
+    _mm256_maskstore_ps(out + i, mask, v);
+    sum = _mm256_add_ps(sum, v);
   }
+  return horizontal_sum(sum);
+}
 
+// rows are loaded and stored once, the positive part stays in two registers
+template <class T>
+void regret_matching(const T* values, const int n, float* out) {
+  const __m256i lo_mask = tail_mask(n), hi_mask = tail_mask(n - 8);
+  const __m256 lo = _mm256_max_ps(load_floats(values, lo_mask), _mm256_setzero_ps());
+  const __m256 hi = _mm256_max_ps(load_floats(values + 8, hi_mask), _mm256_setzero_ps());
+  const float sum = horizontal_sum(_mm256_add_ps(lo, hi));
   if(sum > 0) {
-    for(auto& f : freq) {
-      f /= sum;
-    }
+    const __m256 s = _mm256_set1_ps(sum);
+    _mm256_maskstore_ps(out, lo_mask, _mm256_div_ps(lo, s));
+    _mm256_maskstore_ps(out + 8, hi_mask, _mm256_div_ps(hi, s));
   }
   else {
-    const float uni = 1.0f / static_cast<float>(n_actions);
-    for(auto& f : freq) {
-      f = uni;
-    }
+    const __m256 uni = _mm256_set1_ps(1.0f / static_cast<float>(n));
+    _mm256_maskstore_ps(out, lo_mask, uni);
+    _mm256_maskstore_ps(out + 8, hi_mask, uni);
   }
-  return freq;
 }
 
-template <class T>
-void calculate_strategy_in_place(const std::atomic<T>* base_ptr, const int n_actions, float* buffer_ptr) {
-  float sum = 0;
-  for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
-    const float value = std::max(static_cast<float>(base_ptr[a_idx].load(std::memory_order_relaxed)), 0.0f);
-    buffer_ptr[a_idx] = value;
-    sum += value;
+inline int sample_cumulative(const float* weights, const int n, const float threshold) {
+  const __m256 thresh = _mm256_set1_ps(threshold);
+  __m256 carry = _mm256_setzero_ps();
+  for(int i = 0; i < n; i += 8) {
+    const __m256i mask = tail_mask(n - i);
+    // prefix sum within both 128 bit lanes, then the low lane total is added to the high lane
+    __m256 prefix = _mm256_maskload_ps(weights + i, mask);
+    prefix = _mm256_add_ps(prefix, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(prefix), 4)));
+    prefix = _mm256_add_ps(prefix, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(prefix), 8)));
+    const __m256 low_total = _mm256_permute2f128_ps(_mm256_permute_ps(prefix, 0xFF), prefix, 0x08);
+    prefix = _mm256_add_ps(_mm256_add_ps(prefix, low_total), carry);
+    const __m256 hits = _mm256_and_ps(_mm256_cmp_ps(prefix, thresh, _CMP_GE_OQ), _mm256_castsi256_ps(mask));
+    if(const int bits = _mm256_movemask_ps(hits)) return i + __builtin_ctz(bits);
+    carry = _mm256_permutevar8x32_ps(prefix, _mm256_set1_epi32(7));
   }
+  return n - 1;
+}
 
-  if(sum > 0) {
-    for(int i = 0; i < n_actions; ++i) {
-      buffer_ptr[i] /= sum;
-    }
+}
+
+namespace active = avx2;
+
+#else
+
+namespace active = scalar;
+
+#endif
+
+}
+
+// writes max(v, 0) of every value to out and returns their sum
+inline float positive_part(const int* values, const int n, float* out) { return kernel::active::positive_part(values, n, out); }
+inline float positive_part(const float* values, const int n, float* out) { return kernel::active::positive_part(values, n, out); }
+// normalized positive part, uniform if no value is positive
+inline void regret_matching(const int* values, const int n, float* out) { kernel::active::regret_matching(values, n, out); }
+inline void regret_matching(const float* values, const int n, float* out) { kernel::active::regret_matching(values, n, out); }
+// regret matching of every row of a row major n_rows x n_cols block, e.g. all clusters of a node. out may alias float values.
+template <class T>
+void regret_matching_rows(const T* values, const int n_rows, const int n_cols, float* out) {
+  for(int r = 0; r < n_rows; ++r) kernel::active::regret_matching(values + r * n_cols, n_cols, out + r * n_cols);
+}
+// first index whose prefix sum of weights reaches threshold, n - 1 if none does
+inline int sample_cumulative(const float* weights, const int n, const float threshold) { return kernel::active::sample_cumulative(weights, n, threshold); }
+
+int sample_action_idx(const float freq[], int n_actions);
+
+// Relaxed atomic values are read as plain values by the kernels, the same way snapshots write them as binary data.
+template <class T>
+const T* raw_values(const std::atomic<T>* ptr) {
+  static_assert(sizeof(std::atomic<T>) == sizeof(T) && std::atomic<T>::is_always_lock_free, "Atomic values must be lock free.");
+  return reinterpret_cast<const T*>(ptr);
+}
+template <class T>
+T* raw_values(std::atomic<T>* ptr) { return const_cast<T*>(raw_values(static_cast<const std::atomic<T>*>(ptr))); }
+
+template <class T>
+T load_value(const std::atomic<T>* base_ptr, const int a_idx) { return base_ptr[a_idx].load(std::memory_order_relaxed); }
+inline int load_value(const RegretRow& row, const int a_idx) { return row.load(a_idx); }
+
+template <class Values>
+void calculate_strategy_in_place(const Values& base_ptr, const int n_actions, float* buffer_ptr) {
+  if constexpr(std::is_same_v<Values, RegretRow>) {
+    int buffer[MAX_ACTIONS];
+    regret_matching(base_ptr.values(buffer, n_actions), n_actions, buffer_ptr);
   }
   else {
-    const float uni = 1.0f / static_cast<float>(n_actions);
-    for(int i = 0; i < n_actions; ++i) {
-      buffer_ptr[i] = uni;
+    using T = std::remove_cv_t<std::remove_pointer_t<std::remove_cvref_t<Values>>>;
+    if constexpr(std::is_same_v<T, std::atomic<int>> || std::is_same_v<T, std::atomic<float>>) {
+      regret_matching(raw_values(base_ptr), n_actions, buffer_ptr);
+    }
+    else {
+      float sum = 0;
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+        const float value = std::max(static_cast<float>(load_value(base_ptr, a_idx)), 0.0f);
+        buffer_ptr[a_idx] = value;
+        sum += value;
+      }
+      for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+        buffer_ptr[a_idx] = sum > 0 ? buffer_ptr[a_idx] / sum : 1.0f / static_cast<float>(n_actions);
+      }
     }
   }
 }
 
+template <class Values>
+std::vector<float> calculate_strategy(const Values& base_ptr, const int n_actions) {
+  std::vector<float> freq(n_actions);
+  calculate_strategy_in_place(base_ptr, n_actions, freq.data());
+  return freq;
+}
+
 }
@@ -92,7 +92,8 @@ RealTimeSolverConfig::RealTimeSolverConfig(const RealTimeTimingConfig& timings,
 }
 
 std::string RealTimeSolverConfig::to_string() const {
-  return "Terminal round: " + round_to_str(terminal_round) + ", Terminal bet level: " + std::to_string(terminal_bet_level) + "-bet";
+  return "Terminal round: " + round_to_str(terminal_round) + ", Terminal bet level: " + std::to_string(terminal_bet_level) + "-bet" +
+      ", Task depth: " + std::to_string(task_depth);
 }
 
 void RealTimeSolverConfig::set_iterations(const RealTimeTimingConfig& timings, const long it_per_sec) {
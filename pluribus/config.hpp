@@ -103,7 +103,7 @@ struct RealTimeSolverConfig : DiscountConfig {
 
   template <class Archive>
   void serialize(Archive& ar) {
-    ar(bias_profile, log_interval, terminal_round, terminal_bet_level);
+    ar(bias_profile, log_interval, terminal_round, terminal_bet_level, task_depth);
   }
 
   ActionProfile bias_profile = BiasActionProfile{};
@@ -111,6 +111,8 @@ struct RealTimeSolverConfig : DiscountConfig {
   long log_interval = -1;
   int terminal_round = -1;
   int terminal_bet_level = -1;
+  // traverser nodes above this depth traverse their actions as parallel tasks, 0 traverses sequentially
+  int task_depth = 0;
 };
 
 }
@@ -6,4 +6,5 @@ namespace pluribus {
   static constexpr int MAX_PREFLOP_COMBOS = 169;
   static constexpr int MAX_COMBOS = 1326;
   static constexpr int NUM_DISTINCT_FLOPS = 1755;
+  static constexpr int MAX_ACTIONS = 16;
 }
\ No newline at end of file
@@ -10,8 +10,10 @@ Action LosslessActionProvider::next_action(CachedIndexer& indexer, const PokerSt
   const TreeStorageNode<float>* node = bp->get_strategy()->apply(history);
   const std::atomic<float>* base_ptr = node->get(cluster);
 
-  const auto freq = calculate_strategy(base_ptr, node->get_value_actions().size());
-  return node->get_value_actions()[sample_action_idx(freq.data(), freq.size())];
+  const int n_actions = node->get_value_actions().size();
+  float freq[MAX_ACTIONS];
+  calculate_strategy_in_place(base_ptr, n_actions, freq);
+  return node->get_value_actions()[sample_action_idx(freq, n_actions)];
 }
 
 Action SampledActionProvider::next_action(CachedIndexer& indexer, const PokerState& state, const std::vector<Hand>& hands, const Board& board, const SampledBlueprint* bp) const {
@@ -4,7 +4,9 @@
 #include <pluribus/blueprint.hpp>
 #include <pluribus/calc.hpp>
 #include <pluribus/cluster.hpp>
+#include <pluribus/hash_storage.hpp>
 #include <pluribus/poker.hpp>
+#include <pluribus/static_storage.hpp>
 #include <pluribus/tree_storage.hpp>
 
 namespace pluribus {
@@ -14,12 +16,14 @@ public:
   virtual ~DecisionAlgorithm() = default;
 
   virtual float frequency(Action a, const PokerState& state, const Board& board, const Hand& hand) const = 0;
+  // false if the strategy does not cover the state, e.g. a node that training has not reached yet
+  virtual bool has_strategy(const PokerState& state) const { return true; }
 };
 
-template<class T>
+template<class T, class NodeT = TreeStorageNode<T>>
 class TreeDecision : public DecisionAlgorithm {
 public:
-  TreeDecision(const TreeStorageNode<T>* root, const PokerState& init_state, const bool real_time)
+  TreeDecision(const NodeT* root, const PokerState& init_state, const bool real_time)
       : _init_state{init_state}, _root{root}, _real_time{real_time} {}
 
   float frequency(Action a, const PokerState& state, const Board& board, const Hand& hand) const override {
@@ -27,7 +31,7 @@ public:
       Logger::error("Cannot compute TreeSolver frequency for inconsistent histories:\nInitial state: "
         + _init_state.get_action_history().to_string() + "\nGiven state: " + state.get_action_history().to_string());
     }
-    const TreeStorageNode<T>* node = _root;
+    const NodeT* node = _root;
     for(int i = _init_state.get_action_history().size(); i < state.get_action_history().size(); ++i) {
       node = node->apply(state.get_action_history().get(i));
     }
@@ -36,7 +40,8 @@ public:
             HoleCardIndexer::get_instance()->index(hand) :
             RealTimeClusterMap::get_instance()->cluster(state.get_round(), board, hand)) :
         BlueprintClusterMap::get_instance()->cluster(state.get_round(), board, hand);
-    auto freq = calculate_strategy(node->get(cluster), node->get_value_actions().size());
+    float freq[MAX_ACTIONS];
+    calculate_strategy_in_place(node->get_row(cluster), node->get_value_actions().size(), freq);
     if(std::ranges::find(node->get_value_actions(), a) == node->get_value_actions().end()) {
       std::cout << "Failed to find action: " << a.to_string();
       std::cout << "Value actions:\n";
@@ -49,12 +54,32 @@ public:
     return freq[index_of(a, node->get_value_actions())];
   }
 
+  bool has_strategy(const PokerState& state) const override {
+    const NodeT* node = _root;
+    if(!node) return false;
+    for(int i = _init_state.get_action_history().size(); i < state.get_action_history().size(); ++i) {
+      const Action a = state.get_action_history().get(i);
+      if(!node->is_allocated(a)) return false;
+      node = node->apply(a);
+    }
+    return true;
+  }
+
 private:
   const PokerState _init_state;
-  const TreeStorageNode<T>* _root;
+  const NodeT* _root;
   const bool _real_time;
 };
 
+template<class T>
+TreeDecision(const TreeStorageNode<T>*, const PokerState&, bool) -> TreeDecision<T>;
+template<class T>
+TreeDecision(const FlatTreeNode<T>*, const PokerState&, bool) -> TreeDecision<T, FlatTreeNode<T>>;
+template<class T>
+TreeDecision(const StaticTreeNode<T>*, const PokerState&, bool) -> TreeDecision<T, StaticTreeNode<T>>;
+template<class T>
+TreeDecision(const HashedInfoset<T>*, const PokerState&, bool) -> TreeDecision<T, HashedInfoset<T>>;
+
 template <class BlueprintT>
 class ActionProvider {
 public:
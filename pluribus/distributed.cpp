@@ -0,0 +1,152 @@
+#include <chrono>
+#include <fstream>
+#include <omp.h>
+#include <string>
+#include <thread>
+#include <pluribus/distributed.hpp>
+#include <pluribus/logging.hpp>
+#include <pluribus/util.hpp>
+
+namespace pluribus {
+
+// markers are renamed into place, so they appear atomically
+void write_marker(const std::filesystem::path& marker) {
+  std::ofstream{marker.string() + ".tmp"}.close();
+  std::filesystem::rename(marker.string() + ".tmp", marker);
+}
+
+std::string DistributedConfig::to_string() const {
+  return "Worker: " + std::to_string(worker_idx) + "/" + std::to_string(n_workers) + ", Sync dir: " + sync_dir.string() + ", Run id: " + run_id +
+      ", Sync interval: " + std::to_string(sync_interval);
+}
+
+DistributedTreeBlueprintSolver::DistributedTreeBlueprintSolver(const DistributedConfig& dist_config, const SolverConfig& config,
+    const BlueprintSolverConfig& bp_config)
+    : MCCFRSolver{config}, TreeSolver{config}, BlueprintSolver{config, bp_config}, TreeBlueprintSolver{config, bp_config}, _dist_config{dist_config} {
+  if(dist_config.worker_idx < 0 || dist_config.worker_idx >= dist_config.n_workers) {
+    Logger::error("Invalid worker index: " + std::to_string(dist_config.worker_idx) + ", workers: " + std::to_string(dist_config.n_workers));
+  }
+  if(dist_config.sync_interval <= 0) Logger::error("Sync interval must be positive.");
+  if(dist_config.run_id.empty() || dist_config.run_id.find('/') != std::string::npos) Logger::error("Invalid run id: \"" + dist_config.run_id + "\"");
+}
+
+void DistributedTreeBlueprintSolver::on_start() {
+  TreeBlueprintSolver::on_start();
+  Logger::log("Distributed config:\n" + _dist_config.to_string());
+  if(!create_dir(_dist_config.sync_dir)) Logger::error("Failed to create sync dir: " + _dist_config.sync_dir.string());
+  if(!create_dir(run_dir())) Logger::error("Failed to create run dir: " + run_dir().string());
+  // deltas this worker wrote before belong to an earlier run with the same id, the other workers would merge them as the current round
+  for(const auto& entry : std::filesystem::directory_iterator{run_dir()}) {
+    if(std::filesystem::exists(entry.path() / ("worker_" + std::to_string(_dist_config.worker_idx) + ".done"))) {
+      Logger::error("Run dir contains deltas of a previous run: " + entry.path().string() + ". Use a new run id.");
+    }
+  }
+  const SlimPokerState root_state{get_config().init_state};
+  if(!_base_regrets) _base_regrets = tree_delta<int>(init_regret_storage(), nullptr, root_state);
+  if(!_base_phi && init_avg_storage()) _base_phi = tree_delta<float>(init_avg_storage(), nullptr, root_state);
+}
+
+long DistributedTreeBlueprintSolver::next_step(const long t, const long T) const {
+  return std::min(TreeBlueprintSolver::next_step(t, T), (t / _dist_config.sync_interval + 1) * _dist_config.sync_interval);
+}
+
+void DistributedTreeBlueprintSolver::on_step_end(const long t, const long T) {
+  if(is_interrupted()) return;
+  // the last step of a solve is merged as well, every worker stops at the same t
+  if(t % _dist_config.sync_interval == 0 || t == T) sync((t + _dist_config.sync_interval - 1) / _dist_config.sync_interval, t == T);
+  // the base trees follow the discounts of the trained trees, so that deltas only contain the updates since the last merge
+  if(should_discount(t)) {
+    const double d = get_discount_factor(t);
+    _base_regrets->lcfr_discount(d);
+    if(_base_phi) _base_phi->lcfr_discount(d);
+  }
+}
+
+void DistributedTreeBlueprintSolver::sync(const long round, const bool last) {
+  const auto t_0 = std::chrono::steady_clock::now();
+  Logger::log("============== Merging worker deltas (round " + std::to_string(round) + ") ==============");
+  write_delta(round);
+  await_markers(round, ".done");
+  for(int w = 0; w < _dist_config.n_workers; ++w) {
+    if(w != _dist_config.worker_idx) merge_delta(round, w);
+  }
+  // every worker has written this round after reading the previous one
+  if(_dist_config.worker_idx == 0 && round > 1) std::filesystem::remove_all(round_dir(round - 1));
+  if(last) {
+    // nothing writes the next round, so the workers confirm that they have read the last one
+    write_marker(worker_dir(round, _dist_config.worker_idx).string() + ".merged");
+    if(_dist_config.worker_idx == 0) {
+      await_markers(round, ".merged");
+      std::filesystem::remove_all(run_dir());
+    }
+  }
+  const auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t_0).count();
+  Logger::log("Merged " + std::to_string(_dist_config.n_workers - 1) + " worker deltas in " + std::to_string(dt) + " ms.");
+}
+
+void DistributedTreeBlueprintSolver::write_delta(const long round) {
+  const SlimPokerState root_state{get_config().init_state};
+  const std::filesystem::path dir = worker_dir(round, _dist_config.worker_idx);
+  if(!create_dir(round_dir(round))) Logger::error("Failed to create round dir: " + round_dir(round).string());
+  std::filesystem::remove_all(dir);
+
+  const auto regret_delta = tree_delta<int>(init_regret_storage(), _base_regrets.get(), root_state);
+  TreeStorageNode<float>* phi = init_avg_storage();
+  const auto phi_delta = phi ? tree_delta<float>(phi, _base_phi.get(), root_state) : nullptr;
+  {
+    const int n_threads = omp_get_max_threads();
+    ShardedSnapshotWriter writer{dir.string(), 4 * n_threads, n_threads};
+    const bool has_phi = phi_delta != nullptr;
+    writer.archive()(round, _dist_config.worker_idx, has_phi);
+    writer.add_tree(*regret_delta);
+    if(has_phi) writer.add_tree(*phi_delta);
+    writer.write_shards();
+  }
+  // readers never see a partial delta
+  write_marker(dir.string() + ".done");
+
+  // the merged trees contain the own delta as well
+  add_tree_values(_base_regrets.get(), regret_delta.get(), root_state);
+  if(phi_delta && _base_phi) add_tree_values(_base_phi.get(), phi_delta.get(), root_state);
+}
+
+void DistributedTreeBlueprintSolver::await_markers(const long round, const std::string& suffix) const {
+  const auto t_0 = std::chrono::steady_clock::now();
+  for(int w = 0; w < _dist_config.n_workers; ++w) {
+    const std::filesystem::path marker = worker_dir(round, w).string() + suffix;
+    while(!std::filesystem::exists(marker)) {
+      if(std::chrono::steady_clock::now() - t_0 > std::chrono::seconds{_dist_config.timeout_s}) {
+        Logger::error("Timed out waiting for worker " + std::to_string(w) + " in round " + std::to_string(round) + ".");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    }
+  }
+}
+
+void DistributedTreeBlueprintSolver::merge_delta(const long round, const int worker_idx) {
+  const SlimPokerState root_state{get_config().init_state};
+  TreeStorageNode<int> regret_delta;
+  TreeStorageNode<float> phi_delta;
+  long delta_round;
+  int delta_worker;
+  bool has_phi;
+  {
+    ShardedSnapshotReader reader{worker_dir(round, worker_idx).string()};
+    reader.archive()(delta_round, delta_worker, has_phi);
+    if(delta_round != round || delta_worker != worker_idx) {
+      Logger::error("Delta mismatch. Expected round " + std::to_string(round) + " of worker " + std::to_string(worker_idx) + ", got round " +
+          std::to_string(delta_round) + " of worker " + std::to_string(delta_worker) + ".");
+    }
+    reader.add_tree(regret_delta);
+    if(has_phi) reader.add_tree(phi_delta);
+    reader.read_shards();
+  }
+  add_tree_values(init_regret_storage(), &regret_delta, root_state);
+  add_tree_values(_base_regrets.get(), &regret_delta, root_state);
+  if(has_phi && init_avg_storage()) {
+    add_tree_values(init_avg_storage(), &phi_delta, root_state);
+    if(_base_phi) add_tree_values(_base_phi.get(), &phi_delta, root_state);
+  }
+}
+
+}
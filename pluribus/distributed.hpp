@@ -0,0 +1,104 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <pluribus/mccfr.hpp>
+#include <pluribus/poker.hpp>
+#include <pluribus/snapshot.hpp>
+#include <pluribus/tree_storage.hpp>
+#include <pluribus/tree_visitor.hpp>
+
+namespace pluribus {
+
+// Adds sign times the values of src to the matching nodes of dst. Both trees must belong to the game tree rooted at root_state, nodes that are
+// only allocated in src are allocated in dst. Pending discounts of src are applied, dst may be quantized.
+template <class T>
+void add_tree_values(TreeStorageNode<T>* dst, const TreeStorageNode<T>* src, const SlimPokerState& root_state, const T sign = T{1}) {
+  TreeVisitor<const TreeStorageNode<T>, TreeStorageNode<T>*> visitor;
+  visitor.track_state(root_state)
+      ->set_aux(dst, [](TreeStorageNode<T>* node, const int a_idx) { return node->apply_index(a_idx); })
+      ->set_pre([sign](const TreeStorageNode<T>* node, const auto& info) {
+        TreeStorageNode<T>* target = info.aux;
+        const int n_actions = static_cast<int>(node->get_value_actions().size());
+        for(int idx = 0; idx < node->get_n_values(); ++idx) {
+          const T d = sign * node->load_by_index(idx);
+          if(d == T{0}) continue;
+          if constexpr(std::is_same_v<T, int>) target->get_regret_row(idx / n_actions).add(idx % n_actions, d);
+          else target->get_by_index(idx)->fetch_add(d, std::memory_order_relaxed);
+        }
+        for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
+          if(node->is_allocated(a_idx)) target->apply_index(a_idx, info.state->apply_copy(node->get_branching_actions()[a_idx]));
+        }
+        return true;
+      });
+  visitor.visit(src);
+}
+
+// current - base as a full precision tree with the structure of current. base may be null.
+template <class T>
+std::unique_ptr<TreeStorageNode<T>> tree_delta(const TreeStorageNode<T>* current, const TreeStorageNode<T>* base, const SlimPokerState& root_state) {
+  auto config = std::make_shared<TreeStorageConfig>(*current->make_config_ptr());
+  config->regret_precision = RegretPrecision::INT32;
+  config->prune_records = false;
+  config->baselines = false;
+  auto delta = std::make_unique<TreeStorageNode<T>>(root_state, config);
+  add_tree_values(delta.get(), current, root_state);
+  if(base) add_tree_values(delta.get(), base, root_state, T{-1});
+  return delta;
+}
+
+struct DistributedConfig {
+  int worker_idx = 0;
+  int n_workers = 1;
+  // exchange directory shared by all workers, /dev/shm keeps the exchange in shared memory
+  std::filesystem::path sync_dir = "/dev/shm/pluribus_sync";
+  // shared by all workers of a run and unique per run, the rounds of a run are exchanged in sync_dir/run_id
+  std::string run_id;
+  // iterations of every worker between merges
+  long sync_interval = 10'000'000;
+  long timeout_s = 3600;
+
+  std::string to_string() const;
+};
+
+// One of several worker processes that train the same blueprint on a single machine. Workers sample their own iterations (give every worker a
+// different seed) and stop at every multiple of sync_interval. There, each worker writes the regret and phi deltas since the previous merge as a
+// sharded snapshot to the run directory, waits for the deltas of all other workers and adds them to its trees. Workers continue from the same sum
+// only for full precision regrets: quantized (INT16) regrets are added with stochastic rounding, so their merged trees differ by rounding noise
+// between workers. Iterations, discounts and snapshot steps count the iterations of a single worker. Only worker 0 logs metrics and writes
+// snapshots, which load into a TreeBlueprintSolver. After the last round, worker 0 removes the run directory once every worker has merged.
+// Memory: each worker keeps full precision copies of its trees as of the previous merge. At a merge it builds full precision delta trees of its
+// own updates and holds the delta of one other worker at a time, so the peak is about four times the trees of a single solver at INT32
+// precision, and more with INT16 regrets, whose copies and deltas are full precision.
+class DistributedTreeBlueprintSolver : public TreeBlueprintSolver {
+public:
+  explicit DistributedTreeBlueprintSolver(const DistributedConfig& dist_config, const SolverConfig& config = SolverConfig{},
+      const BlueprintSolverConfig& bp_config = BlueprintSolverConfig{});
+
+  const DistributedConfig& get_distributed_config() const { return _dist_config; }
+
+protected:
+  void on_start() override;
+  void on_step_end(long t, long T) override;
+
+  bool should_snapshot(long t, long T) const override { return _dist_config.worker_idx == 0 && TreeBlueprintSolver::should_snapshot(t, T); }
+  bool should_log(long t) const override { return _dist_config.worker_idx == 0 && TreeBlueprintSolver::should_log(t); }
+  long next_step(long t, long T) const override;
+
+private:
+  std::filesystem::path run_dir() const { return _dist_config.sync_dir / _dist_config.run_id; }
+  std::filesystem::path round_dir(long round) const { return run_dir() / ("round_" + std::to_string(round)); }
+  std::filesystem::path worker_dir(long round, int worker_idx) const { return round_dir(round) / ("worker_" + std::to_string(worker_idx)); }
+  void write_delta(long round);
+  void await_markers(long round, const std::string& suffix) const;
+  void merge_delta(long round, int worker_idx);
+  void sync(long round, bool last);
+
+  DistributedConfig _dist_config;
+  std::unique_ptr<TreeStorageNode<int>> _base_regrets;
+  std::unique_ptr<TreeStorageNode<float>> _base_phi;
+};
+
+}
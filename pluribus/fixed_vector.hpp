@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cereal/cereal.hpp>
+
+namespace pluribus {
+
+// Vector with inline storage for at most N elements. Trivially copyable if T is, so containers of game state can be copied with a memcpy
+// instead of heap allocations. Serialized like std::vector, binary snapshots of either are interchangeable.
+template <class T, size_t N>
+class FixedVector {
+public:
+  static_assert(N <= UINT8_MAX, "FixedVector capacity must fit into uint8_t.");
+
+  FixedVector() = default;
+  FixedVector(std::initializer_list<T> init) { assign(init.begin(), init.end()); }
+  explicit FixedVector(const std::vector<T>& v) { assign(v.begin(), v.end()); }
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  static constexpr size_t capacity() { return N; }
+
+  T& operator[](const size_t i) { assert(i < _size && "FixedVector index out of range."); return _data[i]; }
+  const T& operator[](const size_t i) const { assert(i < _size && "FixedVector index out of range."); return _data[i]; }
+  T* begin() { return _data.data(); }
+  T* end() { return _data.data() + _size; }
+  const T* begin() const { return _data.data(); }
+  const T* end() const { return _data.data() + _size; }
+
+  void push_back(const T& e) {
+    assert(_size < N && "FixedVector capacity exceeded.");
+    _data[_size++] = e;
+  }
+  template <class... Args>
+  T& emplace_back(Args&&... args) {
+    assert(_size < N && "FixedVector capacity exceeded.");
+    _data[_size] = T{std::forward<Args>(args)...};
+    return _data[_size++];
+  }
+  void resize(const size_t n, const T& e) {
+    assert(n <= N && "FixedVector capacity exceeded.");
+    for(size_t i = _size; i < n; ++i) _data[i] = e;
+    _size = static_cast<uint8_t>(n);
+  }
+  template <class It>
+  void assign(It first, It last) {
+    clear();
+    for(; first != last; ++first) push_back(*first);
+  }
+  void clear() { _size = 0; }
+  std::vector<T> to_vector() const { return std::vector<T>(begin(), end()); }
+
+  bool operator==(const FixedVector& other) const { return _size == other._size && std::equal(begin(), end(), other.begin()); }
+
+  template <class Archive>
+  void save(Archive& ar) const {
+    ar(cereal::make_size_tag(static_cast<cereal::size_type>(_size)));
+    for(const T& e : *this) ar(e);
+  }
+
+  template <class Archive>
+  void load(Archive& ar) {
+    cereal::size_type size;
+    ar(cereal::make_size_tag(size));
+    if(size > N) throw cereal::Exception("FixedVector capacity exceeded: " + std::to_string(size));
+    _size = static_cast<uint8_t>(size);
+    for(T& e : *this) ar(e);
+  }
+
+private:
+  std::array<T, N> _data;
+  uint8_t _size = 0;
+};
+
+}
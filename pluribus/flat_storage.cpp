@@ -0,0 +1,54 @@
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pluribus/flat_storage.hpp>
+#include <pluribus/logging.hpp>
+
+namespace pluribus {
+
+MappedFile::MappedFile(const std::string& fn) : _writable{false} {
+  const int fd = open(fn.c_str(), O_RDONLY);
+  if(fd == -1) Logger::error("Failed to open " + fn + ": " + std::strerror(errno));
+  struct stat st{};
+  if(fstat(fd, &st) == -1) {
+    close(fd);
+    Logger::error("Failed to stat " + fn + ": " + std::strerror(errno));
+  }
+  _bytes = st.st_size;
+  void* data = mmap(nullptr, _bytes, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED) Logger::error("Failed to map " + fn + ": " + std::strerror(errno));
+  _data = static_cast<char*>(data);
+}
+
+MappedFile::MappedFile(const std::string& fn, const size_t bytes) : _bytes{bytes}, _writable{true} {
+  const int fd = open(fn.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd == -1) Logger::error("Failed to create " + fn + ": " + std::strerror(errno));
+  if(ftruncate(fd, _bytes) == -1) {
+    close(fd);
+    Logger::error("Failed to resize " + fn + ": " + std::strerror(errno));
+  }
+  void* data = mmap(nullptr, _bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED) Logger::error("Failed to map " + fn + ": " + std::strerror(errno));
+  _data = static_cast<char*>(data);
+}
+
+MappedFile::~MappedFile() {
+  if(_data) munmap(_data, _bytes);
+}
+
+char* MappedFile::mutable_data() {
+  if(!_writable) Logger::error("Mapped file is read only.");
+  return _data;
+}
+
+void MappedFile::sync() const {
+  if(msync(_data, _bytes, MS_SYNC) == -1) Logger::error("Failed to sync mapped file: " + std::string{std::strerror(errno)});
+}
+
+}
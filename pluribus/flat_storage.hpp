@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <pluribus/actions.hpp>
+#include <pluribus/arena.hpp>
+#include <pluribus/logging.hpp>
+#include <pluribus/tree_storage.hpp>
+#include <pluribus/util.hpp>
+
+namespace pluribus {
+
+// Read-only (or freshly created, writable) memory mapping of a whole file. Mappings of the same file share the page cache across processes.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& fn);
+  MappedFile(const std::string& fn, size_t bytes);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return _data; }
+  char* mutable_data();
+  size_t size() const { return _bytes; }
+  void sync() const;
+
+private:
+  char* _data = nullptr;
+  size_t _bytes = 0;
+  bool _writable;
+};
+
+// Flat tree layout: [FlatHeader][action sets][node records in pre-order][metadata]
+// A node record is a FlatTreeNode followed by its child offset table and its value block. Offsets stored in a node record are relative to the
+// record itself, so the file is pointer free and a mapped file can be walked directly without parsing.
+constexpr uint64_t FLAT_MAGIC = 0x54414c4642554c50ULL; // "PLUBFLAT"
+constexpr uint32_t FLAT_VERSION = 1;
+
+struct FlatHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t value_bytes;
+  uint64_t n_nodes;
+  uint64_t root_offset;
+  uint64_t meta_offset;
+  uint64_t meta_bytes;
+  uint64_t file_bytes;
+};
+
+template <class T>
+class FlatTreeNode {
+public:
+  static_assert(sizeof(std::atomic<T>) == sizeof(T) && std::atomic<T>::is_always_lock_free, "Flat values must be readable as lock free atomics.");
+  static_assert(sizeof(Action) == sizeof(float) && std::is_trivially_copyable_v<Action>, "Flat action sets are stored as raw bet types.");
+
+  FlatTreeNode(const FlatTreeNode&) = delete;
+  FlatTreeNode& operator=(const FlatTreeNode&) = delete;
+
+  const FlatTreeNode* apply_index(const int action_idx) const {
+    const int64_t offset = child_offsets()[action_idx];
+    if(!offset) Logger::error("FlatTreeNode is not allocated. Index=" + std::to_string(action_idx));
+    return reinterpret_cast<const FlatTreeNode*>(reinterpret_cast<const char*>(this) + offset);
+  }
+
+  const FlatTreeNode* apply(const Action a) const { return apply_index(index_of(a, get_branching_actions())); }
+
+  const FlatTreeNode* apply(const std::vector<Action>& actions) const {
+    const FlatTreeNode* node = this;
+    for(const Action a : actions) {
+      node = node->apply(a);
+    }
+    return node;
+  }
+
+  bool is_allocated(const int action_idx) const { return child_offsets()[action_idx] != 0; }
+  bool is_allocated(const Action a) const { return is_allocated(index_of(a, get_branching_actions())); }
+
+  const std::atomic<T>* get(const int cluster, const int action_idx = 0) const { return &values()[node_value_index(_n_value_actions, cluster, action_idx)]; }
+  const std::atomic<T>* get_by_index(const int index) const { return &values()[index]; }
+  const std::atomic<T>* get_row(const int cluster) const { return get(cluster); }
+
+  std::span<const Action> get_branching_actions() const { return {relative<Action>(_branching_actions_offset), _n_branching_actions}; }
+  std::span<const Action> get_value_actions() const { return {relative<Action>(_value_actions_offset), _n_value_actions}; }
+  int get_n_clusters() const { return _n_clusters; }
+  int get_n_values() const { return _n_value_actions * _n_clusters; }
+
+  static size_t record_bytes(const size_t n_branching, const size_t n_values) {
+    return align_up(values_offset(n_branching) + n_values * sizeof(T), alignof(FlatTreeNode));
+  }
+
+  // Writes the record of node to dst, child offsets are left empty. Action set offsets are absolute and converted to relative offsets.
+  static FlatTreeNode* emplace(char* dst, const TreeStorageNode<T>& node, const int64_t branching_actions_offset, const int64_t value_actions_offset) {
+    auto flat = new (dst) FlatTreeNode{};
+    const int64_t self = reinterpret_cast<int64_t>(dst);
+    flat->_branching_actions_offset = branching_actions_offset - self;
+    flat->_value_actions_offset = value_actions_offset - self;
+    flat->_n_clusters = node.get_n_clusters();
+    flat->_n_branching_actions = node.get_branching_actions().size();
+    flat->_n_value_actions = node.get_value_actions().size();
+    std::memset(flat->mutable_child_offsets(), 0, flat->_n_branching_actions * sizeof(int64_t));
+    T* values = reinterpret_cast<T*>(dst + values_offset(flat->_n_branching_actions));
+    for(int i = 0; i < node.get_n_values(); ++i) values[i] = node.load_by_index(i);
+    return flat;
+  }
+
+  void set_child(const int action_idx, const FlatTreeNode* child) {
+    mutable_child_offsets()[action_idx] = reinterpret_cast<const char*>(child) - reinterpret_cast<const char*>(this);
+  }
+
+private:
+  template <class> friend class FlatTree;
+
+  FlatTreeNode() = default;
+
+  static size_t values_offset(const size_t n_branching) { return align_up(sizeof(FlatTreeNode) + n_branching * sizeof(int64_t), alignof(T)); }
+
+  template <class U>
+  const U* relative(const int64_t offset) const { return reinterpret_cast<const U*>(reinterpret_cast<const char*>(this) + offset); }
+
+  const int64_t* child_offsets() const { return relative<int64_t>(sizeof(FlatTreeNode)); }
+  int64_t* mutable_child_offsets() { return reinterpret_cast<int64_t*>(reinterpret_cast<char*>(this) + sizeof(FlatTreeNode)); }
+  const std::atomic<T>* values() const { return relative<std::atomic<T>>(values_offset(_n_branching_actions)); }
+
+  int64_t _branching_actions_offset;
+  int64_t _value_actions_offset;
+  int32_t _n_clusters;
+  uint8_t _n_branching_actions;
+  uint8_t _n_value_actions;
+};
+
+struct FlatLayout {
+  std::unordered_map<const std::vector<Action>*, uint64_t> action_set_offsets;
+  uint64_t n_nodes = 0;
+  uint64_t node_bytes = 0;
+};
+
+template <class T>
+void collect_flat_layout(const TreeStorageNode<T>* node, FlatLayout& layout) {
+  layout.action_set_offsets.emplace(&node->get_branching_actions(), 0);
+  layout.action_set_offsets.emplace(&node->get_value_actions(), 0);
+  ++layout.n_nodes;
+  layout.node_bytes += FlatTreeNode<T>::record_bytes(node->get_branching_actions().size(), node->get_n_values());
+  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
+    if(node->is_allocated(a_idx)) collect_flat_layout(node->apply_index(a_idx), layout);
+  }
+}
+
+template <class T>
+FlatTreeNode<T>* write_flat_node(const TreeStorageNode<T>* node, char* base, uint64_t& cursor, const FlatLayout& layout) {
+  const int64_t base_addr = reinterpret_cast<int64_t>(base);
+  FlatTreeNode<T>* flat = FlatTreeNode<T>::emplace(base + cursor, *node, base_addr + layout.action_set_offsets.at(&node->get_branching_actions()),
+      base_addr + layout.action_set_offsets.at(&node->get_value_actions()));
+  cursor += FlatTreeNode<T>::record_bytes(node->get_branching_actions().size(), node->get_n_values());
+  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
+    if(node->is_allocated(a_idx)) flat->set_child(a_idx, write_flat_node(node->apply_index(a_idx), base, cursor, layout));
+  }
+  return flat;
+}
+
+template <class T>
+void write_flat_tree(const TreeStorageNode<T>& root, const std::string& fn, const std::string& metadata) {
+  Logger::log("Writing flat tree to " + fn);
+  FlatLayout layout;
+  collect_flat_layout(&root, layout);
+
+  uint64_t cursor = align_up(sizeof(FlatHeader), alignof(int64_t));
+  for(auto& [actions, offset] : layout.action_set_offsets) {
+    offset = cursor;
+    cursor += align_up(actions->size() * sizeof(Action), alignof(int64_t));
+  }
+  const uint64_t root_offset = cursor;
+  const uint64_t meta_offset = root_offset + layout.node_bytes;
+  const uint64_t file_bytes = meta_offset + metadata.size();
+
+  MappedFile file{fn, file_bytes};
+  char* base = file.mutable_data();
+  for(const auto& [actions, offset] : layout.action_set_offsets) {
+    std::memcpy(base + offset, actions->data(), actions->size() * sizeof(Action));
+  }
+  write_flat_node(&root, base, cursor, layout);
+  if(cursor != meta_offset) Logger::error("Flat tree size mismatch. Expected=" + std::to_string(meta_offset) + ", Written=" + std::to_string(cursor));
+  std::memcpy(base + meta_offset, metadata.data(), metadata.size());
+  new (base) FlatHeader{FLAT_MAGIC, FLAT_VERSION, sizeof(T), layout.n_nodes, root_offset, meta_offset, metadata.size(), file_bytes};
+  file.sync();
+  Logger::log("Wrote " + std::to_string(layout.n_nodes) + " nodes, " + std::to_string(file_bytes) + " bytes.");
+}
+
+// Memory mapped flat tree. Opening validates the header and, unless validate_nodes is false, walks the node records once to check every action set
+// and child offset against the mapped size, so a corrupt file fails on open instead of reading outside of the mapping. The walk reads all records,
+// trusted files can skip it to keep opening constant time and page nodes in on first access.
+template <class T>
+class FlatTree {
+public:
+  explicit FlatTree(const std::string& fn, const bool validate_nodes = true) : _file{fn} {
+    if(_file.size() < sizeof(FlatHeader)) Logger::error("Flat tree file is too small: " + fn);
+    const FlatHeader& header = get_header();
+    if(header.magic != FLAT_MAGIC) Logger::error("Invalid flat tree file: " + fn);
+    if(header.version != FLAT_VERSION) Logger::error("Unsupported flat tree version: " + std::to_string(header.version));
+    if(header.value_bytes != sizeof(T)) Logger::error("Flat tree value size mismatch. File=" + std::to_string(header.value_bytes) +
+        ", Expected=" + std::to_string(sizeof(T)));
+    if(header.file_bytes != _file.size()) Logger::error("Flat tree file is truncated: " + fn);
+    if(header.root_offset < sizeof(FlatHeader) || header.root_offset % alignof(FlatTreeNode<T>) != 0 || header.meta_offset > header.file_bytes ||
+        header.meta_offset - std::min(header.root_offset, header.meta_offset) < sizeof(FlatTreeNode<T>) || header.meta_bytes != header.file_bytes - header.meta_offset) {
+      Logger::error("Invalid flat tree layout: " + fn);
+    }
+    if(validate_nodes) this->validate_nodes(fn);
+  }
+
+  const FlatTreeNode<T>* root() const { return reinterpret_cast<const FlatTreeNode<T>*>(_file.data() + get_header().root_offset); }
+  std::string_view metadata() const { return {_file.data() + get_header().meta_offset, get_header().meta_bytes}; }
+  uint64_t n_nodes() const { return get_header().n_nodes; }
+
+private:
+  const FlatHeader& get_header() const { return *reinterpret_cast<const FlatHeader*>(_file.data()); }
+  const FlatTreeNode<T>* node_at(const uint64_t offset) const { return reinterpret_cast<const FlatTreeNode<T>*>(_file.data() + offset); }
+
+  // offsets are checked before they are added to the record position, so corrupt offsets cannot overflow
+  void validate_nodes(const std::string& fn) const {
+    const FlatHeader& header = get_header();
+    const auto action_set_valid = [&header](const uint64_t pos, const int64_t offset, const size_t n) {
+      const auto begin = static_cast<int64_t>(align_up(sizeof(FlatHeader), alignof(int64_t)));
+      const int64_t end = static_cast<int64_t>(header.root_offset) - static_cast<int64_t>(n * sizeof(Action));
+      return offset >= begin - static_cast<int64_t>(pos) && offset <= end - static_cast<int64_t>(pos);
+    };
+    std::vector<uint64_t> records;
+    uint64_t pos = header.root_offset;
+    while(pos < header.meta_offset) {
+      const FlatTreeNode<T>* node = node_at(pos);
+      if(pos + sizeof(FlatTreeNode<T>) > header.meta_offset || node->_n_clusters < 0) Logger::error("Invalid flat tree node record: " + fn);
+      const uint64_t n_values = static_cast<uint64_t>(node->_n_value_actions) * node->_n_clusters;
+      const uint64_t bytes = FlatTreeNode<T>::record_bytes(node->_n_branching_actions, n_values);
+      if(bytes > header.meta_offset - pos) Logger::error("Flat tree node record exceeds the node section: " + fn);
+      if(!action_set_valid(pos, node->_branching_actions_offset, node->_n_branching_actions) ||
+          !action_set_valid(pos, node->_value_actions_offset, node->_n_value_actions)) {
+        Logger::error("Flat tree action set offset out of range: " + fn);
+      }
+      records.push_back(pos);
+      pos += bytes;
+    }
+    if(records.size() != header.n_nodes) Logger::error("Flat tree node count mismatch. Header=" + std::to_string(header.n_nodes) +
+        ", Records=" + std::to_string(records.size()));
+    // records are written in pre-order, so every child is a later record start
+    for(const uint64_t record : records) {
+      const FlatTreeNode<T>* node = node_at(record);
+      for(int a_idx = 0; a_idx < node->_n_branching_actions; ++a_idx) {
+        const int64_t offset = node->child_offsets()[a_idx];
+        if(offset == 0) continue;
+        if(offset < 0 || offset >= static_cast<int64_t>(header.meta_offset - record) ||
+            !std::ranges::binary_search(records, record + static_cast<uint64_t>(offset))) {
+          Logger::error("Flat tree child offset does not point to a node record: " + fn);
+        }
+      }
+    }
+  }
+
+  MappedFile _file;
+};
+
+}
@@ -0,0 +1,388 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cereal/access.hpp>
+#include <cereal/types/memory.hpp>
+#include <cereal/types/vector.hpp>
+#include <omp.h>
+#include <pluribus/actions.hpp>
+#include <pluribus/logging.hpp>
+#include <pluribus/poker.hpp>
+#include <pluribus/regret_row.hpp>
+#include <pluribus/tree_storage.hpp>
+
+namespace pluribus {
+
+// Key of an action sequence. hash is updated incrementally per action and carries round + 1 in its top three bits, check is an independent
+// 32 bit hash of the same sequence that tells apart sequences whose hashes collide.
+struct HashKey {
+  uint64_t hash;
+  uint32_t check;
+
+  bool operator==(const HashKey& other) const = default;
+};
+
+inline uint64_t mix64(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+constexpr uint64_t HASH_ROUND_SHIFT = 61;
+constexpr uint64_t HASH_ROUND_MASK = 0x7ULL << HASH_ROUND_SHIFT;
+
+inline HashKey hash_key_with_round(const uint64_t hash, const uint32_t check, const int round) {
+  return {(hash & ~HASH_ROUND_MASK) | (static_cast<uint64_t>(round + 1) << HASH_ROUND_SHIFT), check};
+}
+
+inline HashKey root_hash_key(const int round) {
+  return hash_key_with_round(mix64(0x243f6a8885a308d3ULL), static_cast<uint32_t>(mix64(0x13198a2e03707344ULL)), round);
+}
+
+inline HashKey next_hash_key(const HashKey& key, const Action a, const int next_round) {
+  const uint64_t bits = std::bit_cast<uint32_t>(a.get_bet_type());
+  const uint64_t hash = mix64(key.hash ^ (bits + 0x9e3779b97f4a7c15ULL));
+  const auto check = static_cast<uint32_t>(mix64((static_cast<uint64_t>(key.check) << 32 | bits) ^ 0xc2b2ae3d27d4eb4fULL));
+  return hash_key_with_round(hash, check, next_round);
+}
+
+struct HashTableConfig {
+  size_t memory_budget = 1UL << 30; // bytes for slots and values, reserved up front
+  int slot_bits = 20;
+
+  size_t n_slots() const { return 1UL << slot_bits; }
+
+  bool operator==(const HashTableConfig& other) const = default;
+
+  template <class Archive>
+  void serialize(Archive& ar) {
+    ar(memory_budget, slot_bits);
+  }
+};
+
+struct HashTableStats {
+  size_t n_slots = 0;
+  size_t used_slots = 0;
+  size_t n_values = 0;
+  size_t values_capacity = 0;
+  size_t bytes = 0;
+  long probes = 0;     // sum of probe distances of all inserted slots
+  long max_probe = 0;
+  long collisions = 0; // lookups that met a slot with an equal hash but a different check
+
+  double load_factor() const { return n_slots > 0 ? static_cast<double>(used_slots) / n_slots : 0.0; }
+  double mean_probe() const { return used_slots > 0 ? static_cast<double>(probes) / used_slots : 0.0; }
+};
+
+template <class T>
+class HashTable;
+
+// Slot of a HashTable, i.e. the infosets of all clusters at one action sequence. Navigation mirrors TreeStorageNode: apply_index with the next
+// state finds or inserts the child slot, the const overloads only look it up.
+template <class T>
+class HashedInfoset {
+public:
+  HashedInfoset* apply_index(const int action_idx, const SlimPokerState& next_state) {
+    return _table->insert(next_hash_key(get_key(), get_branching_actions()[action_idx], next_state.get_round()), next_state);
+  }
+  HashedInfoset* apply(const Action a, const SlimPokerState& next_state) {
+    return apply_index(_compute_action_index(a, get_branching_actions()), next_state);
+  }
+
+  const HashedInfoset* apply_index(const int action_idx) const {
+    const HashedInfoset* child = find_child(action_idx);
+    if(!child) Logger::error("HashedInfoset is not allocated. Index=" + std::to_string(action_idx));
+    return child;
+  }
+  const HashedInfoset* apply(const Action a) const { return apply_index(_compute_action_index(a, get_branching_actions())); }
+
+  const HashedInfoset* apply(const std::vector<Action>& actions) const {
+    const HashedInfoset* node = this;
+    for(const Action a : actions) {
+      node = node->apply(a);
+    }
+    return node;
+  }
+
+  bool is_allocated(const int action_idx) const { return find_child(action_idx) != nullptr; }
+  bool is_allocated(const Action a) const { return is_allocated(_compute_action_index(a, get_branching_actions())); }
+
+  std::atomic<T>* get(const int cluster, const int action_idx = 0) { return get_by_index(node_value_index(_n_value_actions, cluster, action_idx)); }
+  const std::atomic<T>* get(const int cluster, const int action_idx = 0) const {
+    return get_by_index(node_value_index(_n_value_actions, cluster, action_idx));
+  }
+  std::atomic<T>* get_by_index(const int index) { return _table->values() + _value_offset + index; }
+  const std::atomic<T>* get_by_index(const int index) const { return std::as_const(*_table).values() + _value_offset + index; }
+
+  RegretRow get_regret_row(const int cluster) requires std::is_same_v<T, int> { return RegretRow{get(cluster)}; }
+  const std::atomic<T>* get_row(const int cluster) const { return get(cluster); }
+  T load_by_index(const int index) const { return get_by_index(index)->load(std::memory_order_relaxed); }
+  T load(const int cluster, const int action_idx) const { return load_by_index(node_value_index(_n_value_actions, cluster, action_idx)); }
+
+  const std::vector<Action>& get_branching_actions() const { return ActionSetPool::get_instance()->get(_branching_id); }
+  const std::vector<Action>& get_value_actions() const { return ActionSetPool::get_instance()->get(_value_id); }
+  int get_n_clusters() const { return _n_clusters; }
+  int get_n_values() const { return _n_value_actions * _n_clusters; }
+  int get_round() const { return _round; }
+  HashKey get_key() const { return {_hash.load(std::memory_order_relaxed), _check}; }
+
+  // discounts the whole table, only valid at the root
+  void lcfr_discount(const double d) {
+    if(this != _table->root()) Logger::error("HashedInfoset::lcfr_discount is only valid at the root.");
+    _table->lcfr_discount(d);
+  }
+
+private:
+  friend class HashTable<T>;
+
+  // the round of the child is not known without its state, but it is unique for the action sequence
+  const HashedInfoset* find_child(const int action_idx) const {
+    const Action a = get_branching_actions()[action_idx];
+    for(int round = _round; round < 4; ++round) {
+      if(const HashedInfoset* child = _table->find(next_hash_key(get_key(), a, round))) return child;
+    }
+    return nullptr;
+  }
+
+  bool is_ready() const { return _ready.load(std::memory_order_acquire); }
+
+  std::atomic<uint64_t> _hash = 0; // 0 marks an empty slot
+  std::atomic<bool> _ready = false;
+  uint32_t _check = 0;
+  uint64_t _value_offset = 0;
+  HashTable<T>* _table = nullptr;
+  ActionSetPool::Id _branching_id = 0;
+  ActionSetPool::Id _value_id = 0;
+  uint16_t _n_clusters = 0;
+  uint8_t _n_value_actions = 0;
+  uint8_t _round = 0;
+};
+
+// Open addressing (linear probing) table of HashedInfosets keyed by HashKey. Slots and values are preallocated from the memory budget, inserts
+// claim an empty slot with a CAS and take their values from a shared bump pointer, so lookups and inserts never lock. Values are only
+// initialized when a slot claims them, so the unused part of the value budget is reserved but never touched. Threads that find a slot
+// that is still being initialized spin until it is ready. Slots are never removed, exceeding the slot count or the value budget is an error that
+// leaves the table unusable.
+template <class T>
+class HashTable {
+public:
+  static_assert(sizeof(std::atomic<T>) == sizeof(T) && std::atomic<T>::is_always_lock_free, "Hash table values must be lock free atomics.");
+
+  HashTable(const SlimPokerState& root_state, const std::shared_ptr<const TreeStorageConfig>& config, const HashTableConfig& table_config)
+      : _root_state{root_state}, _config{config}, _table_config{table_config} {
+    allocate();
+    _root = insert(root_hash_key(root_state.get_round()), root_state);
+  }
+
+  HashTable(const HashTable&) = delete;
+  HashTable& operator=(const HashTable&) = delete;
+
+  HashedInfoset<T>* root() { return _root; }
+  const HashedInfoset<T>* root() const { return _root; }
+  std::atomic<T>* values() { return _values.get(); }
+  const std::atomic<T>* values() const { return _values.get(); }
+  const std::shared_ptr<const TreeStorageConfig>& get_config() const { return _config; }
+  const HashTableConfig& get_table_config() const { return _table_config; }
+
+  HashedInfoset<T>* insert(const HashKey& key, const SlimPokerState& state) {
+    const size_t mask = _table_config.n_slots() - 1;
+    for(size_t probe = 0; probe <= mask; ++probe) {
+      HashedInfoset<T>& slot = _slots[(key.hash + probe) & mask];
+      uint64_t hash = slot._hash.load(std::memory_order_acquire);
+      if(hash == 0 && slot._hash.compare_exchange_strong(hash, key.hash, std::memory_order_acq_rel)) {
+        init_slot(slot, key, state);
+        record_insert(probe);
+        return &slot;
+      }
+      if(hash == key.hash) {
+        while(!slot.is_ready()) std::this_thread::yield();
+        if(slot._check == key.check) return &slot;
+        _collisions.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    Logger::error("Hash table is full. Slots=" + std::to_string(_table_config.n_slots()));
+  }
+
+  const HashedInfoset<T>* find(const HashKey& key) const {
+    const size_t mask = _table_config.n_slots() - 1;
+    for(size_t probe = 0; probe <= mask; ++probe) {
+      const HashedInfoset<T>& slot = _slots[(key.hash + probe) & mask];
+      const uint64_t hash = slot._hash.load(std::memory_order_acquire);
+      if(hash == 0) return nullptr;
+      if(hash == key.hash) {
+        while(!slot.is_ready()) std::this_thread::yield();
+        if(slot._check == key.check) return &slot;
+        _collisions.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    return nullptr;
+  }
+
+  void lcfr_discount(const double d) {
+    const size_t n_values = std::min(_values_used.load(std::memory_order_relaxed), _values_capacity);
+    #pragma omp parallel for schedule(static)
+    for(size_t i = 0; i < n_values; ++i) {
+      _values[i].store(static_cast<T>(_values[i].load(std::memory_order_relaxed) * d), std::memory_order_relaxed);
+    }
+  }
+
+  // calls f for every used slot, in parallel
+  template <class F>
+  void for_each_slot(F&& f) const {
+    #pragma omp parallel for schedule(static)
+    for(size_t idx = 0; idx < _table_config.n_slots(); ++idx) {
+      if(_slots[idx].is_ready()) f(_slots[idx]);
+    }
+  }
+
+  HashTableStats get_stats() const {
+    HashTableStats stats;
+    stats.n_slots = _table_config.n_slots();
+    stats.used_slots = _used_slots.load(std::memory_order_relaxed);
+    stats.n_values = _values_used.load(std::memory_order_relaxed);
+    stats.values_capacity = _values_capacity;
+    stats.bytes = stats.n_slots * sizeof(HashedInfoset<T>) + _values_capacity * sizeof(std::atomic<T>);
+    stats.probes = _probes.load(std::memory_order_relaxed);
+    stats.max_probe = _max_probe.load(std::memory_order_relaxed);
+    stats.collisions = _collisions.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  bool operator==(const HashTable& other) const {
+    if(_root_state != other._root_state || *_config != *other._config || _table_config != other._table_config ||
+       _values_used.load() != other._values_used.load()) {
+      return false;
+    }
+    for(size_t idx = 0; idx < _table_config.n_slots(); ++idx) {
+      const HashedInfoset<T>& lhs = _slots[idx];
+      const HashedInfoset<T>& rhs = other._slots[idx];
+      if(lhs.get_key() != rhs.get_key() || lhs._value_offset != rhs._value_offset || lhs._n_clusters != rhs._n_clusters) return false;
+    }
+    for(size_t i = 0; i < _values_used.load(); ++i) {
+      if(_values[i].load(std::memory_order_relaxed) != other._values[i].load(std::memory_order_relaxed)) return false;
+    }
+    return true;
+  }
+
+  template <class Archive>
+  void save(Archive& ar) const {
+    ar(_root_state, *_config, _table_config, static_cast<uint64_t>(_values_used.load()));
+    std::vector<uint64_t> slot_idxs;
+    for(size_t idx = 0; idx < _table_config.n_slots(); ++idx) {
+      if(_slots[idx].is_ready()) slot_idxs.push_back(idx);
+    }
+    ar(slot_idxs);
+    for(const uint64_t idx : slot_idxs) {
+      const HashedInfoset<T>& slot = _slots[idx];
+      ar(slot._hash.load(), slot._check, slot._value_offset, slot.get_branching_actions(), slot.get_value_actions(), slot._n_clusters, slot._round);
+    }
+    ar(cereal::binary_data(_values.get(), _values_used.load() * sizeof(T)));
+  }
+
+  template <class Archive>
+  void load(Archive& ar) {
+    TreeStorageConfig config;
+    uint64_t values_used;
+    ar(_root_state, config, _table_config, values_used);
+    _config = std::make_shared<const TreeStorageConfig>(config);
+    allocate();
+    if(values_used > _values_capacity) Logger::error("Hash table snapshot exceeds the memory budget. Values=" + std::to_string(values_used));
+    std::vector<uint64_t> slot_idxs;
+    ar(slot_idxs);
+    ActionSetPool* pool = ActionSetPool::get_instance();
+    for(const uint64_t idx : slot_idxs) {
+      HashedInfoset<T>& slot = _slots[idx];
+      uint64_t hash;
+      std::vector<Action> branching_actions;
+      std::vector<Action> value_actions;
+      ar(hash, slot._check, slot._value_offset, branching_actions, value_actions, slot._n_clusters, slot._round);
+      slot._hash.store(hash);
+      slot._table = this;
+      slot._branching_id = pool->intern(branching_actions);
+      slot._value_id = pool->intern(value_actions);
+      slot._n_value_actions = value_actions.size();
+      slot._ready.store(true);
+    }
+    _used_slots.store(slot_idxs.size());
+    _values_used.store(values_used);
+    init_values(0, values_used);
+    ar(cereal::binary_data(_values.get(), values_used * sizeof(T)));
+    _root = const_cast<HashedInfoset<T>*>(find(root_hash_key(_root_state.get_round())));
+    if(!_root) Logger::error("Hash table snapshot has no root slot.");
+  }
+
+private:
+  friend class cereal::access;
+
+  HashTable() = default;
+
+  void allocate() {
+    const size_t slot_bytes = _table_config.n_slots() * sizeof(HashedInfoset<T>);
+    if(_table_config.slot_bits < 1 || _table_config.slot_bits > 40 || slot_bytes >= _table_config.memory_budget) {
+      Logger::error("Invalid hash table config. Slot bits=" + std::to_string(_table_config.slot_bits) + ", Budget=" +
+          std::to_string(_table_config.memory_budget) + " bytes");
+    }
+    _values_capacity = (_table_config.memory_budget - slot_bytes) / sizeof(std::atomic<T>);
+    _slots = std::make_unique<HashedInfoset<T>[]>(_table_config.n_slots());
+    void* values = std::malloc(_values_capacity * sizeof(std::atomic<T>));
+    if(!values) throw std::bad_alloc{};
+    _values.reset(static_cast<std::atomic<T>*>(values));
+  }
+
+  void init_values(const size_t begin, const size_t end) {
+    for(size_t i = begin; i < end; ++i) new (&_values[i]) std::atomic<T>{T{0}};
+  }
+
+  void init_slot(HashedInfoset<T>& slot, const HashKey& key, const SlimPokerState& state) {
+    slot._check = key.check;
+    slot._table = this;
+    slot._branching_id = _config->action_mode.branching_id(state);
+    slot._value_id = _config->action_mode.value_id(state);
+    slot._n_clusters = _config->cluster_spec.n_clusters(state.get_round());
+    slot._n_value_actions = slot.get_value_actions().size();
+    slot._round = state.get_round();
+    const size_t n_values = slot.get_n_values();
+    slot._value_offset = _values_used.fetch_add(n_values, std::memory_order_relaxed);
+    if(slot._value_offset + n_values > _values_capacity) {
+      Logger::error("Hash table memory budget exhausted. Budget=" + std::to_string(_table_config.memory_budget) + " bytes");
+    }
+    init_values(slot._value_offset, slot._value_offset + n_values);
+    slot._ready.store(true, std::memory_order_release);
+  }
+
+  void record_insert(const size_t probe) {
+    _used_slots.fetch_add(1, std::memory_order_relaxed);
+    _probes.fetch_add(static_cast<long>(probe), std::memory_order_relaxed);
+    long max_probe = _max_probe.load(std::memory_order_relaxed);
+    while(static_cast<long>(probe) > max_probe && !_max_probe.compare_exchange_weak(max_probe, probe, std::memory_order_relaxed)) {}
+  }
+
+  struct FreeValues {
+    void operator()(std::atomic<T>* values) const { std::free(values); }
+  };
+
+  SlimPokerState _root_state;
+  std::shared_ptr<const TreeStorageConfig> _config;
+  HashTableConfig _table_config;
+  std::unique_ptr<HashedInfoset<T>[]> _slots;
+  std::unique_ptr<std::atomic<T>[], FreeValues> _values;
+  size_t _values_capacity = 0;
+  HashedInfoset<T>* _root = nullptr;
+  std::atomic<size_t> _values_used = 0;
+  std::atomic<size_t> _used_slots = 0;
+  std::atomic<long> _probes = 0;
+  std::atomic<long> _max_probe = 0;
+  mutable std::atomic<long> _collisions = 0;
+};
+
+}
@@ -1,4 +1,5 @@
 #include <cnpy.h>
+#include <algorithm>
 #include <memory>
 #include <numeric>
 #include <string>
@@ -32,23 +33,32 @@ FlopIndexer::FlopIndexer() {
 }
 
 CachedIndexer::CachedIndexer(const int max_round) : _max_round{max_round} {
-  hand_indexer_state_init(HandIndexer::get_instance()->get_indexer(max_round), &_state);
+  reset();
+}
+
+void CachedIndexer::reset() {
+  hand_indexer_state_init(HandIndexer::get_instance()->get_indexer(_max_round), &_state);
+  _n_indices = 0;
 }
 
 uint64_t CachedIndexer::index(const uint8_t cards[], const int round) {
-  while(static_cast<int>(_indices.size()) <= round) {
-    const int curr_round = static_cast<int>(_indices.size());
-    const int offset = curr_round == 0 ? 0 : n_board_cards(curr_round - 1) + 2;
-    _indices.push_back(hand_index_next_round(HandIndexer::get_instance()->get_indexer(_max_round), cards + offset, &_state));
+  while(_n_indices <= round) {
+    const int offset = _n_indices == 0 ? 0 : n_board_cards(_n_indices - 1) + 2;
+    _indices[_n_indices] = hand_index_next_round(HandIndexer::get_instance()->get_indexer(_max_round), cards + offset, &_state);
+    ++_n_indices;
   }
   return _indices[round];
 }
 
 uint64_t CachedIndexer::index(const Board& board, const Hand& hand, const int round) {
-  return _indices.size() > round ? _indices[round] : index(collect_cards(board, hand, round).data(), round);
+  if(_n_indices > round) return _indices[round];
+  uint8_t cards[7];
+  std::ranges::copy(hand.cards(), cards);
+  std::copy(board.cards().begin(), board.cards().begin() + n_board_cards(round), cards + 2);
+  return index(cards, round);
 }
 
-long count(const PokerState& state, const ActionProfile& action_profile, const int max_round, const bool infosets) {
+long count(const SlimPokerState& state, const ActionProfile& action_profile, const int max_round, const bool infosets) {
   if(state.is_terminal() || state.get_round() > max_round) {
     return 0;
   }
@@ -59,8 +69,10 @@ long count(const PokerState& state, const ActionProfile& action_profile, const i
   else {
     c = 1;
   }
-  for(const Action a : valid_actions(state, action_profile)) {
-    c += count(state.apply(a), action_profile, max_round, infosets);
+  const std::vector<Action>& actions = action_profile.get_actions(state);
+  const uint16_t valid = valid_action_mask(state, actions);
+  for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
+    if(valid >> a_idx & 1) c += count(state.apply_copy(actions[a_idx]), action_profile, max_round, infosets);
   }
   return c;
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <hand_isomorphism/hand_index.h>
 #include <pluribus/actions.hpp>
 #include <pluribus/poker.hpp>
@@ -62,9 +63,12 @@ public:
 
   hand_index_t index(const uint8_t cards[], int round);
   hand_index_t index(const Board& board, const Hand& hand, int round);
+  // forgets the cached indices to index the next deal without reallocating
+  void reset();
 private:
   hand_indexer_state_t _state{};
-  std::vector<hand_index_t> _indices;
+  std::array<hand_index_t, 4> _indices{};
+  int _n_indices = 0;
   int _max_round;
 };
 
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <pluribus/lbr.hpp>
+#include <pluribus/logging.hpp>
+#include <pluribus/mccfr.hpp>
+#include <pluribus/rng.hpp>
+#include <pluribus/sampling.hpp>
+#include <pluribus/util.hpp>
+
+namespace pluribus {
+
+void ComboRanks::evaluate(const Board& board, const omp::HandEvaluator& eval) {
+  omp::Hand board_hand = omp::Hand::empty();
+  for(const uint8_t card : board.cards()) board_hand += omp::Hand(card);
+  const HoleCardIndexer* indexer = HoleCardIndexer::get_instance();
+  for(int h_idx = 0; h_idx < MAX_COMBOS; ++h_idx) {
+    const Hand hand = indexer->hand(h_idx);
+    const bool is_live = !(hand.mask() & board.mask());
+    ranks[h_idx] = is_live ? eval.evaluate(board_hand + hand.cards()[0] + hand.cards()[1]) : 0;
+    live[h_idx] = is_live ? 1.0f : 0.0f;
+  }
+}
+
+void ComboRanks::showdown(const uint16_t rank, const float weights[], double& value, double& total) const {
+  float v = 0.0f;
+  float w_sum = 0.0f;
+#pragma omp simd reduction(+:v, w_sum)
+  for(int h_idx = 0; h_idx < MAX_COMBOS; ++h_idx) {
+    const float w = weights[h_idx] * live[h_idx];
+    v += w * (static_cast<float>(rank > ranks[h_idx]) + 0.5f * static_cast<float>(rank == ranks[h_idx]));
+    w_sum += w;
+  }
+  value += v;
+  total += w_sum;
+}
+
+struct LocalBestResponse::Scratch {
+  std::array<float, MAX_COMBOS> range{};
+  std::array<float, MAX_COMBOS> call_range{};
+  std::vector<ComboRanks> runouts;
+};
+
+LocalBestResponse::LocalBestResponse(const DecisionAlgorithm& decision, const SolverConfig& config, const LBRConfig& lbr_config)
+    : _decision{decision}, _config{config}, _lbr_config{lbr_config} {
+  if(config.init_state.active_players() != 2) {
+    Logger::error("Local best response requires two active players. Active players: " + std::to_string(config.init_state.active_players()));
+  }
+  int n_active = 0;
+  for(int p = 0; p < config.init_state.get_players().size(); ++p) {
+    if(!config.init_state.get_players()[p].has_folded()) _players[n_active++] = p;
+  }
+  _combos.reserve(MAX_COMBOS);
+  _combo_masks.reserve(MAX_COMBOS);
+  for(int h_idx = 0; h_idx < MAX_COMBOS; ++h_idx) {
+    _combos.push_back(HoleCardIndexer::get_instance()->hand(h_idx));
+    _combo_masks.push_back(_combos.back().mask());
+  }
+}
+
+ResultEV LocalBestResponse::evaluate() const {
+  const auto t_0 = std::chrono::high_resolution_clock::now();
+  double w_sum = 0.0, w_sum2 = 0.0, wx_sum = 0.0, wx2_sum = 0.0;
+  #pragma omp parallel reduction(+:w_sum, w_sum2, wx_sum, wx2_sum)
+  {
+    RoundSampler sampler{_config.init_ranges, _config.init_board};
+    const omp::HandEvaluator eval;
+    RoundSample sample = sampler.sample();
+    #pragma omp for schedule(dynamic, 16)
+    for(long h = 0; h < _lbr_config.hands; ++h) {
+      FastRNG::seed(_lbr_config.seed, h, 0);
+      sampler.next_sample(sample);
+      const Board board = sample_board(_config.init_board, sample.mask);
+      const double u = play(_players[h % 2], sample.hands, board, eval);
+      w_sum += sample.weight;
+      w_sum2 += sample.weight * sample.weight;
+      wx_sum += sample.weight * u;
+      wx2_sum += sample.weight * u * u;
+    }
+  }
+  const double mean = w_sum > 0.0 ? wx_sum / w_sum : 0.0;
+  const double S = std::max(wx2_sum - w_sum * mean * mean, 0.0);
+  const double std_err = w_sum * w_sum > w_sum2 ? std::sqrt(S / (w_sum * w_sum - w_sum2)) : 0.0;
+  const long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t_0).count();
+  return ResultEV{mean, w_sum > 0.0 ? standard_deviation(S, w_sum) : 0.0, std_err, _lbr_config.hands, ms};
+}
+
+double LocalBestResponse::play(const int i, const std::vector<Hand>& hands, const Board& board, const omp::HandEvaluator& eval) const {
+  const int opp = _players[0] == i ? _players[1] : _players[0];
+  Scratch scratch;
+  const std::vector<double>& init_weights = _config.init_ranges[opp].weights();
+  for(int h_idx = 0; h_idx < MAX_COMBOS; ++h_idx) scratch.range[h_idx] = static_cast<float>(init_weights[h_idx]);
+  PokerState state = _config.init_state;
+  int round = -1;
+  while(!state.is_terminal()) {
+    if(state.get_round() != round) {
+      round = state.get_round();
+      remove_cards(hands[i].mask() | card_mask(board.cards().data(), n_board_cards(round)), scratch.range.data());
+    }
+    Action a = Action::CHECK_CALL;
+    if(state.get_active() == i) {
+      a = best_response(state, i, hands[i], board, scratch, eval);
+    }
+    else if(_decision.has_strategy(state)) {
+      const std::vector<Action> actions = valid_actions(state, _config.action_profile);
+      float freq[MAX_ACTIONS];
+      for(int a_idx = 0; a_idx < actions.size(); ++a_idx) freq[a_idx] = _decision.frequency(actions[a_idx], state, board, hands[opp]);
+      a = actions[sample_action_idx(freq, actions.size())];
+      update_range(a, state, board, scratch.range.data());
+    }
+    state = state.apply(a);
+  }
+  return utility(state, i, board, hands, _config.infer_stack_size(i), _config.rake, eval);
+}
+
+Action LocalBestResponse::best_response(const PokerState& state, const int i, const Hand& hand, const Board& board, Scratch& scratch,
+    const omp::HandEvaluator& eval) const {
+  // the board cards the LBR player has not seen yet are replaced by sampled runouts
+  const int n_visible = n_board_cards(state.get_round());
+  const int n_runouts = n_visible == 5 ? 1 : _lbr_config.runouts;
+  scratch.runouts.resize(n_runouts);
+  for(ComboRanks& runout : scratch.runouts) {
+    std::vector<uint8_t> cards{board.cards().begin(), board.cards().begin() + n_visible};
+    uint64_t mask = hand.mask() | card_mask(cards);
+    while(cards.size() < 5) {
+      const auto card = static_cast<uint8_t>(FastRNG::uniform_int(MAX_CARDS));
+      if(mask & card_mask(card)) continue;
+      mask |= card_mask(card);
+      cards.push_back(card);
+    }
+    runout.evaluate(Board{cards}, eval);
+  }
+  const int hand_idx = HoleCardIndexer::get_instance()->index(hand);
+  const auto equity = [&scratch, hand_idx](const float weights[]) {
+    double value = 0.0, total = 0.0;
+    for(const ComboRanks& runout : scratch.runouts) runout.showdown(runout.ranks[hand_idx], weights, value, total);
+    return total > 0.0 ? value / total : 0.5;
+  };
+
+  // values assume that the hand is checked down after calling, rake is ignored
+  const double range_equity = equity(scratch.range.data());
+  Action best_action = Action::CHECK_CALL;
+  double best_value = -std::numeric_limits<double>::infinity();
+  for(const Action a : valid_actions(state, _config.action_profile)) {
+    const PokerState next_state = state.apply(a);
+    double value;
+    if(a == Action::FOLD) {
+      value = -invested(state, i);
+    }
+    else if(a == Action::CHECK_CALL) {
+      value = range_equity * next_state.get_pot().total() - invested(next_state, i);
+    }
+    else {
+      const bool covered = !next_state.is_terminal() && _decision.has_strategy(next_state);
+      double fold_weight = 0.0, weight = 0.0;
+      for(int h_idx = 0; h_idx < MAX_COMBOS; ++h_idx) {
+        const float w = scratch.range[h_idx];
+        const float fold = covered && w > 0.0f ? _decision.frequency(Action::FOLD, next_state, board, _combos[h_idx]) : 0.0f;
+        scratch.call_range[h_idx] = w * (1.0f - fold);
+        fold_weight += w * fold;
+        weight += w;
+      }
+      const double fold_p = weight > 0.0 ? fold_weight / weight : 0.0;
+      const PokerState called_state = next_state.is_terminal() ? next_state : next_state.apply(Action::CHECK_CALL);
+      value = fold_p * (next_state.get_pot().total() - invested(next_state, i)) +
+          (1.0 - fold_p) * (equity(scratch.call_range.data()) * called_state.get_pot().total() - invested(called_state, i));
+    }
+    if(value > best_value) {
+      best_value = value;
+      best_action = a;
+    }
+  }
+  return best_action;
+}
+
+void LocalBestResponse::update_range(const Action a, const PokerState& state, const Board& board, float weights[]) const {
+  for(int h_idx = 0; h_idx < MAX_COMBOS; ++h_idx) {
+    if(weights[h_idx] > 0.0f) weights[h_idx] *= _decision.frequency(a, state, board, _combos[h_idx]);
+  }
+}
+
+void LocalBestResponse::remove_cards(const uint64_t mask, float weights[]) const {
+  for(int h_idx = 0; h_idx < MAX_COMBOS; ++h_idx) {
+    if(_combo_masks[h_idx] & mask) weights[h_idx] = 0.0f;
+  }
+}
+
+}
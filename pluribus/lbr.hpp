@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <omp/HandEvaluator.h>
+#include <pluribus/config.hpp>
+#include <pluribus/constants.hpp>
+#include <pluribus/decision.hpp>
+#include <pluribus/ev.hpp>
+#include <pluribus/poker.hpp>
+
+namespace pluribus {
+
+struct LBRConfig {
+  // iterations between evaluations of a training run, checked on log steps so it should be a multiple of the log interval. 0, the default,
+  // disables them. An evaluation blocks a training thread, see MCCFRSolver::set_lbr_config
+  long interval = 0;
+  long hands = 10'000;
+  // sampled board completions per showdown estimate before the river
+  int runouts = 4;
+  // opponent actions and runouts of hand h are drawn from the FastRNG stream (seed, h), so evaluations of a run are comparable
+  uint64_t seed = 42;
+
+  bool is_lbr_step(const long t) const { return interval > 0 && (t + 1) % interval == 0; }
+};
+
+// Showdown ranks of every hole card combo on a complete board. Combos that collide with the board are not live.
+struct ComboRanks {
+  void evaluate(const Board& board, const omp::HandEvaluator& eval);
+  // Adds the combo weights and the weighted showdown value (1 for a win, 0.5 for a tie) of a hand of the given rank against them. Runs over
+  // all combos without branches, so the compiler vectorizes it.
+  void showdown(uint16_t rank, const float weights[], double& value, double& total) const;
+
+  std::array<uint16_t, MAX_COMBOS> ranks{};
+  std::array<float, MAX_COMBOS> live{};
+};
+
+// Local best response (Lisy & Bowling, 2017) of a heads up spot against a strategy. The LBR player tracks the opponent's range with Bayes' rule
+// and takes the action that maximizes its value assuming the hand is checked down afterwards: folding, calling, or raising against the range
+// that does not fold. The opponent plays the strategy with its actual hand. The average payoff of the LBR player is a lower bound of the
+// exploitability of the strategy. Nodes the strategy does not cover (see DecisionAlgorithm::has_strategy) are played as check/call.
+class LocalBestResponse {
+public:
+  LocalBestResponse(const DecisionAlgorithm& decision, const SolverConfig& config, const LBRConfig& lbr_config = LBRConfig{});
+
+  // Average payoff of the LBR player in chips per hand, alternating between both players. Deals are sampled with RoundSampler from the
+  // initial ranges, hands are played in parallel.
+  ResultEV evaluate() const;
+  // payoff of the LBR player i in a single hand
+  double play(int i, const std::vector<Hand>& hands, const Board& board, const omp::HandEvaluator& eval) const;
+
+private:
+  struct Scratch;
+
+  Action best_response(const PokerState& state, int i, const Hand& hand, const Board& board, Scratch& scratch,
+      const omp::HandEvaluator& eval) const;
+  void update_range(Action a, const PokerState& state, const Board& board, float weights[]) const;
+  void remove_cards(uint64_t mask, float weights[]) const;
+  int invested(const SlimPokerState& state, int i) const { return _config.infer_stack_size(i) - state.get_players()[i].get_chips(); }
+
+  const DecisionAlgorithm& _decision;
+  const SolverConfig _config;
+  const LBRConfig _lbr_config;
+  std::array<int, 2> _players{};
+  std::vector<Hand> _combos;
+  std::vector<uint64_t> _combo_masks;
+};
+
+// milli big blinds of a payoff in chips, the big blind is 100 chips
+inline double to_mbb(const double chips) { return chips * 10.0; }
+
+}
@@ -1,7 +1,10 @@
+#include <iomanip>
 #include <iostream>
 #include <pluribus/blueprint.hpp>
 #include <pluribus/cluster.hpp>
+#include <pluribus/distributed.hpp>
 #include <pluribus/earth_movers_dist.hpp>
+#include <pluribus/lbr.hpp>
 #include <pluribus/poker.hpp>
 #include <pluribus/range_viewer.hpp>
 #include <pluribus/traverse.hpp>
@@ -15,6 +18,10 @@ void traverse_strategy(RangeViewer* viewer_p, const std::string& fn, const std::
     Logger::log("Traversing blueprint: " + fn);
     traverse_blueprint(viewer_p, fn);
   }
+  else if(type == "--flat-blueprint") {
+    Logger::log("Traversing flat blueprint: " + fn);
+    traverse_flat_blueprint(viewer_p, fn);
+  }
   else if(type == "--tree") {
     Logger::log("Traversing tree: " + fn);
     traverse_tree(viewer_p, fn);
@@ -90,6 +97,7 @@ int main(int argc, char* argv[]) {
   }
   else if(command == "traverse") {
     // ./Pluribus traverse --blueprint --png out.png lossless_bp_fn
+    // ./Pluribus traverse --flat-blueprint --png out.png flat_lossless_bp_fn
     // ./Pluribus traverse --tree --png out.png snapshot_fn
     if(argc > 5 && strcmp(argv[3], "--png") == 0) {
       PngRangeViewer viewer{argv[4]};
@@ -176,6 +184,79 @@ int main(int argc, char* argv[]) {
       cereal_save(lossless_bp, argv[3]);
     }
   }
+  else if(command == "flat-blueprint") {
+    // ./Pluribus flat-blueprint --lossless/--sampled bp_fn out_fn
+    if(argc < 5) {
+      std::cout << "Missing arguments to export flat blueprint.\n";
+    }
+    else if(strcmp(argv[2], "--lossless") == 0) {
+      LosslessBlueprint bp;
+      cereal_load(bp, argv[3]);
+      bp.save_flat(argv[4]);
+    }
+    else if(strcmp(argv[2], "--sampled") == 0) {
+      SampledBlueprint bp;
+      cereal_load(bp, argv[3]);
+      bp.save_flat(argv[4]);
+    }
+    else {
+      std::cout << "Invalid flat blueprint mode: " << argv[2] << "\n";
+    }
+  }
+  else if(command == "distributed-blueprint") {
+    // ./Pluribus distributed-blueprint snapshot_fn worker_idx n_workers run_id t_plus [sync_interval] [sync_dir]
+    // start one process per worker_idx in [0, n_workers), all from the same snapshot and with the same run_id, which must be new for every run
+    if(argc < 7) {
+      std::cout << "Missing arguments to train distributed blueprint.\n";
+    }
+    else {
+      DistributedConfig dist_config;
+      dist_config.worker_idx = atoi(argv[3]);
+      dist_config.n_workers = atoi(argv[4]);
+      dist_config.run_id = argv[5];
+      if(argc > 7) dist_config.sync_interval = atol(argv[7]);
+      if(argc > 8) dist_config.sync_dir = argv[8];
+      DistributedTreeBlueprintSolver solver{dist_config};
+      solver.load_snapshot(argv[2]);
+      solver.solve(atol(argv[6]));
+    }
+  }
+  else if(command == "lbr") {
+    // ./Pluribus lbr --blueprint lossless_bp_fn [hands]
+    // ./Pluribus lbr --flat-blueprint flat_lossless_bp_fn [hands]
+    // ./Pluribus lbr --tree snapshot_fn [hands]
+    if(argc < 4) {
+      std::cout << "Missing arguments to evaluate local best response.\n";
+    }
+    else {
+      LBRConfig lbr_config;
+      if(argc > 4) lbr_config.hands = atol(argv[4]);
+      ResultEV result;
+      if(strcmp(argv[2], "--blueprint") == 0) {
+        LosslessBlueprint bp;
+        cereal_load(bp, argv[3]);
+        const TreeDecision decision{bp.get_strategy(), bp.get_config().init_state, false};
+        result = LocalBestResponse{decision, bp.get_config(), lbr_config}.evaluate();
+      }
+      else if(strcmp(argv[2], "--flat-blueprint") == 0) {
+        const MappedLosslessBlueprint bp{argv[3]};
+        const TreeDecision decision{bp.get_strategy(), bp.get_config().init_state, false};
+        result = LocalBestResponse{decision, bp.get_config(), lbr_config}.evaluate();
+      }
+      else if(strcmp(argv[2], "--tree") == 0) {
+        TreeBlueprintSolver solver;
+        solver.load_snapshot(argv[3]);
+        const TreeDecision decision{solver.get_strategy(), solver.get_config().init_state, false};
+        result = LocalBestResponse{decision, solver.get_config(), lbr_config}.evaluate();
+      }
+      else {
+        std::cout << "Invalid LBR mode: " << argv[2] << "\n";
+        return 1;
+      }
+      std::cout << result.to_string();
+      std::cout << std::fixed << std::setprecision(1) << "LBR=" << to_mbb(result.ev) << " mbb/g, stdErr=" << to_mbb(result.std_err) << " mbb/g\n";
+    }
+  }
   else {
     std::cout << "Unknown command." << std::endl;
   }
@@ -14,8 +14,10 @@
 #include <pluribus/logging.hpp>
 #include <pluribus/mccfr.hpp>
 #include <pluribus/poker.hpp>
+#include <pluribus/pruning.hpp>
 #include <pluribus/rng.hpp>
 #include <pluribus/traverse.hpp>
+#include <pluribus/tree_visitor.hpp>
 #include <pluribus/util.hpp>
 #include <tqdm/tqdm.hpp>
 
@@ -25,10 +27,9 @@ namespace pluribus {
 
 static constexpr int PRUNE_CUTOFF = -300'000'000;
 static constexpr int REGRET_FLOOR = -310'000'000;
-static constexpr int MAX_ACTIONS = 16;
+static constexpr float BASELINE_STEP = 0.125f;
 
-int utility(const SlimPokerState& state, const int i, const Board& board, const std::vector<Hand>& hands, const int stack_size, const RakeStructure& rake,
-    const omp::HandEvaluator& eval) {
+int utility(const SlimPokerState& state, const int i, const ShowdownRanks& ranks, const int stack_size, const RakeStructure& rake) {
   if(state.get_players()[i].has_folded()) {
     return state.get_players()[i].get_chips() - stack_size;
   }
@@ -36,11 +37,29 @@ int utility(const SlimPokerState& state, const int i, const Board& board, const
     return state.get_players()[i].get_chips() - stack_size + (state.get_winner() == i ? rake.payoff(state.get_round(), state.get_pot().total()) : 0);
   }
   if(state.get_round() >= 4) {
-    return state.get_players()[i].get_chips() - stack_size + showdown_payoff(state, i, board, hands, rake, eval);
+    return state.get_players()[i].get_chips() - stack_size + showdown_payoff(state, i, ranks, rake);
   }
   Logger::error("Non-terminal state does not have utility.");
 }
 
+int utility(const SlimPokerState& state, const int i, const Board& board, const std::vector<Hand>& hands, const int stack_size, const RakeStructure& rake,
+    const omp::HandEvaluator& eval) {
+  const bool showdown = !state.get_players()[i].has_folded() && state.get_winner() == -1 && state.get_round() >= 4;
+  return utility(state, i, showdown ? ShowdownRanks{board, hands, eval} : ShowdownRanks{}, stack_size, rake);
+}
+
+// Value of an external sampling node given the value v of the sampled action. With baselines b (keyed by the traverser's cluster), the control
+// variate estimate sum_a freq[a] * b[a] + v - b[a_idx] is unbiased for any b since a_idx was drawn from freq, and has low variance where b tracks
+// the action values. The baseline of the sampled action then moves towards v.
+int sampled_value(const int v, const int a_idx, const float freq[], const int n_actions, std::atomic<float>* baselines) {
+  if(!baselines) return v;
+  double expected = 0.0;
+  for(int b_idx = 0; b_idx < n_actions; ++b_idx) expected += freq[b_idx] * baselines[b_idx].load(std::memory_order_relaxed);
+  const float b = baselines[a_idx].load(std::memory_order_relaxed);
+  baselines[a_idx].store(b + BASELINE_STEP * (static_cast<float>(v) - b), std::memory_order_relaxed);
+  return static_cast<int>(std::lrint(expected + v - b));
+}
+
 Solver::Solver(const SolverConfig& config) : _config{config} {
   if(config.init_board.size() != n_board_cards(config.init_state.get_round())) {
     Logger::error("Wrong amount of solver board cards. Round=" + round_to_str(config.init_state.get_round()) + 
@@ -80,7 +99,16 @@ void MCCFRSolver<StorageT>::_solve(long t_plus) {
   on_start();
 
   Logger::log("Training blueprint from " + std::to_string(_t) + " to " + std::to_string(T));
+  if(!_seed) _seed = mix_seed(std::random_device{}());
+  Logger::log("Seed: " + std::to_string(*_seed));
+  _deal_buffers.assign(omp_get_max_threads(), DealBuffer{});
   std::ostringstream buf;
+  std::future<void> pending_snapshot;
+  const auto finish_snapshot = [&]() {
+    if(!pending_snapshot.valid()) return;
+    pending_snapshot.get();
+    on_snapshot();
+  };
   while(_t < T) {
     long init_t = _t;
     _t = next_step(_t, T); 
@@ -88,51 +116,35 @@ void MCCFRSolver<StorageT>::_solve(long t_plus) {
     buf << std::setprecision(1) << std::fixed << "Next step: " << _t / 1'000'000.0 << "M";
     Logger::dump(buf);
     auto t_0 = std::chrono::high_resolution_clock::now();
+    long init_deal_ns = 0;
+    for(const DealBuffer& deals : _deal_buffers) init_deal_ns += deals.generation_ns();
     if(is_debug) omp_set_num_threads(1);
-    #pragma omp parallel for schedule(dynamic, 1)
-    for(long t = init_t; t < _t; ++t) {
-      if(is_interrupted()) continue;
-      thread_local omp::HandEvaluator eval;
-      thread_local Board board;
-      thread_local MarginalRejectionSampler sampler{get_config().init_ranges, get_config().init_board, get_config().dead_ranges};
-      if(is_debug) Logger::log("============== t = " + std::to_string(t) + " ==============");
-      if(should_log(t)) {
-        std::ostringstream metrics_fn;
-        metrics_fn << std::setprecision(1) << std::fixed << t / 1'000'000.0 << ".json";
-        write_to_file(_metrics_dir / metrics_fn.str(), track_wandb_metrics(t));
-        Logger::log(progress_str(t - init_t, _t - init_t, t_0));
+    if(_task_depth > 0) {
+      // iterations are tasks as well, a thread that is waiting for the subtrees of its iteration only runs tasks of that iteration
+      #pragma omp parallel
+      #pragma omp single
+      for(long t = init_t; t < _t; ++t) {
+        #pragma omp task firstprivate(t)
+        run_iteration(t, init_t, t_0);
       }
-      for(int i = 0; i < get_config().poker.n_players; ++i) {
-        if(is_debug) Logger::log("============== i = " + std::to_string(i) + " ==============");
-        RoundSample sample = sampler.sample();
-        board = sample_board(get_config().init_board, sample.mask);
-        std::vector<CachedIndexer> indexers(get_config().poker.n_players);
-        std::array<std::vector<uint16_t>, 4> clusters;
-        for(int r = get_config().init_state.get_round(); r < 4; ++r) {
-          for(int h_idx = 0; h_idx < sample.hands.size(); ++h_idx) {
-            indexers[h_idx].index(board, sample.hands[h_idx], 3);
-            clusters[r].push_back(get_cluster(r, board, sample.hands[h_idx], indexers[h_idx]));
-          }
-        }
-        on_step(t, i, sample.hands, clusters);
-        SlimPokerState state{get_config().init_state};
-        SlimPokerState bp_state{get_config().init_state};
-        MCCFRContext<StorageT> ctx{state, t, i, 0, board, sample.hands, clusters, eval, init_regret_storage(), init_bp_node(), bp_state};
-        initialize_context(ctx);
-        if(should_prune(t)) {
-          if(is_debug) Logger::log("============== Traverse MCCFR-P ==============");
-          traverse_mccfr_p(ctx);
-        }
-        else {
-          if(is_debug) Logger::log("============== Traverse MCCFR ==============");
-          traverse_mccfr(ctx);
-        }
+    }
+    else {
+      #pragma omp parallel for schedule(dynamic, 1)
+      for(long t = init_t; t < _t; ++t) {
+        run_iteration(t, init_t, t_0);
       }
     }
     if(is_interrupted()) break;
     auto interval_end = std::chrono::high_resolution_clock::now();
     buf << "Step duration: " << std::chrono::duration_cast<std::chrono::seconds>(interval_end - interval_start).count() << " s.";
     Logger::dump(buf);
+    long deal_ns = -init_deal_ns;
+    for(const DealBuffer& deals : _deal_buffers) deal_ns += deals.generation_ns();
+    const double worker_ns = std::chrono::duration<double, std::nano>(interval_end - t_0).count() * omp_get_max_threads();
+    buf << std::setprecision(1) << std::fixed << "Deal generation: " << 100.0 * deal_ns / std::max(worker_ns, 1.0) << "% of worker time.";
+    Logger::dump(buf);
+    on_step_end(_t, T);
+    finish_snapshot();
     if(should_discount(_t) && !is_interrupted()) {
       Logger::log("============== Discounting ==============");
       double d = get_discount_factor(_t);
@@ -144,17 +156,61 @@ void MCCFRSolver<StorageT>::_solve(long t_plus) {
     if(should_snapshot(_t, T)) {
       std::ostringstream fn_stream;
       Logger::log("============== Saving snapshot ==============");
-      fn_stream << date_time_str() << "_t" << std::setprecision(1) << std::fixed << _t / 1'000'000.0 << "M.bin";
-      save_snapshot((_snapshot_dir / fn_stream.str()).string());
-      on_snapshot();
+      fn_stream << date_time_str() << "_t" << std::setprecision(1) << std::fixed << _t / 1'000'000.0 << "M";
+      const int n_threads = _async_snapshots ? std::max(omp_get_max_threads() / 4, 1) : omp_get_max_threads();
+      auto remaining = prepare_snapshot((_snapshot_dir / fn_stream.str()).string(), n_threads);
+      if(_async_snapshots && remaining) {
+        pending_snapshot = std::async(std::launch::async, std::move(remaining));
+      }
+      else {
+        if(remaining) remaining();
+        on_snapshot();
+      }
     }
   }
+  finish_snapshot();
   Logger::log(is_interrupted() ? "====================== Interrupted ======================" : "============== Blueprint training complete ==============");
 }
 
+template <template<typename> class StorageT>
+void MCCFRSolver<StorageT>::run_iteration(const long t, const long init_t, const std::chrono::high_resolution_clock::time_point t_0) {
+  if(is_interrupted()) return;
+  thread_local omp::HandEvaluator eval;
+  thread_local MarginalRejectionSampler sampler{get_config().init_ranges, get_config().init_board, get_config().dead_ranges};
+  if(is_debug) Logger::log("============== t = " + std::to_string(t) + " ==============");
+  if(should_log(t)) {
+    std::ostringstream metrics_fn;
+    metrics_fn << std::setprecision(1) << std::fixed << t / 1'000'000.0 << ".json";
+    write_to_file(_metrics_dir / metrics_fn.str(), track_wandb_metrics(t));
+    Logger::log(progress_str(t - init_t, _t - init_t, t_0));
+  }
+  for(int i = 0; i < get_config().poker.n_players; ++i) {
+    if(is_debug) Logger::log("============== i = " + std::to_string(i) + " ==============");
+    FastRNG::seed(*_seed, t, i);
+    const IterationScratch& deal = _deal_buffers[omp_get_thread_num()].next(sampler, get_config().init_board,
+        get_config().init_state.get_round(),
+        [this](const int r, const Board& board, const Hand& hand, CachedIndexer& indexer) { return get_cluster(r, board, hand, indexer); });
+    const std::vector<Hand>& hands = deal.sample.hands;
+    on_step(t, i, hands, deal.clusters);
+    const ShowdownRanks ranks{deal.board, hands, eval};
+    SlimPokerState state{get_config().init_state};
+    SlimPokerState bp_state{get_config().init_state};
+    MCCFRContext<StorageT> ctx{state, t, i, 0, deal.board, hands, deal.clusters, ranks, init_regret_storage(), init_bp_node(), bp_state};
+    initialize_context(ctx);
+    if(should_prune(t)) {
+      if(is_debug) Logger::log("============== Traverse MCCFR-P ==============");
+      traverse_mccfr_p(ctx);
+    }
+    else {
+      if(is_debug) Logger::log("============== Traverse MCCFR ==============");
+      traverse_mccfr(ctx);
+    }
+  }
+}
+
 template<template <typename> class StorageT>
 int MCCFRSolver<StorageT>::terminal_utility(const MCCFRContext<StorageT>& context) const {
-  return utility(context.state, context.i, context.board, context.hands, get_config().init_chips[context.i], get_config().rake, context.eval);
+  return utility(context.state, context.i, context.ranks, get_config().init_chips[context.i], get_config().rake);
 }
 
 template <template<typename> class StorageT>
@@ -234,28 +290,20 @@ inline int next_consec_folds(const int consec_folds, const Action a) {
   return consec_folds > -1 && a == Action::FOLD ? consec_folds + 1 : -1;
 }
 
-template<class T>
-int sample_idx_from_regrets(const std::atomic<T>* base_ptr, const int n_actions) {
+// freq, if given, receives the sampling distribution
+int sample_idx_from_regrets(const RegretRow& row, const int n_actions, float freq[] = nullptr) {
+  int buffer[MAX_ACTIONS];
   float w_local[MAX_ACTIONS];
-  float S = 0.0f;
-  for(int i = 0; i < n_actions; ++i) {
-    const float v = static_cast<float>(base_ptr[i].load(std::memory_order_relaxed));
-    const float w = v > 0.0f ? v : 0.0f;
-    w_local[i] = w;
-    S += w;
-  }
-  const float u01 = GSLGlobalRNG::uniform();
+  const float S = positive_part(row.values(buffer, n_actions), n_actions, w_local);
+  if(freq) {
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) freq[a_idx] = S > 0.0f ? w_local[a_idx] / S : 1.0f / n_actions;
+  }
+  const float u01 = FastRNG::uniform();
   if(S <= 0.0f) {
     const int k = static_cast<int>(u01 * n_actions);
     return k < n_actions ? k : n_actions - 1;
   }
-  const float threshold = u01 * S;
-  float c = 0.0f;
-  for(int i=0; i<n_actions; ++i) {
-    c += w_local[i];
-    if(c >= threshold) return i;
-  }
-  return n_actions - 1;
+  return sample_cumulative(w_local, n_actions, u01 * S);
 }
 
 template <template<typename> class StorageT>
@@ -274,7 +322,8 @@ int MCCFRSolver<StorageT>::traverse_mccfr_p(MCCFRContext<StorageT>& ctx) {
     const int n_value_actions = value_actions.size();
     const int cluster = ctx.clusters[ctx.state.get_round()][ctx.state.get_active()];
     if(is_debug) Logger::log("Cluster: " + std::to_string(cluster));
-    std::atomic<int>* base_ptr = get_base_regret_ptr(ctx.regret_storage, cluster);
+    RegretRow regrets = get_regret_row(ctx.regret_storage, cluster);
+    std::atomic<uint32_t>* prune_records = get_prune_records(ctx.regret_storage, cluster);
 
     int values[MAX_ACTIONS];
     bool filter[MAX_ACTIONS];
@@ -284,8 +333,10 @@ int MCCFRSolver<StorageT>::traverse_mccfr_p(MCCFRContext<StorageT>& ctx) {
     int filter_sum = 0;
     for(int a_idx = 0; a_idx < n_value_actions; ++a_idx) {
       Action a = value_actions[a_idx];
-      const int regret = base_ptr[a_idx].load(std::memory_order_relaxed);
-      if(ctx.state.get_round() == 3 || a == Action::FOLD || regret > PRUNE_CUTOFF || is_terminal_call(a, ctx.i, ctx.state)) {
+      const int regret = regrets.load(a_idx);
+      const bool prunable = ctx.state.get_round() != 3 && a != Action::FOLD && !is_terminal_call(a, ctx.i, ctx.state);
+      const bool pruned = prunable && (prune_records ? PruneRecord::skip(prune_records[a_idx], regret, PRUNE_CUTOFF) : regret <= PRUNE_CUTOFF);
+      if(!pruned) {
         if(is_debug) Logger::log("[" + pos_to_str(ctx.state) + "] Applying (traverser): " + a.to_string());
         filter[a_idx] = true;
         ++filter_sum;
@@ -311,13 +362,12 @@ int MCCFRSolver<StorageT>::traverse_mccfr_p(MCCFRContext<StorageT>& ctx) {
     if(!is_frozen(cluster, ctx.regret_storage)) {
       for(int a_idx = 0; a_idx < n_value_actions; ++a_idx) {
         if(filter[a_idx]) {
-          auto& r_atom = base_ptr[a_idx];
-          const int prev_r = r_atom.load(std::memory_order_relaxed);
+          const int prev_r = regrets.load(a_idx);
           int d_r = values[a_idx] - v;
           const int next_r = prev_r + d_r;
           if(is_debug && next_r > 2'000'000'000) Logger::error("Regret overflowing!\n" + info_str(prev_r, d_r, ctx));
           if(next_r > REGRET_FLOOR) {
-            r_atom.fetch_add(d_r, std::memory_order_relaxed);
+            regrets.add(a_idx, d_r);
           }
           if(is_debug) log_regret(value_actions[a_idx], d_r, next_r);
         }
@@ -327,7 +377,9 @@ int MCCFRSolver<StorageT>::traverse_mccfr_p(MCCFRContext<StorageT>& ctx) {
   }
   const auto& value_actions = regret_value_actions(ctx.regret_storage);
   const auto& branching_actions = regret_branching_actions(ctx.regret_storage);
-  const int a_idx = external_sampling(value_actions, ctx);
+  float freq[MAX_ACTIONS];
+  const int a_idx = external_sampling(value_actions, ctx, freq);
+  std::atomic<float>* baselines = get_baselines(ctx.regret_storage, ctx.clusters[ctx.state.get_round()][ctx.i]);
   const Action a = value_actions[a_idx];
   if(is_debug) Logger::log("[" + pos_to_str(ctx.state) + "] Applying (external): " + a.to_string());
   auto next_node = next_bp_node(a, ctx.state, ctx.bp_node, ctx.bp_state);
@@ -336,7 +388,9 @@ int MCCFRSolver<StorageT>::traverse_mccfr_p(MCCFRContext<StorageT>& ctx) {
   ctx.regret_storage = next_regret_storage(ctx.regret_storage, branching_idx, ctx.state, ctx.i);
   ctx.bp_node = next_node;
   ctx.consec_folds = next_consec_folds(ctx.consec_folds, a);
-  return traverse_mccfr_p(ctx);
+  ++ctx.depth;
+  const int v = traverse_mccfr_p(ctx);
+  return sampled_value(v, a_idx, freq, value_actions.size(), baselines);
 }
 
 template <template<typename> class StorageT>
@@ -355,38 +409,47 @@ int MCCFRSolver<StorageT>::traverse_mccfr(MCCFRContext<StorageT>& ctx) {
     const int n_value_actions = value_actions.size();
     const int cluster = ctx.clusters[ctx.state.get_round()][ctx.state.get_active()];
     if(is_debug) Logger::log("Cluster: " + std::to_string(cluster));
-    std::atomic<int>* base_ptr = get_base_regret_ptr(ctx.regret_storage, cluster);
+    RegretRow regrets = get_regret_row(ctx.regret_storage, cluster);
     int values[MAX_ACTIONS];
-    double v_exact = 0.0;
-    double v_r_sum = 0.0;
-    double v_a_sum = 0.0;
+    const bool spawn = ctx.depth < _task_depth;
     for(int a_idx = 0; a_idx < n_value_actions; ++a_idx) {
       Action a = value_actions[a_idx];
       if(is_debug) Logger::log("[" + pos_to_str(ctx.state) + "] Applying (traverser): " + a.to_string());
       const int branching_idx = n_value_actions == branching_actions.size() ? a_idx : 0;
+      if(spawn) {
+        #pragma omp task default(shared) firstprivate(a, a_idx, branching_idx)
+        values[a_idx] = traverse_mccfr_task(ctx, a, branching_idx, mix_seed(ctx.stream + a_idx + 1));
+        continue;
+      }
       SlimPokerState next_state = ctx.state.apply_copy(a);
       MCCFRContext<StorageT> next_ctx{next_state, next_regret_storage(ctx.regret_storage, branching_idx, next_state, ctx.i),
         next_bp_node(a, ctx.state, ctx.bp_node, ctx.bp_state), next_consec_folds(ctx.consec_folds, a), ctx};
-      const int v_a = traverse_mccfr(next_ctx);
-      const int v_r = std::max(base_ptr[a_idx].load(std::memory_order_relaxed), 0);
-      values[a_idx] = v_a;
-      v_exact += static_cast<double>(v_r) * static_cast<double>(v_a);
+      values[a_idx] = traverse_mccfr(next_ctx);
+    }
+    if(spawn) {
+      #pragma omp taskwait
+    }
+    double v_exact = 0.0;
+    double v_r_sum = 0.0;
+    double v_a_sum = 0.0;
+    for(int a_idx = 0; a_idx < n_value_actions; ++a_idx) {
+      const int v_r = std::max(regrets.load(a_idx), 0);
+      v_exact += static_cast<double>(v_r) * static_cast<double>(values[a_idx]);
       v_r_sum += v_r;
-      v_a_sum += v_a;
-      // if(is_debug) log_action_ev(a, freq[a_idx], v_a);
+      v_a_sum += values[a_idx];
+      // if(is_debug) log_action_ev(value_actions[a_idx], freq[a_idx], values[a_idx]);
     }
     v_exact = v_r_sum > 0 ? v_exact / v_r_sum : v_a_sum / n_value_actions;
     const int v = static_cast<int>(std::lrint(v_exact));
     if(is_debug) log_net_ev(v, v_exact);
     if(!is_frozen(cluster, ctx.regret_storage)) {
       for(int a_idx = 0; a_idx < n_value_actions; ++a_idx) {
-        auto& r_atom = base_ptr[a_idx];
-        const int prev_r = r_atom.load(std::memory_order_relaxed);
+        const int prev_r = regrets.load(a_idx);
         const int d_r = values[a_idx] - v;
         const int next_r = prev_r + d_r;
         if(is_debug && next_r > 2'000'000'000) Logger::error("Regret overflowing!\n" + info_str(prev_r, d_r, ctx));
         if(next_r > REGRET_FLOOR) {
-          r_atom.fetch_add(d_r, std::memory_order_relaxed);
+          regrets.add(a_idx, d_r);
         }
         if(is_debug) log_regret(value_actions[a_idx], d_r, next_r);
       }
@@ -395,7 +458,9 @@ int MCCFRSolver<StorageT>::traverse_mccfr(MCCFRContext<StorageT>& ctx) {
   }
   const auto& value_actions = regret_value_actions(ctx.regret_storage);
   const auto& branching_actions = regret_branching_actions(ctx.regret_storage);
-  const int a_idx = external_sampling(value_actions, ctx);
+  float freq[MAX_ACTIONS];
+  const int a_idx = external_sampling(value_actions, ctx, freq);
+  std::atomic<float>* baselines = get_baselines(ctx.regret_storage, ctx.clusters[ctx.state.get_round()][ctx.i]);
   const Action a = value_actions[a_idx];
   if(is_debug) Logger::log("[" + pos_to_str(ctx.state) + "] Applying (external): " + a.to_string());
   auto next_node = next_bp_node(a, ctx.state, ctx.bp_node, ctx.bp_state);
@@ -404,15 +469,42 @@ int MCCFRSolver<StorageT>::traverse_mccfr(MCCFRContext<StorageT>& ctx) {
   ctx.regret_storage = next_regret_storage(ctx.regret_storage, branching_idx, ctx.state, ctx.i);
   ctx.bp_node = next_node;
   ctx.consec_folds = next_consec_folds(ctx.consec_folds, a);
-  return traverse_mccfr(ctx);
+  ++ctx.depth;
+  const int v = traverse_mccfr(ctx);
+  return sampled_value(v, a_idx, freq, value_actions.size(), baselines);
 }
 
 template <template<typename> class StorageT>
-int MCCFRSolver<StorageT>::external_sampling(const std::vector<Action>& actions, const MCCFRContext<StorageT>& ctx) {
+int MCCFRSolver<StorageT>::traverse_mccfr_task(const MCCFRContext<StorageT>& ctx, const Action a, const int branching_idx, const uint64_t stream) {
+  // the task owns copies of everything the traversal mutates, the parent only reads its context until the tasks are joined
+  SlimPokerState state = ctx.state;
+  SlimPokerState bp_state = ctx.bp_state;
+  std::vector<CachedIndexer> bp_indexers;
+  MCCFRContext<StorageT> task_ctx{state, ctx.t, ctx.i, ctx.consec_folds, ctx.board, ctx.hands, ctx.clusters, ctx.ranks, ctx.regret_storage,
+      ctx.bp_node, bp_state};
+  if(ctx.bp_indexers) {
+    bp_indexers = *ctx.bp_indexers;
+    task_ctx.bp_indexers = &bp_indexers;
+  }
+  task_ctx.depth = ctx.depth;
+  task_ctx.stream = stream;
+  // the thread may be suspended in another task of the same iteration, its stream continues after the join
+  const omp::XoroShiro128Plus prev_rng = FastRNG::instance();
+  FastRNG::seed(*_seed, ctx.t, ctx.i, stream);
+  const auto next_node = next_bp_node(a, state, ctx.bp_node, bp_state);
+  state.apply_in_place(a);
+  MCCFRContext<StorageT> next_ctx{state, next_regret_storage(ctx.regret_storage, branching_idx, state, ctx.i), next_node,
+      next_consec_folds(ctx.consec_folds, a), task_ctx};
+  const int v = traverse_mccfr(next_ctx);
+  FastRNG::instance() = prev_rng;
+  return v;
+}
+
+template <template<typename> class StorageT>
+int MCCFRSolver<StorageT>::external_sampling(const std::vector<Action>& actions, const MCCFRContext<StorageT>& ctx, float freq[]) {
   const int cluster = ctx.clusters[ctx.state.get_round()][ctx.state.get_active()];
-  const std::atomic<int>* base_ptr = get_base_regret_ptr(ctx.regret_storage, cluster);
-  const int a_idx = sample_idx_from_regrets(base_ptr, actions.size());
-  // if(is_debug) log_external_sampling(actions[a_idx], actions, freq);
+  const int a_idx = sample_idx_from_regrets(get_regret_row(ctx.regret_storage, cluster), actions.size(), freq);
+  if(is_debug) log_external_sampling(actions[a_idx], actions, freq);
   return a_idx;
 }
 
@@ -425,6 +517,7 @@ std::string MCCFRSolver<StorageT>::track_wandb_metrics(const long t) const {
   out_str << std::setprecision(1) << std::fixed << std::setw(7) << t / 1'000'000.0 << "M it   ";
   track_regret(metrics, out_str, t);
   track_strategy(metrics, out_str);
+  if(_lbr_config.is_lbr_step(t) && get_config().init_state.active_players() == 2) track_lbr(metrics, out_str);
   const auto t_f = std::chrono::high_resolution_clock::now();
   const auto dt = std::chrono::duration_cast<std::chrono::microseconds>(t_f - t_i).count();
   out_str << std::setw(8) << dt << " us (metrics)";
@@ -471,7 +564,11 @@ void MCCFRSolver<StorageT>::track_strategy_by_decision(const PokerState& state,
   PokerRange base_range = ranges[state.get_active()];
   base_range.remove_cards(get_config().init_board);
   if(state.get_round() >= 4) return;
-  for(Action a : valid_actions(state, get_config().action_profile)) {
+  const std::vector<Action>& actions = get_config().action_profile.get_actions(state);
+  const uint16_t valid = valid_action_mask(state, actions);
+  for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
+    if(!(valid >> a_idx & 1)) continue;
+    const Action a = actions[a_idx];
     PokerState next_state = state.apply(a);
     if(!should_track_strategy(state, next_state, get_config(), metrics_config)) continue;
     if(a == Action::FOLD) {
@@ -490,9 +587,19 @@ void MCCFRSolver<StorageT>::track_strategy_by_decision(const PokerState& state,
   }
 }
 
+template <template<typename> class StorageT>
+void MCCFRSolver<StorageT>::track_lbr_by_decision(const DecisionAlgorithm& decision, nlohmann::json& metrics, std::ostringstream& out_str) const {
+  const ResultEV lbr = LocalBestResponse{decision, get_config(), _lbr_config}.evaluate();
+  out_str << std::setw(8) << std::setprecision(1) << std::fixed << to_mbb(lbr.ev) << " +- " << to_mbb(lbr.std_err) << " mbb/g LBR   ";
+  metrics["lbr (mbb/g)"] = to_mbb(lbr.ev);
+  metrics["lbr_std_err (mbb/g)"] = to_mbb(lbr.std_err);
+}
+
 // to allow use of MCCFRSolver::traverse_mccfr friend in benchmark_mccfr.cpp without moving MCCFRSolver::traverse_mccfr to the header mccfr.hpp 
 // (because it's a template and used in a different translation unit)
 template class MCCFRSolver<TreeStorageNode>;
+template class MCCFRSolver<StaticTreeNode>;
+template class MCCFRSolver<HashedInfoset>;
 
 // ==========================================================================================
 // || TreeSolver
@@ -505,8 +612,8 @@ void TreeSolver::on_start() {
   }
 }
 
-std::atomic<int>* TreeSolver::get_base_regret_ptr(TreeStorageNode<int>* storage, const int cluster) {
-  return storage->get(cluster); 
+RegretRow TreeSolver::get_regret_row(TreeStorageNode<int>* storage, const int cluster) {
+  return storage->get_regret_row(cluster);
 }
 
 TreeStorageNode<int>* TreeSolver::init_regret_storage() { 
@@ -525,6 +632,24 @@ const std::vector<Action>& TreeSolver::regret_value_actions(TreeStorageNode<int>
   return storage->get_value_actions();
 }
 
+void TreeSolver::save_regrets(ShardedSnapshotWriter& writer) const {
+  const bool has_regrets = _regrets_root != nullptr;
+  writer.archive()(has_regrets);
+  if(has_regrets) writer.add_tree(*_regrets_root);
+}
+
+void TreeSolver::load_regrets(ShardedSnapshotReader& reader) {
+  bool has_regrets;
+  reader.archive()(has_regrets);
+  _regrets_root = has_regrets ? std::make_unique<TreeStorageNode<int>>() : nullptr;
+  if(has_regrets) {
+    reader.add_tree(*_regrets_root);
+    // trees created after the load must match the resumed regret layout
+    _regret_precision = _regrets_root->is_quantized() ? RegretPrecision::INT16 : RegretPrecision::INT32;
+    _baselines = _regrets_root->has_baselines();
+  }
+}
+
 const std::vector<Action>& TreeSolver::avg_branching_actions(TreeStorageNode<float>* storage) const {
   return storage->get_branching_actions();
 }
@@ -557,9 +682,9 @@ void BlueprintSolver<StorageT>::update_strategy(UpdateContext<StorageT>& ctx) {
   if(ctx.state.get_active() == ctx.i) {
     const auto& actions = this->avg_value_actions(ctx.avg_storage);
     int cluster = ctx.clusters[ctx.state.get_round()][ctx.state.get_active()];
-    const std::atomic<int>* base_ptr = this->get_base_regret_ptr(ctx.regret_storage, cluster);
+    const RegretRow regrets = this->get_regret_row(ctx.regret_storage, cluster);
     float freq[MAX_ACTIONS];
-    calculate_strategy_in_place(base_ptr, actions.size(), freq);
+    calculate_strategy_in_place(regrets, actions.size(), freq);
     int a_idx = sample_action_idx(freq, actions.size());
     if(is_debug) {
       Logger::log("Update strategy: " + ctx.hands[ctx.i].to_string() + " (cluster=" + std::to_string(cluster) + ")");
@@ -608,7 +733,9 @@ void BlueprintSolver<StorageT>::on_step(const long t, const int i, const std::ve
 
 template <template<typename> class StorageT>
 bool BlueprintSolver<StorageT>::should_prune(const long t) const {
-  return t >= _bp_config.prune_thresh && GSLGlobalRNG::uniform() > 0.95;
+  // prune records schedule the re-exploration of pruned branches themselves
+  if(this->uses_prune_records()) return t >= _bp_config.prune_thresh;
+  return t >= _bp_config.prune_thresh && FastRNG::uniform() > 0.95;
 }
 
 template <template<typename> class StorageT>
@@ -621,13 +748,20 @@ int BlueprintSolver<StorageT>::get_cluster(const int r, const Board& board, cons
   return BlueprintClusterMap::get_instance()->cluster(r, indexer.index(board, hand, r));
 }
 
+// the distributed solver constructs the virtual base outside of this translation unit
+template class BlueprintSolver<TreeStorageNode>;
+
 // ==========================================================================================
 // || RealTimeSolver
 // ==========================================================================================
 
 template <template<typename> class StorageT>
 RealTimeSolver<StorageT>::RealTimeSolver(const std::shared_ptr<const SampledBlueprint>& bp, const RealTimeSolverConfig& rt_config)
-    : _bp{bp}, _root_node{bp->get_strategy()->apply(rt_config.init_actions)}, _rt_config{rt_config} {}
+    : _bp{bp}, _root_node{bp ? bp->get_strategy()->apply(rt_config.init_actions) : nullptr}, _rt_config{rt_config} {
+  // terminal solves never roll out, so they don't read the blueprint
+  if(!_bp && !rt_config.is_terminal_solve()) Logger::error("Real time solver requires a blueprint unless it solves to the end of the game.");
+  this->set_task_depth(rt_config.task_depth);
+}
 
 template<template <typename> class StorageT>
 const StorageT<uint8_t>* RealTimeSolver<StorageT>::next_bp_node(const Action a, const SlimPokerState& state, const StorageT<uint8_t>* bp_node,
@@ -684,7 +818,7 @@ int RealTimeSolver<StorageT>::terminal_utility(const MCCFRContext<StorageT>& ctx
       ctx.state.apply_in_place(Action::CHECK_CALL);
     }
   }
-  return utility(ctx.state, ctx.i, ctx.board, ctx.hands, this->get_config().init_chips[ctx.i], this->get_config().rake, ctx.eval);
+  return utility(ctx.state, ctx.i, ctx.ranks, this->get_config().init_chips[ctx.i], this->get_config().rake);
 }
 
 template<template <typename> class StorageT>
@@ -701,8 +835,8 @@ void RealTimeSolver<StorageT>::on_start() {
 template<template <typename> class StorageT>
 void RealTimeSolver<StorageT>::initialize_context(MCCFRContext<StorageT>& ctx) {
   thread_local std::vector<CachedIndexer> bp_indexers;
-  bp_indexers.clear();
-  bp_indexers.resize(ctx.hands.size());
+  if(bp_indexers.size() != ctx.hands.size()) bp_indexers.resize(ctx.hands.size());
+  for(CachedIndexer& indexer : bp_indexers) indexer.reset();
   ctx.bp_indexers = &bp_indexers;
 }
 
@@ -720,7 +854,10 @@ int RealTimeSolver<StorageT>::get_cluster(const int r, const Board& board, const
 std::shared_ptr<const TreeStorageConfig> TreeBlueprintSolver::make_tree_config() const {
   return std::make_shared<TreeStorageConfig>(TreeStorageConfig{
     ClusterSpec{169, 200, 200, 200},
-    ActionMode::make_blueprint_mode(get_config().action_profile)
+    ActionMode::make_blueprint_mode(get_config().action_profile),
+    get_regret_precision(),
+    _prune_records,
+    uses_baselines()
   });
 }
 
@@ -741,6 +878,35 @@ void TreeBlueprintSolver::on_start() {
   }
 }
 
+void TreeBlueprintSolver::save_snapshot(const std::string& fn) const {
+  prepare_snapshot(fn, omp_get_max_threads())();
+}
+
+std::function<void()> TreeBlueprintSolver::prepare_snapshot(const std::string& fn, const int n_threads) const {
+  auto writer = std::make_shared<ShardedSnapshotWriter>(fn, 4 * n_threads, n_threads);
+  writer->archive()(cereal::base_class<BlueprintSolver>(this), cereal::base_class<MCCFRSolver>(this), cereal::base_class<Solver>(this));
+  save_regrets(*writer);
+  const bool has_phi = _phi_root != nullptr;
+  writer->archive()(has_phi);
+  if(has_phi) writer->add_tree(*_phi_root);
+  return [writer] { writer->write_shards(); };
+}
+
+void TreeBlueprintSolver::load_snapshot(const std::string& fn) {
+  if(!is_sharded_snapshot(fn)) {
+    cereal_load(*this, fn);
+    return;
+  }
+  ShardedSnapshotReader reader{fn};
+  reader.archive()(cereal::base_class<BlueprintSolver>(this), cereal::base_class<MCCFRSolver>(this), cereal::base_class<Solver>(this));
+  load_regrets(reader);
+  bool has_phi;
+  reader.archive()(has_phi);
+  _phi_root = has_phi ? std::make_unique<TreeStorageNode<float>>() : nullptr;
+  if(has_phi) reader.add_tree(*_phi_root);
+  reader.read_shards();
+}
+
 void TreeBlueprintSolver::on_snapshot() {
   if(get_iteration() >= get_blueprint_config().preflop_threshold) {
     Logger::log("Reached preflop threshold. Deleting phi...");
@@ -770,35 +936,48 @@ void TreeBlueprintSolver::track_strategy(nlohmann::json& metrics, std::ostringst
   }
 }
 
+void TreeBlueprintSolver::track_lbr(nlohmann::json& metrics, std::ostringstream& out_str) const {
+  track_lbr_by_decision(TreeDecision{get_strategy(), get_config().init_state, false}, metrics, out_str);
+}
+
 struct NodeMetrics {
   long max_value_sum = 0L;
   long nodes = 0L;
   long values = 0L;
+  long bytes = 0L;
+
+  long bytes_per_node() const { return nodes > 0 ? bytes / nodes : 0L; }
 
   NodeMetrics& operator+=(const NodeMetrics& other) {
     max_value_sum += other.max_value_sum;
     nodes += other.nodes;
     values += other.values;
+    bytes += other.bytes;
     return *this;
   }
 };
 
 template <class T>
-NodeMetrics collect_node_metrics(const TreeStorageNode<T>* node) {
-  NodeMetrics metrics;
-  for(int c = 0; c < node->get_n_clusters(); ++c) {
-    T max_v = 0L;
-    for(int a_idx = 0; a_idx < node->get_value_actions().size(); ++a_idx) {
-      max_v = std::max(node->get(c, a_idx)->load(), max_v);
+NodeMetrics collect_node_metrics(const TreeStorageNode<T>* root) {
+  PerThread<NodeMetrics> thread_metrics;
+  TreeVisitor<const TreeStorageNode<T>> visitor;
+  visitor.set_pre([&thread_metrics](const TreeStorageNode<T>* node, const auto&) {
+    NodeMetrics& metrics = thread_metrics.local();
+    for(int c = 0; c < node->get_n_clusters(); ++c) {
+      T max_v = 0L;
+      for(int a_idx = 0; a_idx < node->get_value_actions().size(); ++a_idx) {
+        max_v = std::max(node->load(c, a_idx), max_v);
+      }
+      metrics.max_value_sum += max_v;
     }
-    metrics.max_value_sum += max_v;
-  }
-  ++metrics.nodes;
-  metrics.values = node->get_n_values();
-  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
-    if(node->is_allocated(a_idx)) metrics += collect_node_metrics(node->apply_index(a_idx));
-  }
-  return metrics;
+    ++metrics.nodes;
+    metrics.values += node->get_n_values();
+    // live nodes only, the arena also holds blocks of discarded nodes and compacted away copies
+    metrics.bytes += static_cast<long>(node->node_bytes());
+    return true;
+  });
+  visitor.visit(root);
+  return thread_metrics.reduce(NodeMetrics{}, [](NodeMetrics acc, const NodeMetrics& m) { return acc += m; });
 }
 
 void TreeBlueprintSolver::track_regret(nlohmann::json& metrics, std::ostringstream& out_str, const long t) const {
@@ -808,17 +987,21 @@ void TreeBlueprintSolver::track_regret(nlohmann::json& metrics, std::ostringstre
   out_str << std::setw(8) << avg_regret << " avg regret   ";
   out_str << std::setw(12) << regret_metrics.nodes << " regret nodes   ";
   out_str << std::setw(12) << regret_metrics.values << " regret values   ";
+  out_str << std::setw(8) << regret_metrics.bytes_per_node() << " regret bytes/node   ";
   out_str << std::setw(8) << std::fixed << std::setprecision(2) << free_ram << " GB free ram   ";
   metrics["avg max regret"] = static_cast<int>(avg_regret);
   metrics["regret_nodes"] = regret_metrics.nodes;
   metrics["regret_values"] = regret_metrics.values;
+  metrics["regret_bytes_per_node"] = regret_metrics.bytes_per_node();
   metrics["free_ram"] = free_ram;
   if(_phi_root) {
     NodeMetrics phi_metrics = collect_node_metrics(get_phi_root());
     out_str << std::setw(12) << phi_metrics.nodes << " avg nodes   ";
     out_str << std::setw(12) << phi_metrics.values << " avg values   ";
+    out_str << std::setw(8) << phi_metrics.bytes_per_node() << " avg bytes/node   ";
     metrics["avg_nodes"] = phi_metrics.nodes;
     metrics["avg_values"] = phi_metrics.values;
+    metrics["avg_bytes_per_node"] = phi_metrics.bytes_per_node();
   }
 }
 
@@ -832,6 +1015,313 @@ bool TreeBlueprintSolver::operator==(const TreeBlueprintSolver& other) const {
     ((!_phi_root && !other._phi_root) || (_phi_root && other._phi_root && *_phi_root == *other._phi_root));
 }
 
+// ==========================================================================================
+// || StaticTreeBlueprintSolver
+// ==========================================================================================
+
+template <class T>
+NodeMetrics collect_node_metrics(const StaticTree<T>& tree) {
+  PerThread<NodeMetrics> thread_metrics;
+  tree.for_each_node([&thread_metrics](const StaticTreeNode<T>& node) {
+    NodeMetrics& metrics = thread_metrics.local();
+    for(int c = 0; c < node.get_n_clusters(); ++c) {
+      T max_v = 0L;
+      for(int a_idx = 0; a_idx < node.get_value_actions().size(); ++a_idx) {
+        max_v = std::max(node.load(c, a_idx), max_v);
+      }
+      metrics.max_value_sum += max_v;
+    }
+  });
+  NodeMetrics metrics = thread_metrics.reduce(NodeMetrics{}, [](NodeMetrics acc, const NodeMetrics& m) { return acc += m; });
+  metrics.nodes = static_cast<long>(tree.n_nodes());
+  metrics.values = static_cast<long>(tree.n_values());
+  metrics.bytes = static_cast<long>(tree.bytes());
+  return metrics;
+}
+
+std::shared_ptr<const TreeStorageConfig> StaticTreeBlueprintSolver::make_tree_config() const {
+  return std::make_shared<TreeStorageConfig>(TreeStorageConfig{
+    ClusterSpec{169, 200, 200, 200},
+    ActionMode::make_blueprint_mode(get_config().action_profile)
+  });
+}
+
+StaticTreeBlueprintSolver::StaticTreeBlueprintSolver(const SolverConfig& config, const BlueprintSolverConfig& bp_config)
+    : MCCFRSolver{config}, BlueprintSolver{config, bp_config} {}
+
+float StaticTreeBlueprintSolver::frequency(const Action action, const PokerState& state, const Board& board, const Hand& hand) const {
+  const TreeDecision decision{get_strategy(), get_config().init_state, false};
+  return decision.frequency(action, state, board, hand);
+}
+
+void StaticTreeBlueprintSolver::on_start() {
+  BlueprintSolver::on_start();
+  if(!_regrets) {
+    Logger::log("Building static regret tree ...");
+    _regrets = std::make_unique<StaticTree<int>>(get_config().init_state, make_tree_config());
+    Logger::log("Static regret tree: " + std::to_string(_regrets->n_nodes()) + " nodes, " + std::to_string(_regrets->n_values()) + " values, "
+        + std::to_string(_regrets->bytes()) + " bytes.");
+  }
+  if(!_phi && get_iteration() < get_blueprint_config().preflop_threshold) {
+    Logger::log("Building static avg tree...");
+    _phi = std::make_unique<StaticTree<float>>(get_config().init_state, make_tree_config(), 0);
+  }
+}
+
+void StaticTreeBlueprintSolver::on_snapshot() {
+  if(get_iteration() >= get_blueprint_config().preflop_threshold) {
+    Logger::log("Reached preflop threshold. Deleting phi...");
+    _phi = nullptr;
+  }
+}
+
+RegretRow StaticTreeBlueprintSolver::get_regret_row(StaticTreeNode<int>* storage, const int cluster) {
+  return storage->get_regret_row(cluster);
+}
+
+std::atomic<float>* StaticTreeBlueprintSolver::get_base_avg_ptr(StaticTreeNode<float>* storage, const int cluster) {
+  return storage->get(cluster);
+}
+
+StaticTreeNode<int>* StaticTreeBlueprintSolver::init_regret_storage() {
+  return _regrets->root();
+}
+
+StaticTreeNode<float>* StaticTreeBlueprintSolver::init_avg_storage() {
+  return _phi ? _phi->root() : nullptr;
+}
+
+StaticTreeNode<int>* StaticTreeBlueprintSolver::next_regret_storage(StaticTreeNode<int>* storage, const int action_idx, const SlimPokerState& next_state,
+    const int i) {
+  return !is_terminal(next_state, i) ? storage->apply_index(action_idx) : nullptr;
+}
+
+StaticTreeNode<float>* StaticTreeBlueprintSolver::next_avg_storage(StaticTreeNode<float>* storage, const int action_idx, const SlimPokerState& next_state,
+    const int i) {
+  return !is_update_terminal(next_state, i) ? storage->apply_index(action_idx) : nullptr;
+}
+
+const std::vector<Action>& StaticTreeBlueprintSolver::regret_branching_actions(StaticTreeNode<int>* storage) const {
+  return storage->get_branching_actions();
+}
+
+const std::vector<Action>& StaticTreeBlueprintSolver::regret_value_actions(StaticTreeNode<int>* storage) const {
+  return storage->get_value_actions();
+}
+
+const std::vector<Action>& StaticTreeBlueprintSolver::avg_branching_actions(StaticTreeNode<float>* storage) const {
+  return storage->get_branching_actions();
+}
+
+const std::vector<Action>& StaticTreeBlueprintSolver::avg_value_actions(StaticTreeNode<float>* storage) const {
+  return storage->get_value_actions();
+}
+
+void StaticTreeBlueprintSolver::track_strategy(nlohmann::json& metrics, std::ostringstream& out_str) const {
+  const auto init_ranges = get_config().init_ranges;
+  const TreeDecision decision{get_strategy(), get_config().init_state, false};
+  track_strategy_by_decision(get_config().init_state, init_ranges, decision, get_regret_metrics_config(), false, metrics);
+  if(_phi) {
+    track_strategy_by_decision(get_config().init_state, init_ranges, decision, get_avg_metrics_config(), true, metrics);
+  }
+}
+
+void StaticTreeBlueprintSolver::track_lbr(nlohmann::json& metrics, std::ostringstream& out_str) const {
+  track_lbr_by_decision(TreeDecision{get_strategy(), get_config().init_state, false}, metrics, out_str);
+}
+
+void StaticTreeBlueprintSolver::track_regret(nlohmann::json& metrics, std::ostringstream& out_str, const long t) const {
+  NodeMetrics regret_metrics = collect_node_metrics(*_regrets);
+  const long avg_regret = regret_metrics.max_value_sum / t;
+  out_str << std::setw(8) << avg_regret << " avg regret   ";
+  out_str << std::setw(12) << regret_metrics.nodes << " regret nodes   ";
+  out_str << std::setw(12) << regret_metrics.values << " regret values   ";
+  out_str << std::setw(8) << regret_metrics.bytes_per_node() << " regret bytes/node   ";
+  metrics["avg max regret"] = static_cast<int>(avg_regret);
+  metrics["regret_nodes"] = regret_metrics.nodes;
+  metrics["regret_values"] = regret_metrics.values;
+  metrics["regret_bytes_per_node"] = regret_metrics.bytes_per_node();
+  if(_phi) {
+    NodeMetrics phi_metrics = collect_node_metrics(*_phi);
+    out_str << std::setw(12) << phi_metrics.nodes << " avg nodes   ";
+    out_str << std::setw(12) << phi_metrics.values << " avg values   ";
+    metrics["avg_nodes"] = phi_metrics.nodes;
+    metrics["avg_values"] = phi_metrics.values;
+  }
+}
+
+void StaticTreeBlueprintSolver::freeze(const std::vector<float>& freq, const Hand& hand, const Board& board, const ActionHistory& history) {
+  Logger::error("Freezing is not implemented for StaticTreeBlueprintSolver.");
+}
+
+bool StaticTreeBlueprintSolver::operator==(const StaticTreeBlueprintSolver& other) const {
+  return BlueprintSolver::operator==(other) &&
+    ((!_regrets && !other._regrets) || (_regrets && other._regrets && *_regrets == *other._regrets)) &&
+    ((!_phi && !other._phi) || (_phi && other._phi && *_phi == *other._phi));
+}
+
+// ==========================================================================================
+// || HashTableBlueprintSolver
+// ==========================================================================================
+
+template <class T>
+NodeMetrics collect_node_metrics(const HashTable<T>& table) {
+  PerThread<NodeMetrics> thread_metrics;
+  table.for_each_slot([&thread_metrics](const HashedInfoset<T>& slot) {
+    NodeMetrics& metrics = thread_metrics.local();
+    for(int c = 0; c < slot.get_n_clusters(); ++c) {
+      T max_v = 0L;
+      for(int a_idx = 0; a_idx < slot.get_value_actions().size(); ++a_idx) {
+        max_v = std::max(slot.load(c, a_idx), max_v);
+      }
+      metrics.max_value_sum += max_v;
+    }
+  });
+  NodeMetrics metrics = thread_metrics.reduce(NodeMetrics{}, [](NodeMetrics acc, const NodeMetrics& m) { return acc += m; });
+  const HashTableStats stats = table.get_stats();
+  metrics.nodes = static_cast<long>(stats.used_slots);
+  metrics.values = static_cast<long>(stats.n_values);
+  metrics.bytes = static_cast<long>(stats.bytes);
+  return metrics;
+}
+
+std::string hash_table_stats_str(const HashTableStats& stats) {
+  std::ostringstream oss;
+  oss << stats.used_slots << "/" << stats.n_slots << " slots, " << stats.n_values << "/" << stats.values_capacity << " values, "
+      << std::setprecision(2) << std::fixed << stats.mean_probe() << " mean probe, " << stats.max_probe << " max probe, "
+      << stats.collisions << " collisions";
+  return oss.str();
+}
+
+std::shared_ptr<const TreeStorageConfig> HashTableBlueprintSolver::make_tree_config() const {
+  return std::make_shared<TreeStorageConfig>(TreeStorageConfig{
+    ClusterSpec{169, 200, 200, 200},
+    ActionMode::make_blueprint_mode(get_config().action_profile)
+  });
+}
+
+HashTableBlueprintSolver::HashTableBlueprintSolver(const SolverConfig& config, const BlueprintSolverConfig& bp_config)
+    : MCCFRSolver{config}, BlueprintSolver{config, bp_config} {}
+
+float HashTableBlueprintSolver::frequency(const Action action, const PokerState& state, const Board& board, const Hand& hand) const {
+  const TreeDecision decision{get_strategy(), get_config().init_state, false};
+  return decision.frequency(action, state, board, hand);
+}
+
+void HashTableBlueprintSolver::on_start() {
+  BlueprintSolver::on_start();
+  if(!_regrets) {
+    Logger::log("Allocating regret hash table ...");
+    _regrets = std::make_unique<HashTable<int>>(get_config().init_state, make_tree_config(), _regret_table_config);
+  }
+  if(!_phi && get_iteration() < get_blueprint_config().preflop_threshold) {
+    Logger::log("Allocating avg hash table...");
+    _phi = std::make_unique<HashTable<float>>(get_config().init_state, make_tree_config(), _avg_table_config);
+  }
+}
+
+void HashTableBlueprintSolver::on_snapshot() {
+  Logger::log("Regret hash table: " + hash_table_stats_str(_regrets->get_stats()));
+  if(get_iteration() >= get_blueprint_config().preflop_threshold) {
+    Logger::log("Reached preflop threshold. Deleting phi...");
+    _phi = nullptr;
+  }
+}
+
+RegretRow HashTableBlueprintSolver::get_regret_row(HashedInfoset<int>* storage, const int cluster) {
+  return storage->get_regret_row(cluster);
+}
+
+std::atomic<float>* HashTableBlueprintSolver::get_base_avg_ptr(HashedInfoset<float>* storage, const int cluster) {
+  return storage->get(cluster);
+}
+
+HashedInfoset<int>* HashTableBlueprintSolver::init_regret_storage() {
+  return _regrets->root();
+}
+
+HashedInfoset<float>* HashTableBlueprintSolver::init_avg_storage() {
+  return _phi ? _phi->root() : nullptr;
+}
+
+HashedInfoset<int>* HashTableBlueprintSolver::next_regret_storage(HashedInfoset<int>* storage, const int action_idx, const SlimPokerState& next_state,
+    const int i) {
+  return !is_terminal(next_state, i) ? storage->apply_index(action_idx, next_state) : nullptr;
+}
+
+HashedInfoset<float>* HashTableBlueprintSolver::next_avg_storage(HashedInfoset<float>* storage, const int action_idx, const SlimPokerState& next_state,
+    const int i) {
+  return !is_update_terminal(next_state, i) ? storage->apply_index(action_idx, next_state) : nullptr;
+}
+
+const std::vector<Action>& HashTableBlueprintSolver::regret_branching_actions(HashedInfoset<int>* storage) const {
+  return storage->get_branching_actions();
+}
+
+const std::vector<Action>& HashTableBlueprintSolver::regret_value_actions(HashedInfoset<int>* storage) const {
+  return storage->get_value_actions();
+}
+
+const std::vector<Action>& HashTableBlueprintSolver::avg_branching_actions(HashedInfoset<float>* storage) const {
+  return storage->get_branching_actions();
+}
+
+const std::vector<Action>& HashTableBlueprintSolver::avg_value_actions(HashedInfoset<float>* storage) const {
+  return storage->get_value_actions();
+}
+
+void HashTableBlueprintSolver::track_strategy(nlohmann::json& metrics, std::ostringstream& out_str) const {
+  const auto init_ranges = get_config().init_ranges;
+  const TreeDecision decision{get_strategy(), get_config().init_state, false};
+  track_strategy_by_decision(get_config().init_state, init_ranges, decision, get_regret_metrics_config(), false, metrics);
+  if(_phi) {
+    track_strategy_by_decision(get_config().init_state, init_ranges, decision, get_avg_metrics_config(), true, metrics);
+  }
+}
+
+void HashTableBlueprintSolver::track_lbr(nlohmann::json& metrics, std::ostringstream& out_str) const {
+  track_lbr_by_decision(TreeDecision{get_strategy(), get_config().init_state, false}, metrics, out_str);
+}
+
+void HashTableBlueprintSolver::track_regret(nlohmann::json& metrics, std::ostringstream& out_str, const long t) const {
+  NodeMetrics regret_metrics = collect_node_metrics(*_regrets);
+  const HashTableStats stats = _regrets->get_stats();
+  const long avg_regret = regret_metrics.max_value_sum / t;
+  out_str << std::setw(8) << avg_regret << " avg regret   ";
+  out_str << std::setw(12) << regret_metrics.nodes << " regret slots   ";
+  out_str << std::setw(12) << regret_metrics.values << " regret values   ";
+  out_str << std::setw(6) << std::fixed << std::setprecision(3) << stats.load_factor() << " load factor   ";
+  out_str << std::setw(6) << std::fixed << std::setprecision(2) << stats.mean_probe() << " mean probe   ";
+  out_str << std::setw(8) << stats.collisions << " collisions   ";
+  metrics["avg max regret"] = static_cast<int>(avg_regret);
+  metrics["regret_nodes"] = regret_metrics.nodes;
+  metrics["regret_values"] = regret_metrics.values;
+  metrics["regret_bytes_per_node"] = regret_metrics.bytes_per_node();
+  metrics["regret_load_factor"] = stats.load_factor();
+  metrics["regret_value_budget_used"] = stats.values_capacity > 0 ? static_cast<double>(stats.n_values) / stats.values_capacity : 0.0;
+  metrics["regret_mean_probe"] = stats.mean_probe();
+  metrics["regret_max_probe"] = stats.max_probe;
+  metrics["regret_collisions"] = stats.collisions;
+  if(_phi) {
+    NodeMetrics phi_metrics = collect_node_metrics(*_phi);
+    out_str << std::setw(12) << phi_metrics.nodes << " avg slots   ";
+    out_str << std::setw(12) << phi_metrics.values << " avg values   ";
+    metrics["avg_nodes"] = phi_metrics.nodes;
+    metrics["avg_values"] = phi_metrics.values;
+    metrics["avg_load_factor"] = _phi->get_stats().load_factor();
+  }
+}
+
+void HashTableBlueprintSolver::freeze(const std::vector<float>& freq, const Hand& hand, const Board& board, const ActionHistory& history) {
+  Logger::error("Freezing is not implemented for HashTableBlueprintSolver.");
+}
+
+bool HashTableBlueprintSolver::operator==(const HashTableBlueprintSolver& other) const {
+  return BlueprintSolver::operator==(other) &&
+    ((!_regrets && !other._regrets) || (_regrets && other._regrets && *_regrets == *other._regrets)) &&
+    ((!_phi && !other._phi) || (_phi && other._phi && *_phi == *other._phi));
+}
+
 // ==========================================================================================
 // || TreeRealTimeSolver
 // ==========================================================================================
@@ -896,7 +1386,10 @@ std::shared_ptr<const TreeStorageConfig> TreeRealTimeSolver::make_tree_config()
   }
   return std::make_shared<TreeStorageConfig>(TreeStorageConfig{
     ClusterSpec{169, clusters[0], clusters[1], clusters[2]},
-    ActionMode::make_real_time_mode(get_config().action_profile, get_real_time_config())
+    ActionMode::make_real_time_mode(get_config().action_profile, get_real_time_config()),
+    get_regret_precision(),
+    false,
+    uses_baselines()
   });
 }
 
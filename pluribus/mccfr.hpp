@@ -1,25 +1,37 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <fcntl.h>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <libwandb_cpp.h>
 #include <memory>
+#include <optional>
 #include <vector>
 #include <cereal/cereal.hpp>
 #include <cereal/types/polymorphic.hpp>
 #include <pluribus/cereal_ext.hpp>
 #include <pluribus/config.hpp>
 #include <pluribus/decision.hpp>
+#include <pluribus/hash_storage.hpp>
 #include <pluribus/indexing.hpp>
+#include <pluribus/lbr.hpp>
 #include <pluribus/poker.hpp>
 #include <pluribus/range.hpp>
+#include <pluribus/sampling.hpp>
+#include <pluribus/snapshot.hpp>
+#include <pluribus/static_storage.hpp>
 #include <pluribus/tree_storage.hpp>
 
 namespace pluribus {
 
 int utility(const SlimPokerState& state, int i, const Board& board, const std::vector<Hand>& hands, int stack_size, const RakeStructure& rake,
     const omp::HandEvaluator& eval);
+int utility(const SlimPokerState& state, int i, const ShowdownRanks& ranks, int stack_size, const RakeStructure& rake);
+// baseline corrected value of an external sampling node that sampled a_idx (VR-MCCFR), v if baselines is null
+int sampled_value(int v, int a_idx, const float freq[], int n_actions, std::atomic<float>* baselines);
 
 enum class SolverState {
   UNDEFINED, INTERRUPT, SOLVING, SOLVED
@@ -55,17 +67,83 @@ struct MetricsConfig {
   std::function<bool(const PokerState&)> should_track = [](const PokerState&) { return true; };
 };
 
+// Per thread buffers of an MCCFR iteration. They are reset for every traverser instead of reallocated, so steady state iterations do not
+// allocate.
+struct IterationScratch {
+  void sample_deal(SamplingAlgorithm& sampler, const std::vector<uint8_t>& init_board) {
+    sampler.sample_in_place(sample);
+    board = sample_board(init_board, sample.mask);
+    if(indexers.size() != sample.hands.size()) indexers.resize(sample.hands.size());
+    for(CachedIndexer& indexer : indexers) indexer.reset();
+    for(auto& round_clusters : clusters) round_clusters.clear();
+  }
+
+  // progressively indexes every hand up to the river, cluster lookups of all rounds hit the cached indices
+  void index_hands() {
+    for(int h_idx = 0; h_idx < sample.hands.size(); ++h_idx) indexers[h_idx].index(board, sample.hands[h_idx], 3);
+  }
+
+  // get_cluster(round, board, hand, indexer) maps a hand to its cluster
+  template <class F>
+  void cluster_round(const int r, F&& get_cluster) {
+    for(int h_idx = 0; h_idx < sample.hands.size(); ++h_idx) {
+      clusters[r].push_back(get_cluster(r, board, sample.hands[h_idx], indexers[h_idx]));
+    }
+  }
+
+  RoundSample sample;
+  Board board;
+  std::vector<CachedIndexer> indexers;
+  std::array<std::vector<uint16_t>, 4> clusters;
+};
+
+// Per thread ring buffer of deals. Deals are generated a block at a time and every stage runs over the whole block: sampling, progressive
+// hand indexing and the cluster lookups of one round. Indexer tables and the cluster map of a round stay in cache across hands, and the
+// independent cluster loads of a block overlap instead of stalling one traversal each.
+class DealBuffer {
+public:
+  explicit DealBuffer(const int block_size = 32) : _deals(block_size), _next{static_cast<size_t>(block_size)} {}
+
+  template <class F>
+  const IterationScratch& next(SamplingAlgorithm& sampler, const std::vector<uint8_t>& init_board, const int init_round, F&& get_cluster) {
+    if(_next == _deals.size()) fill(sampler, init_board, init_round, get_cluster);
+    return _deals[_next++];
+  }
+
+  // nanoseconds spent generating deals on this thread
+  long generation_ns() const { return _generation_ns; }
+  size_t block_size() const { return _deals.size(); }
+
+private:
+  template <class F>
+  void fill(SamplingAlgorithm& sampler, const std::vector<uint8_t>& init_board, const int init_round, F&& get_cluster) {
+    const auto t_0 = std::chrono::steady_clock::now();
+    for(IterationScratch& deal : _deals) deal.sample_deal(sampler, init_board);
+    for(IterationScratch& deal : _deals) deal.index_hands();
+    for(int r = init_round; r < 4; ++r) {
+      for(IterationScratch& deal : _deals) deal.cluster_round(r, get_cluster);
+    }
+    _next = 0;
+    _generation_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t_0).count();
+  }
+
+  std::vector<IterationScratch> _deals;
+  size_t _next;
+  long _generation_ns = 0;
+};
+
 template <template<typename> class StorageT>
 struct MCCFRContext {
   MCCFRContext(SlimPokerState& state_, const long t_, const int i_, const int consec_folds_, const Board& board_,
-      const std::vector<Hand>& hands_, const std::array<std::vector<uint16_t>, 4>& clusters_, const omp::HandEvaluator& eval_, StorageT<int>* regret_storage_,
+      const std::vector<Hand>& hands_, const std::array<std::vector<uint16_t>, 4>& clusters_, const ShowdownRanks& ranks_, StorageT<int>* regret_storage_,
       const StorageT<uint8_t>* bp_node_, SlimPokerState& bp_state_)
-    : state{state_}, t{t_}, i{i_}, consec_folds{consec_folds_}, board{board_}, hands{hands_}, clusters{clusters_}, eval{eval_},
+    : state{state_}, t{t_}, i{i_}, consec_folds{consec_folds_}, board{board_}, hands{hands_}, clusters{clusters_}, ranks{ranks_},
       regret_storage{regret_storage_}, bp_node{bp_node_}, bp_state{bp_state_} {}
   MCCFRContext(SlimPokerState& next_state, StorageT<int>* next_regret_storage, const StorageT<uint8_t>* next_bp_node, const int next_consec_folds,
       const MCCFRContext& ctx)
-    : state{next_state}, t{ctx.t}, i{ctx.i}, consec_folds{next_consec_folds}, board{ctx.board}, hands{ctx.hands}, clusters{ctx.clusters}, eval{ctx.eval},
-      regret_storage{next_regret_storage}, bp_node{next_bp_node}, bp_state{ctx.bp_state}, bp_indexers{ctx.bp_indexers} {}
+    : state{next_state}, t{ctx.t}, i{ctx.i}, consec_folds{next_consec_folds}, board{ctx.board}, hands{ctx.hands}, clusters{ctx.clusters}, ranks{ctx.ranks},
+      regret_storage{next_regret_storage}, bp_node{next_bp_node}, bp_state{ctx.bp_state}, bp_indexers{ctx.bp_indexers}, depth{ctx.depth + 1},
+      stream{ctx.stream} {}
 
   // TODO: move parts only required by real time solver into subclass (bp_node, bp_state, flop_idx)
   SlimPokerState& state;
@@ -75,11 +153,13 @@ struct MCCFRContext {
   const Board& board;
   const std::vector<Hand>& hands;
   const std::array<std::vector<uint16_t>, 4>& clusters;
-  const omp::HandEvaluator& eval;
+  const ShowdownRanks& ranks; // evaluated once per deal
   StorageT<int>* regret_storage;
   const StorageT<uint8_t>* bp_node; // real time solver
   SlimPokerState& bp_state; // real time solver
   std::vector<CachedIndexer>* bp_indexers = nullptr; // real time solver
+  int depth = 0; // actions applied since the root of the traversal
+  uint64_t stream = 0; // random stream of the traversal task, see MCCFRSolver::set_task_depth
 };
 
 template <template<typename> class StorageT>
@@ -113,6 +193,20 @@ public:
   void set_metrics_dir(const std::string& metrics_dir) { _metrics_dir = metrics_dir; }
   void set_log_dir(const std::string& log_dir) { _log_dir = log_dir; }
   void set_regret_metrics_config(const MetricsConfig& metrics_config) { _regret_metrics_config = metrics_config; }
+  // Local best response against the current strategy in the logged metrics, only for heads up spots. Off unless LBRConfig::interval is set. The
+  // evaluation runs on the training thread that writes the metrics and stalls it for every LBR step (a full range of frequency lookups per
+  // considered raise), so large runs should evaluate snapshots offline instead (./Pluribus lbr --tree snapshot_fn).
+  void set_lbr_config(const LBRConfig& lbr_config) { _lbr_config = lbr_config; }
+  // snapshots are written by a background thread while training continues, at most one snapshot is in flight
+  void set_async_snapshots(const bool async_snapshots) { _async_snapshots = async_snapshots; }
+  // run seed of the per traversal random streams, a single threaded solve with the same seed replays exactly. Drawn and logged if unset
+  void set_seed(const uint64_t seed) { _seed = seed; }
+  // Traverser nodes above task_depth traverse their actions as OpenMP tasks that idle threads steal, and join them before the regret update.
+  // Iterations are then spawned as tasks as well, so threads help finish the running iterations instead of starting new ones on the same
+  // rows. Every task draws from its own random stream, so a single threaded solve with the same seed still replays exactly, but samples
+  // differently than a sequential solve. 0 traverses sequentially.
+  void set_task_depth(const int task_depth) { _task_depth = task_depth; }
+  int get_task_depth() const { return _task_depth; }
   void interrupt() { _interrupt.store(true, std::memory_order_relaxed); }
   bool is_interrupted() const { return _interrupt.load(std::memory_order_relaxed); }
   virtual void freeze(const std::vector<float>& freq, const Hand& hand, const Board& board, const ActionHistory& history) = 0;
@@ -129,10 +223,12 @@ protected:
   
   virtual int terminal_utility(const MCCFRContext<StorageT>& context) const;
   virtual bool is_terminal(const SlimPokerState& state, const int i) const { return state.is_terminal() || state.get_players()[i].has_folded(); }
-  virtual bool is_frozen(int cluster, const TreeStorageNode<int>* storage) const = 0;
+  virtual bool is_frozen(int cluster, const StorageT<int>* storage) const = 0;
   virtual void on_start() {}
   virtual void on_step(long t, int i, const std::vector<Hand>& hands, const std::array<std::vector<uint16_t>, 4>& clusters) {}
   virtual void on_snapshot() {}
+  // called after the iterations of a step, before discounting and snapshots. No traversals are running.
+  virtual void on_step_end(long t, long T) {}
 
   virtual bool should_prune(long t) const = 0;
   virtual bool should_discount(long t) const = 0;
@@ -142,7 +238,12 @@ protected:
 
   virtual void initialize_context(MCCFRContext<StorageT>& ctx) = 0;
   virtual int get_cluster(int r, const Board& board, const Hand& hand, CachedIndexer& indexer) const = 0;
-  virtual std::atomic<int>* get_base_regret_ptr(StorageT<int>* storage, int cluster) = 0;
+  virtual RegretRow get_regret_row(StorageT<int>* storage, int cluster) = 0;
+  // PruneRecords of a cluster, null if the storage does not keep them and pruning falls back to the regret cutoff
+  virtual std::atomic<uint32_t>* get_prune_records(StorageT<int>* storage, int cluster) { return nullptr; }
+  virtual bool uses_prune_records() const { return false; }
+  // VR-MCCFR baselines of a cluster, null if the storage does not keep them and sampled values are used as they are
+  virtual std::atomic<float>* get_baselines(StorageT<int>* storage, int cluster) { return nullptr; }
   virtual std::atomic<float>* get_base_avg_ptr(StorageT<float>* storage, int cluster) = 0;
   virtual StorageT<int>* init_regret_storage() = 0;
   virtual StorageT<float>* init_avg_storage() = 0;
@@ -155,28 +256,40 @@ protected:
   virtual const std::vector<Action>& avg_branching_actions(StorageT<float>* storage) const = 0;
   virtual const std::vector<Action>& avg_value_actions(StorageT<float>* storage) const = 0;
   virtual void save_snapshot(const std::string& fn) const = 0;
+  // Saves everything that must match the current iteration and returns the remaining snapshot work, if any. The remaining work only reads
+  // storage values and may run concurrently with training.
+  virtual std::function<void()> prepare_snapshot(const std::string& fn, int n_threads) const {
+    save_snapshot(fn);
+    return {};
+  }
   
   virtual double get_discount_factor(long t) const = 0;
   
   virtual void track_regret(nlohmann::json& metrics, std::ostringstream& out_str, long t) const = 0;
   virtual void track_strategy(nlohmann::json& metrics, std::ostringstream& out_str) const = 0;
+  virtual void track_lbr(nlohmann::json& metrics, std::ostringstream& out_str) const {}
   virtual bool should_track_strategy(const PokerState& prev_state, const PokerState& next_state, const SolverConfig& solver_config,
       const MetricsConfig& metrics_config) const;
 
   std::string track_wandb_metrics(long t) const;
   void track_strategy_by_decision(const PokerState& state, const std::vector<PokerRange>& ranges, const DecisionAlgorithm& decision,
       const MetricsConfig& metrics_config, bool phi, nlohmann::json& metrics) const;
+  void track_lbr_by_decision(const DecisionAlgorithm& decision, nlohmann::json& metrics, std::ostringstream& out_str) const;
 
   MetricsConfig get_regret_metrics_config() const { return _regret_metrics_config; }
 
 private:
   int traverse_mccfr_p(MCCFRContext<StorageT>& ctx);
   int traverse_mccfr(MCCFRContext<StorageT>& ctx);
-  int external_sampling(const std::vector<Action>& actions, const MCCFRContext<StorageT>& ctx);
+  int traverse_mccfr_task(const MCCFRContext<StorageT>& ctx, Action a, int branching_idx, uint64_t stream);
+  void run_iteration(long t, long init_t, std::chrono::high_resolution_clock::time_point t_0);
+  int external_sampling(const std::vector<Action>& actions, const MCCFRContext<StorageT>& ctx, float freq[]);
 #ifdef UNIT_TEST
   template <template<typename> class T>
   friend int call_traverse_mccfr(MCCFRSolver<T>* trainer, const PokerState& state, int i, const Board& board, const std::vector<Hand>& hands, 
       std::vector<CachedIndexer>& indexers, const omp::HandEvaluator& eval);
+  template <template<typename> class T>
+  friend void call_run_iteration(MCCFRSolver<T>* trainer, long t);
 #endif
 
   long _t = 0;
@@ -184,7 +297,12 @@ private:
   std::filesystem::path _metrics_dir = "metrics";
   std::filesystem::path _log_dir = "logs";
   MetricsConfig _regret_metrics_config;
+  LBRConfig _lbr_config;
   std::atomic<bool> _interrupt = false;
+  bool _async_snapshots = false;
+  std::optional<uint64_t> _seed;
+  int _task_depth = 0;
+  std::vector<DealBuffer> _deal_buffers; // one per thread, reset for every solve
 };
 
 class TreeSolver : virtual public MCCFRSolver<TreeStorageNode>, public Strategy<int> {
@@ -193,6 +311,13 @@ public:
 
   const TreeStorageNode<int>* get_strategy() const override { return _regrets_root.get(); }
   const SolverConfig& get_config() const override { return Solver::get_config(); }
+  // only applies to regret trees created after the call, i.e. before the first iteration
+  void set_regret_precision(const RegretPrecision precision) { _regret_precision = precision; }
+  RegretPrecision get_regret_precision() const { return _regret_precision; }
+  // Keep a learned baseline per regret and replace the sampled values of opponent nodes by baseline corrected estimates (VR-MCCFR). Costs 4 bytes
+  // per regret. Only applies to regret trees created after the call, a loaded tree keeps its baselines.
+  void set_baselines(const bool baselines) { _baselines = baselines; }
+  bool uses_baselines() const { return _baselines; }
 
   bool operator==(const TreeSolver& other) const { return MCCFRSolver::operator==(other) && *_regrets_root == *other._regrets_root; }
   
@@ -204,7 +329,10 @@ public:
 protected:
   void on_start() override;
 
-  std::atomic<int>* get_base_regret_ptr(TreeStorageNode<int>* storage, int cluster) override;
+  RegretRow get_regret_row(TreeStorageNode<int>* storage, int cluster) override;
+  std::atomic<uint32_t>* get_prune_records(TreeStorageNode<int>* storage, int cluster) override { return storage->get_prune_records(cluster); }
+  bool uses_prune_records() const override { return _regrets_root && _regrets_root->has_prune_records(); }
+  std::atomic<float>* get_baselines(TreeStorageNode<int>* storage, int cluster) override { return storage->get_baselines(cluster); }
   TreeStorageNode<int>* init_regret_storage() override;
   TreeStorageNode<int>* next_regret_storage(TreeStorageNode<int>* storage, int action_idx, const SlimPokerState& next_state, int i) override;
   const std::vector<Action>& regret_branching_actions(TreeStorageNode<int>* storage) const override;
@@ -214,8 +342,13 @@ protected:
 
   virtual std::shared_ptr<const TreeStorageConfig> make_tree_config() const = 0;
 
+  void save_regrets(ShardedSnapshotWriter& writer) const;
+  void load_regrets(ShardedSnapshotReader& reader);
+
 private:
   std::unique_ptr<TreeStorageNode<int>> _regrets_root = nullptr;
+  RegretPrecision _regret_precision = RegretPrecision::INT32;
+  bool _baselines = false;
 };
 
 template <template<typename> class StorageT>
@@ -278,10 +411,10 @@ protected:
 
   void on_start() override;
   bool should_prune(long t) const override { return false; /* TODO: test pruning */ }
-  bool should_discount(const long t) const override { return t % _rt_config.is_discount_step(t); }
+  bool should_discount(const long t) const override { return _rt_config.is_discount_step(t); }
   bool should_snapshot(long t, long T) const override { return false; }
   bool should_log(const long t) const override { return (t + 1) % _rt_config.log_interval == 0; }
-  long next_step(const long t, const long T) const override { return std::min(_rt_config.next_discount_step(t, T), t + 20'000'000); }
+  long next_step(const long t, const long T) const override { return std::min(std::min(_rt_config.next_discount_step(t, T), t + 20'000'000), T); }
 
   void initialize_context(MCCFRContext<StorageT>& ctx) override;
   int get_cluster(int r, const Board& board, const Hand& hand, CachedIndexer& indexer) const override;
@@ -308,6 +441,11 @@ public:
 
   float frequency(Action action, const PokerState& state, const Board& board, const Hand& hand) const override;
   const TreeStorageNode<float>* get_phi() const { return _phi_root.get(); }
+  // Keep a PruneRecord per regret, so that pruned branches are re-explored on a schedule instead of on random iterations. Costs 4 bytes per
+  // regret. Only applies to regret trees created after the call, a loaded tree keeps its records.
+  void set_prune_records(const bool prune_records) { _prune_records = prune_records; }
+  // loads sharded snapshots as well as single file snapshots
+  void load_snapshot(const std::string& fn);
   void freeze(const std::vector<float>& freq, const Hand& hand, const Board& board, const ActionHistory& history) override;
 
   bool operator==(const TreeBlueprintSolver& other) const;
@@ -326,10 +464,12 @@ protected:
   std::atomic<float>* get_base_avg_ptr(TreeStorageNode<float>* storage, int cluster) override;
   TreeStorageNode<float>* init_avg_storage() override;
   TreeStorageNode<float>* next_avg_storage(TreeStorageNode<float>* storage, int action_idx, const SlimPokerState& next_state, int i) override;
-  void save_snapshot(const std::string& fn) const override { cereal_save(*this, fn); }
+  void save_snapshot(const std::string& fn) const override;
+  std::function<void()> prepare_snapshot(const std::string& fn, int n_threads) const override;
 
   void track_regret(nlohmann::json& metrics, std::ostringstream& out_str, long t) const override;
   void track_strategy(nlohmann::json& metrics, std::ostringstream& out_str) const override;
+  void track_lbr(nlohmann::json& metrics, std::ostringstream& out_str) const override;
 
   std::shared_ptr<const TreeStorageConfig> make_tree_config() const override;
   
@@ -337,6 +477,107 @@ protected:
 
 private:
   std::unique_ptr<TreeStorageNode<float>> _phi_root = nullptr;
+  bool _prune_records = false;
+};
+
+// Blueprint solver on fully preallocated StaticTrees. Regrets cover the whole game tree, phi only the preflop (see is_update_terminal).
+class StaticTreeBlueprintSolver : virtual public BlueprintSolver<StaticTreeNode>, public Strategy<int, StaticTreeNode<int>> {
+public:
+  explicit StaticTreeBlueprintSolver(const SolverConfig& config = SolverConfig{}, const BlueprintSolverConfig& bp_config = BlueprintSolverConfig{});
+
+  const StaticTreeNode<int>* get_strategy() const override { return _regrets ? _regrets->root() : nullptr; }
+  const SolverConfig& get_config() const override { return Solver::get_config(); }
+  float frequency(Action action, const PokerState& state, const Board& board, const Hand& hand) const override;
+  const StaticTree<int>* get_regrets() const { return _regrets.get(); }
+  const StaticTree<float>* get_phi() const { return _phi.get(); }
+  void freeze(const std::vector<float>& freq, const Hand& hand, const Board& board, const ActionHistory& history) override;
+
+  bool operator==(const StaticTreeBlueprintSolver& other) const;
+
+  template <class Archive>
+  void serialize(Archive& ar) {
+    ar(_regrets, _phi, cereal::base_class<BlueprintSolver>(this), cereal::base_class<MCCFRSolver>(this), cereal::base_class<Solver>(this));
+  }
+
+protected:
+  void on_start() override;
+  void on_snapshot() override;
+  bool is_frozen(int cluster, const StaticTreeNode<int>* storage) const override { return false; }
+
+  RegretRow get_regret_row(StaticTreeNode<int>* storage, int cluster) override;
+  std::atomic<float>* get_base_avg_ptr(StaticTreeNode<float>* storage, int cluster) override;
+  StaticTreeNode<int>* init_regret_storage() override;
+  StaticTreeNode<float>* init_avg_storage() override;
+  StaticTreeNode<int>* next_regret_storage(StaticTreeNode<int>* storage, int action_idx, const SlimPokerState& next_state, int i) override;
+  StaticTreeNode<float>* next_avg_storage(StaticTreeNode<float>* storage, int action_idx, const SlimPokerState& next_state, int i) override;
+  const std::vector<Action>& regret_branching_actions(StaticTreeNode<int>* storage) const override;
+  const std::vector<Action>& regret_value_actions(StaticTreeNode<int>* storage) const override;
+  const std::vector<Action>& avg_branching_actions(StaticTreeNode<float>* storage) const override;
+  const std::vector<Action>& avg_value_actions(StaticTreeNode<float>* storage) const override;
+  void save_snapshot(const std::string& fn) const override { cereal_save(*this, fn); }
+
+  void track_regret(nlohmann::json& metrics, std::ostringstream& out_str, long t) const override;
+  void track_strategy(nlohmann::json& metrics, std::ostringstream& out_str) const override;
+  void track_lbr(nlohmann::json& metrics, std::ostringstream& out_str) const override;
+
+  std::shared_ptr<const TreeStorageConfig> make_tree_config() const;
+
+private:
+  std::unique_ptr<StaticTree<int>> _regrets = nullptr;
+  std::unique_ptr<StaticTree<float>> _phi = nullptr;
+};
+
+// Blueprint solver on preallocated HashTables keyed by the action sequence. The tables are sized by their memory budgets, which bounds the
+// footprint of very large action profiles up front. Phi only covers the preflop (see is_update_terminal).
+class HashTableBlueprintSolver : virtual public BlueprintSolver<HashedInfoset>, public Strategy<int, HashedInfoset<int>> {
+public:
+  explicit HashTableBlueprintSolver(const SolverConfig& config = SolverConfig{}, const BlueprintSolverConfig& bp_config = BlueprintSolverConfig{});
+
+  const HashedInfoset<int>* get_strategy() const override { return _regrets ? _regrets->root() : nullptr; }
+  const SolverConfig& get_config() const override { return Solver::get_config(); }
+  float frequency(Action action, const PokerState& state, const Board& board, const Hand& hand) const override;
+  // only apply to tables created after the call, i.e. before the first iteration
+  void set_regret_table_config(const HashTableConfig& table_config) { _regret_table_config = table_config; }
+  void set_avg_table_config(const HashTableConfig& table_config) { _avg_table_config = table_config; }
+  const HashTable<int>* get_regrets() const { return _regrets.get(); }
+  const HashTable<float>* get_phi() const { return _phi.get(); }
+  void freeze(const std::vector<float>& freq, const Hand& hand, const Board& board, const ActionHistory& history) override;
+
+  bool operator==(const HashTableBlueprintSolver& other) const;
+
+  template <class Archive>
+  void serialize(Archive& ar) {
+    ar(_regrets, _phi, cereal::base_class<BlueprintSolver>(this), cereal::base_class<MCCFRSolver>(this), cereal::base_class<Solver>(this));
+  }
+
+protected:
+  void on_start() override;
+  void on_snapshot() override;
+  bool is_frozen(int cluster, const HashedInfoset<int>* storage) const override { return false; }
+
+  RegretRow get_regret_row(HashedInfoset<int>* storage, int cluster) override;
+  std::atomic<float>* get_base_avg_ptr(HashedInfoset<float>* storage, int cluster) override;
+  HashedInfoset<int>* init_regret_storage() override;
+  HashedInfoset<float>* init_avg_storage() override;
+  HashedInfoset<int>* next_regret_storage(HashedInfoset<int>* storage, int action_idx, const SlimPokerState& next_state, int i) override;
+  HashedInfoset<float>* next_avg_storage(HashedInfoset<float>* storage, int action_idx, const SlimPokerState& next_state, int i) override;
+  const std::vector<Action>& regret_branching_actions(HashedInfoset<int>* storage) const override;
+  const std::vector<Action>& regret_value_actions(HashedInfoset<int>* storage) const override;
+  const std::vector<Action>& avg_branching_actions(HashedInfoset<float>* storage) const override;
+  const std::vector<Action>& avg_value_actions(HashedInfoset<float>* storage) const override;
+  void save_snapshot(const std::string& fn) const override { cereal_save(*this, fn); }
+
+  void track_regret(nlohmann::json& metrics, std::ostringstream& out_str, long t) const override;
+  void track_strategy(nlohmann::json& metrics, std::ostringstream& out_str) const override;
+  void track_lbr(nlohmann::json& metrics, std::ostringstream& out_str) const override;
+
+  std::shared_ptr<const TreeStorageConfig> make_tree_config() const;
+
+private:
+  std::unique_ptr<HashTable<int>> _regrets = nullptr;
+  std::unique_ptr<HashTable<float>> _phi = nullptr;
+  HashTableConfig _regret_table_config;
+  HashTableConfig _avg_table_config{1UL << 28, 16};
 };
 
 class TreeRealTimeSolver : virtual public TreeSolver, virtual public RealTimeSolver<TreeStorageNode> {
@@ -1,4 +1,5 @@
 #include <array>
+#include <bit>
 #include <cassert>
 #include <iomanip>
 #include <iostream>
@@ -122,12 +123,13 @@ void Player::reset(const int chips) {
   _betsize = 0;
 }
 
-void Pot::add_side_pot(int amount, const std::vector<int>& player_idxs, const std::vector<Player>& players) {
-  if(!_pots) _pots = new std::vector<SidePot>{};
-  for(auto& [pot_amount, pot_players] : *_pots) {
+void Pot::add_side_pot(int amount, const std::vector<int>& player_idxs, const PlayerArray& players) {
+  uint16_t mask = 0;
+  for(const int p : player_idxs) mask |= 1 << p;
+  for(auto& [pot_amount, pot_players] : _pots) {
     bool match = true;
-    for(int p : pot_players) {
-      if(!players[p].has_folded() && std::ranges::find(player_idxs, p) == player_idxs.end()) { // TODO: performance: && players[p].chips == 0
+    for(int p = 0; p < players.size(); ++p) {
+      if((pot_players >> p & 1) && !players[p].has_folded() && !(mask >> p & 1)) { // TODO: performance: && players[p].chips == 0
         match = false;
         break;
       }
@@ -137,7 +139,8 @@ void Pot::add_side_pot(int amount, const std::vector<int>& player_idxs, const st
       return;
     }
   }
-  _pots->emplace_back(amount, player_idxs);
+  if(_pots.size() == _pots.capacity()) throw std::runtime_error("Too many side pots.");
+  _pots.push_back(SidePot{amount, mask});
 }
 
 SlimPokerState::SlimPokerState(const int n_players, const std::vector<int>& chips, const int ante, const bool straddle)
@@ -146,7 +149,7 @@ SlimPokerState::SlimPokerState(const int n_players, const std::vector<int>& chip
     throw std::runtime_error("Player amount mismatch: n_players=" + std::to_string(n_players) + ", chip stacks=" + std::to_string(chips.size()));
   }
 
-  _players.reserve(n_players);
+  if(n_players > MAX_PLAYERS) throw std::runtime_error("Too many players: n_players=" + std::to_string(n_players));
   for(int i = 0; i < n_players; ++i) {
     _players.emplace_back(chips[i]);
   }
@@ -226,7 +229,7 @@ void SlimPokerState::apply_in_place(const ActionHistory& action_history) {
 
 void SlimPokerState::apply_biases_in_place(const std::vector<Action>& biases) {
   if(biases.size() != get_players().size()) throw std::runtime_error("Number of biases to apply does not match number of players.");
-  _biases = biases;
+  _biases.assign(biases.begin(), biases.end());
 }
 
 SlimPokerState SlimPokerState::apply_copy(const Action action) const {
@@ -259,14 +262,18 @@ std::string SlimPokerState::to_string() const {
   std::ostringstream oss;
   oss << "============== " << round_to_str(_round) << ": " << std::fixed << std::setprecision(2) << _pot.total() / 100.0 << " bb ==============\n";
   if(_pot.has_side_pots()) {
-    const auto& pots = *_pot.get_side_pots();
+    const auto& pots = _pot.get_side_pots();
     for(int i = 0; i < pots.size(); ++i) {
       oss << "Pot " << i << ": " << pots[i].amount / 100.0 << " bb (Players: ";
-      for(int p = 0; p < pots[i].players.size(); ++p) oss << p << (p != pots[i].players.size() - 1 ? ", " : ")\n");
+      std::vector<std::string> pot_players;
+      for(int p = 0; p < _players.size(); ++p) {
+        if(pots[i].contains(p)) pot_players.push_back(std::to_string(p));
+      }
+      oss << join_strs(pot_players, ", ") << ")\n";
     }
   }
   if(!_biases.empty()) {
-    oss << "Biases: " << actions_to_str(_biases) << "\n";
+    oss << "Biases: " << actions_to_str(_biases.to_vector()) << "\n";
   }
   oss << "Bet level: " << static_cast<int>(_bet_level) << ", Max bet: " << _max_bet / 100.0 << " bb, Min raise: " << _min_raise / 100.0 << " bb\n";
   if(_winner != -1) oss << "Winner: " << pos_to_str(_winner, _players.size(), _straddle) << "\n";
@@ -285,7 +292,7 @@ std::string SlimPokerState::to_string() const {
 
 int8_t find_winner(const SlimPokerState& state) {
   int8_t winner = -1;
-  const std::vector<Player>& players = state.get_players();
+  const PlayerArray& players = state.get_players();
   for(int8_t i = 0; i < static_cast<int8_t>(players.size()); ++i) {
     if(!players[i].has_folded()) {
       if(winner == -1) winner = i;
@@ -534,70 +541,98 @@ double fractional_bet_size(const SlimPokerState& state, const int total_size) {
   return raise_size / pot_size;
 }
 
-bool is_action_valid(const Action a, const SlimPokerState& state) {
-  const Player& player = state.get_players()[state.get_active()];
-  if(a == Action::CHECK_CALL) return true;
-  if(a == Action::FOLD) return player.get_betsize() < state.get_max_bet() && player.get_chips() > 0;
-  if(state.n_players_with_chips() == 1) return false;
+// whether an opponent that has not folded can still call a raise
+bool opponents_can_call(const SlimPokerState& state) {
+  for(int p_idx = 0; p_idx < state.get_players().size(); ++p_idx) {
+    const Player& opponent = state.get_players()[p_idx];
+    if(!opponent.has_folded() && p_idx != state.get_active() && opponent.get_betsize() + opponent.get_chips() > state.get_max_bet()) return true;
+  }
+  return false;
+}
+
+bool is_raise_size_valid(const Action a, const SlimPokerState& state, const Player& player) {
   const int total_bet = total_bet_size(state, a);
   const int required = total_bet - player.get_betsize();
   // TODO: bets below the min_raise are allowed when no one has bet yet and the player's stack is less than the min_raise
   // TODO: what about when a previous player has bet all-in less than the min raise - can the next player raise less than the min raise if his stack is
   //       less than the min_raise? is the next min raise decreased due to the all-in raise?
-  if(required <= player.get_chips() && total_bet - state.get_max_bet() >= state.get_min_raise()) {
-    bool can_bet = false;
-    for(int p_idx = 0; p_idx < state.get_players().size(); ++p_idx) {
-      const Player& opponent = state.get_players()[p_idx];
-      can_bet |= !opponent.has_folded() && p_idx != state.get_active() && opponent.get_betsize() + opponent.get_chips() > state.get_max_bet();
-    }
-    if(can_bet) return true;
+  return required <= player.get_chips() && total_bet - state.get_max_bet() >= state.get_min_raise();
+}
+
+bool is_action_valid(const Action a, const SlimPokerState& state) {
+  const Player& player = state.get_players()[state.get_active()];
+  if(a == Action::CHECK_CALL) return true;
+  if(a == Action::FOLD) return player.get_betsize() < state.get_max_bet() && player.get_chips() > 0;
+  if(state.n_players_with_chips() == 1) return false;
+  return is_raise_size_valid(a, state, player) && opponents_can_call(state);
+}
+
+uint16_t valid_action_mask(const SlimPokerState& state, const std::vector<Action>& actions) {
+  if(actions.size() > 16) throw std::runtime_error("Too many actions for a valid action mask: " + std::to_string(actions.size()));
+  const Player& player = state.get_players()[state.get_active()];
+  const bool can_fold = player.get_betsize() < state.get_max_bet() && player.get_chips() > 0;
+  // the opponents are the same for every raise size, check them once
+  const bool can_raise = state.n_players_with_chips() != 1 && opponents_can_call(state);
+  uint16_t mask = 0;
+  for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
+    const Action a = actions[a_idx];
+    bool valid;
+    if(a == Action::CHECK_CALL) valid = true;
+    else if(a == Action::FOLD) valid = can_fold;
+    else valid = can_raise && is_raise_size_valid(a, state, player);
+    mask |= static_cast<uint16_t>(valid) << a_idx;
   }
-  return false;
+  return mask;
+}
+
+std::vector<Action> masked_actions(const std::vector<Action>& actions, const uint16_t mask) {
+  std::vector<Action> masked;
+  masked.reserve(std::popcount(mask));
+  for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
+    if(mask >> a_idx & 1) masked.push_back(actions[a_idx]);
+  }
+  return masked;
 }
 
 std::vector<Action> valid_actions(const SlimPokerState& state, const ActionProfile& profile) {
   const std::vector<Action>& actions = profile.get_actions(state);
-  std::vector<Action> valid;
-  valid.reserve(actions.size());
-  for(const Action a : actions) {
-    if(is_action_valid(a, state)) valid.push_back(a);
-  }
-  return valid;
+  return masked_actions(actions, valid_action_mask(state, actions));
 }
 
-uint16_t score_hands(uint16_t scores[], const std::vector<Player>& players, const std::vector<Hand>& hands, const Board& board_cards,
-    const omp::HandEvaluator& eval) {
-  uint16_t best = 0;
-  omp::Hand board = omp::Hand::empty();
-  for(const uint8_t& idx : board_cards.cards()) {
-    board += omp::Hand(idx);
+ShowdownRanks::ShowdownRanks(const Board& board, const std::vector<Hand>& hands, const omp::HandEvaluator& eval)
+    : _n_players{static_cast<uint8_t>(hands.size())} {
+  omp::Hand board_hand = omp::Hand::empty();
+  for(const uint8_t& idx : board.cards()) {
+    board_hand += omp::Hand(idx);
   }
-  for(int i = 0; i < hands.size(); ++i) {
-    if(!players[i].has_folded()) {
-      const uint16_t score = eval.evaluate(board + hands[i].cards()[0] + hands[i].cards()[1]);
-      scores[i] = score;
-      best = std::max(score, best);
-    }
+  for(int p = 0; p < _n_players; ++p) {
+    _scores[p] = eval.evaluate(board_hand + hands[p].cards()[0] + hands[p].cards()[1]);
+    _order[p] = p;
+  }
+  // stable insertion sort, std::stable_sort allocates a merge buffer
+  for(int k = 1; k < _n_players; ++k) {
+    const uint8_t p = _order[k];
+    int j = k;
+    for(; j > 0 && _scores[_order[j - 1]] < _scores[p]; --j) _order[j] = _order[j - 1];
+    _order[j] = p;
   }
-  return best;
 }
 
-int side_pot_payoff(const SlimPokerState& state, const int i, const Board& board, const std::vector<Hand>& hands, const RakeStructure& rake,
-    const omp::HandEvaluator& eval) {
+int side_pot_payoff(const SlimPokerState& state, const int i, const ShowdownRanks& ranks, const RakeStructure& rake) {
   // TODO: collapse side pots to distribute odd chips correctly - pop all players that have folded from all pots, combine equal pots.
   // two odd chip pots -> one even chip pot, removes odd chip bias to the first winner
-  uint16_t scores[MAX_PLAYERS]{};
-  const auto best = score_hands(scores, state.get_players(), hands, board, eval);
+  const uint16_t best = ranks.best(state.get_players());
   const int total_payoff = rake.payoff(state.get_round(), state.get_pot().total());
   int payoff = 0;
-  for(const auto& [amount, pot_players] : *state.get_pot().get_side_pots()) {
-    if(scores[i] < best) continue;
+  for(const auto& [amount, pot_players] : state.get_pot().get_side_pots()) {
+    if(ranks.score(i) < best) continue;
     int n_winners = 0;
     int first_winner = -1;
     bool found = false;
-    for(const int p_idx : pot_players) {
+    for(int p_idx = 0; p_idx < state.get_players().size(); ++p_idx) {
+      if(!(pot_players >> p_idx & 1)) continue;
       found |= p_idx == i;
-      if(!state.get_players()[p_idx].has_folded() && scores[p_idx] == best) {
+      if(!state.get_players()[p_idx].has_folded() && ranks.score(p_idx) == best) {
         ++n_winners;
         if(first_winner == -1) first_winner = p_idx;
       }
@@ -607,15 +642,13 @@ int side_pot_payoff(const SlimPokerState& state, const int i, const Board& board
   return static_cast<int>(std::round(static_cast<float>(payoff) / static_cast<float>(state.get_pot().total()) * static_cast<float>(total_payoff)));
 }
 
-int no_side_pot_payoff(const SlimPokerState& state, const int i, const Board& board, const std::vector<Hand>& hands, const RakeStructure& rake,
-    const omp::HandEvaluator& eval) {
-  uint16_t scores[MAX_PLAYERS]{};
-  const auto best = score_hands(scores, state.get_players(), hands, board, eval);
+int no_side_pot_payoff(const SlimPokerState& state, const int i, const ShowdownRanks& ranks, const RakeStructure& rake) {
+  const uint16_t best = ranks.best(state.get_players());
   bool winner = false;
   int n_winners = 0;
   int first_winner = -1;
   for(int p = 0; p < state.get_players().size(); ++p) {
-    if(!state.get_players()[p].has_folded() && scores[p] == best) {
+    if(!state.get_players()[p].has_folded() && ranks.score(p) == best) {
       winner |= p == i;
       ++n_winners;
       if(first_winner == -1) first_winner = p;
@@ -625,11 +658,15 @@ int no_side_pot_payoff(const SlimPokerState& state, const int i, const Board& bo
   return winner ? payoff / n_winners + (first_winner == i ? payoff % n_winners : 0) : 0;
 }
 
+int showdown_payoff(const SlimPokerState& state, const int i, const ShowdownRanks& ranks, const RakeStructure& rake) {
+  if(state.get_players()[i].has_folded()) return 0;
+  return state.get_pot().has_side_pots() ? side_pot_payoff(state, i, ranks, rake) : no_side_pot_payoff(state, i, ranks, rake);
+}
+
 int showdown_payoff(const SlimPokerState& state, const int i, const Board& board, const std::vector<Hand>& hands, const RakeStructure& rake,
     const omp::HandEvaluator& eval) {
   if(state.get_players()[i].has_folded()) return 0;
-  return state.get_pot().has_side_pots() ? side_pot_payoff(state, i, board, hands, rake, eval) : no_side_pot_payoff(state, i, board, hands, rake, eval);
-
+  return showdown_payoff(state, i, ShowdownRanks{board, hands, eval}, rake);
 }
 
 void deal_hands(Deck& deck, std::vector<std::array<uint8_t, 2>>& hands) {
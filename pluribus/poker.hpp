@@ -12,6 +12,7 @@
 #include <pluribus/actions.hpp>
 #include <pluribus/constants.hpp>
 #include <pluribus/debug.hpp>
+#include <pluribus/fixed_vector.hpp>
 #include <pluribus/util.hpp>
 
 namespace pluribus {
@@ -155,7 +156,8 @@ int blind_size(const SlimPokerState& state, int pos);
 
 class Player {
 public:
-  explicit Player(const int chips = 10'000) : _chips{chips} {}
+  Player() : Player{10'000} {}
+  explicit Player(const int chips) : _chips{chips} {}
   Player(const Player&) = default;
   Player(Player&&) = default;
 
@@ -200,71 +202,68 @@ struct PokerConfig {
   bool straddle = false;
 };
 
+using PlayerArray = FixedVector<Player, MAX_PLAYERS>;
+using BiasArray = FixedVector<Action, MAX_PLAYERS>;
+
 struct SidePot {
   int amount;
-  std::vector<int> players;
+  uint16_t players; // bitmask of player indices
+
+  bool contains(const int p) const { return players >> p & 1; }
+  bool operator==(const SidePot& other) const = default;
 
+  // player indices are stored as a list of ints to stay compatible with snapshots of the heap allocated side pots
   template <class Archive>
-  void serialize(Archive& ar) {
-    ar(amount, players);
+  void save(Archive& ar) const {
+    FixedVector<int, MAX_PLAYERS> idxs;
+    for(int p = 0; p < MAX_PLAYERS; ++p) {
+      if(contains(p)) idxs.push_back(p);
+    }
+    ar(amount, idxs);
+  }
+
+  template <class Archive>
+  void load(Archive& ar) {
+    FixedVector<int, MAX_PLAYERS> idxs;
+    ar(amount, idxs);
+    players = 0;
+    for(const int p : idxs) players |= 1 << p;
   }
 };
 
+// Every all-in level creates at most one side pot, so MAX_PLAYERS side pots are stored inline.
+using SidePotArray = FixedVector<SidePot, MAX_PLAYERS>;
+
 class Pot {
 public:
   explicit Pot() = default;
   explicit Pot(const int amount) : _total{amount} {}
-  Pot(const Pot& o) : _total(o._total) {
-    _pots = o._pots ? new std::vector(*o._pots) : nullptr;
-  }
-  Pot(Pot&& o) noexcept : _total(o._total), _pots(o._pots) { o._pots = nullptr; }
-  ~Pot() { if(_pots) delete _pots; }
 
   int total() const { return _total; }
   void add(const int amount) { _total += amount; }
-  void add_side_pot(int amount, const std::vector<int>& player_idxs, const std::vector<Player>& players);
-  bool has_side_pots() const { return _pots != nullptr; }
-  const std::vector<SidePot>* get_side_pots() const { return _pots; }
+  void add_side_pot(int amount, const std::vector<int>& player_idxs, const PlayerArray& players);
+  bool has_side_pots() const { return !_pots.empty(); }
+  const SidePotArray& get_side_pots() const { return _pots; }
 
   bool operator==(const Pot& other) const = default;
-  Pot& operator=(const Pot& o) {
-    if (this == &o) return *this;
-    _total = o._total;
-    delete _pots;
-    _pots = o._pots ? new std::vector(*o._pots) : nullptr;
-    return *this;
-  }
-  Pot& operator=(Pot&& o) noexcept {
-    if (this == &o) return *this;
-    _total = o._total;
-    delete _pots;
-    _pots = o._pots; o._pots = nullptr;
-    return *this;
-  }
 
   template <class Archive>
   void load(Archive& ar) {
-    if(_pots) {
-      delete _pots;
-      _pots = nullptr;
-    }
     bool has_pots;
     ar(_total, has_pots);
-    if(has_pots) {
-      _pots = new std::vector<SidePot>{};
-      ar(*_pots);
-    }
+    _pots.clear();
+    if(has_pots) ar(_pots);
   }
 
   template <class Archive>
   void save(Archive& ar) const {
-    ar(_total, _pots != nullptr);
-    if(_pots) ar(*_pots);
+    ar(_total, has_side_pots());
+    if(has_side_pots()) ar(_pots);
   }
 
 private:
   int _total = 0;
-  std::vector<SidePot>* _pots = nullptr;
+  SidePotArray _pots;
 };
 
 class SlimPokerState {
@@ -279,7 +278,7 @@ public:
   SlimPokerState& operator=(SlimPokerState&&) = default;
   bool operator==(const SlimPokerState& other) const = default;
 
-  const std::vector<Player>& get_players() const { return _players; }
+  const PlayerArray& get_players() const { return _players; }
   const Pot& get_pot() const { return _pot; }
   bool is_straddle() const { return _straddle; }
   int get_max_bet() const { return _max_bet; }
@@ -289,7 +288,7 @@ public:
   uint8_t get_bet_level() const { return _bet_level; }
   int8_t get_winner() const { return _winner; }
   int n_players_with_chips() const { return _players.size() - _no_chips; }
-  const std::vector<Action>& get_biases() const { return _biases; }
+  const BiasArray& get_biases() const { return _biases; }
   bool is_terminal() const { return get_winner() != -1 || get_round() >= 4; }
   bool has_player_vpip(int pos) const;
   bool is_in_position(int pos) const;
@@ -314,9 +313,9 @@ public:
   uint8_t _first_bias = 10; // TODO: remove, just for asserts
 
 private:
-  std::vector<Player> _players;
+  PlayerArray _players;
   Pot _pot;
-  std::vector<Action> _biases;
+  BiasArray _biases;
   int _max_bet;
   int _min_raise;
   uint8_t _active;
@@ -341,6 +340,12 @@ private:
   void update_side_pots();
 };
 
+static_assert(std::is_trivially_copyable_v<SlimPokerState>, "SlimPokerState is copied at every traverser branch and must not allocate.");
+// 252 bytes, mostly the inline storage for MAX_PLAYERS players (112), biases (40) and side pots (80 with the pot). Packing the fold flags, bias ids
+// and side pot masks still leaves 3 cache lines, 2 would take 16 bit chip counts or side pots on the heap again. Copying the state per branch
+// measured faster than make/unmake in the traversal benchmark, so the layout is kept simple.
+static_assert(sizeof(SlimPokerState) <= 256, "SlimPokerState should stay within 4 cache lines.");
+
 class PokerState : public SlimPokerState {
 public:
   using SlimPokerState::SlimPokerState;
@@ -391,8 +396,35 @@ int total_bet_size(const SlimPokerState& state, float frac);
 int total_bet_size(const SlimPokerState& state, Action action);
 double fractional_bet_size(const SlimPokerState& state, int total_size);
 bool is_action_valid(Action a, const SlimPokerState& state);
+// bit a_idx is set if actions[a_idx] is valid, allocation free alternative to valid_actions for at most 16 actions
+uint16_t valid_action_mask(const SlimPokerState& state, const std::vector<Action>& actions);
+std::vector<Action> masked_actions(const std::vector<Action>& actions, uint16_t mask);
 std::vector<Action> valid_actions(const SlimPokerState& state, const ActionProfile& profile);
 int round_of_last_action(const SlimPokerState& state);
+
+// Hand ranks of all players of one deal. Board and hands are fixed for all traversals of a deal, so they are evaluated once and showdowns only
+// distribute the pot among the best players that have not folded.
+class ShowdownRanks {
+public:
+  ShowdownRanks() = default;
+  ShowdownRanks(const Board& board, const std::vector<Hand>& hands, const omp::HandEvaluator& eval);
+
+  uint16_t score(const int p) const { return _scores[p]; }
+  // best score of the players that have not folded
+  uint16_t best(const PlayerArray& players) const {
+    for(int k = 0; k < _n_players; ++k) {
+      if(!players[_order[k]].has_folded()) return _scores[_order[k]];
+    }
+    return 0;
+  }
+
+private:
+  std::array<uint16_t, MAX_PLAYERS> _scores{};
+  std::array<uint8_t, MAX_PLAYERS> _order{}; // players from best to worst hand
+  uint8_t _n_players = 0;
+};
+
+int showdown_payoff(const SlimPokerState& state, int i, const ShowdownRanks& ranks, const RakeStructure& rake);
 int showdown_payoff(const SlimPokerState& state, int i, const Board& board, const std::vector<Hand>& hands, const RakeStructure& rake,
     const omp::HandEvaluator& eval);
 }
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace pluribus {
+
+// Regret based pruning state of a single (node, cluster, action) of the traverser, stored next to the regrets (see TreeStorageConfig::prune_records).
+// A branch whose regret is at or below the cutoff is skipped for SKIP_VISITS << level visits, it is neither traversed nor allocated. It is then
+// traversed on the next EXPLORE_VISITS visits so that its regret can recover, and checked again: branches that are still below the cutoff are
+// skipped twice as long as before, all others are no longer pruned. The schedule counts visits of the (node, cluster) rather than iterations,
+// so rarely visited infosets are explored as often as frequent ones relative to their updates.
+// Layout: remaining visits of the phase (27 bits) | pruned (1 bit) | exploring (1 bit) | level (3 bits). Exactly one of pruned and exploring is set
+// while the branch is on the schedule, 0 is a branch that is not on it.
+class PruneRecord {
+public:
+  static constexpr uint32_t SKIP_VISITS = 64;
+  static constexpr uint32_t EXPLORE_VISITS = 8;
+  static constexpr uint32_t MAX_LEVEL = 7;
+
+  // Advances the schedule by one visit and returns true if the branch is skipped on this visit. Concurrent visits race on the record,
+  // which only loses visits.
+  static bool skip(std::atomic<uint32_t>& record, const int regret, const int cutoff) {
+    const uint32_t r = record.load(std::memory_order_relaxed);
+    if(r == 0) {
+      if(regret > cutoff) return false;
+      record.store(pack(SKIP_VISITS - 1, false, 0), std::memory_order_relaxed);
+      return true;
+    }
+    const uint32_t remaining = r >> 5;
+    const bool exploring = r & EXPLORING;
+    const uint32_t level = r & LEVEL_MASK;
+    if(remaining > 0) {
+      record.store(pack(remaining - 1, exploring, level), std::memory_order_relaxed);
+      return !exploring;
+    }
+    if(!exploring) {
+      record.store(pack(EXPLORE_VISITS - 1, true, level), std::memory_order_relaxed);
+      return false;
+    }
+    if(regret > cutoff) {
+      record.store(0, std::memory_order_relaxed);
+      return false;
+    }
+    const uint32_t next_level = std::min(level + 1, MAX_LEVEL);
+    record.store(pack((SKIP_VISITS << next_level) - 1, false, next_level), std::memory_order_relaxed);
+    return true;
+  }
+
+  // true while the branch is skipped, false in the explore window
+  static bool is_pruned(const uint32_t record) { return record & PRUNED; }
+  static bool is_exploring(const uint32_t record) { return record & EXPLORING; }
+  static uint32_t level(const uint32_t record) { return record & LEVEL_MASK; }
+
+private:
+  static constexpr uint32_t PRUNED = 1 << 4;
+  static constexpr uint32_t EXPLORING = 1 << 3;
+  static constexpr uint32_t LEVEL_MASK = (1 << 3) - 1;
+
+  static uint32_t pack(const uint32_t remaining, const bool exploring, const uint32_t level) {
+    return remaining << 5 | (exploring ? EXPLORING : PRUNED) | level;
+  }
+};
+
+}
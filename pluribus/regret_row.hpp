@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <pluribus/rng.hpp>
+
+namespace pluribus {
+
+enum class RegretPrecision : uint8_t {
+  INT32, // std::atomic<int> per regret
+  INT16  // 16 bit saturating regrets with a shared scale per row (cluster)
+};
+
+// Regrets of a single infoset (one cluster of a storage node). 16 bit rows store q with regret = q * 2^shift. Increments are stochastically rounded
+// to the row scale so that small regret updates are kept in expectation. A row that overflows doubles its scale, the thread that wins the scale CAS
+// halves the row. Concurrent updates during a rescale can be applied at the old scale, which is the same kind of race the 32 bit regrets tolerate.
+class RegretRow {
+public:
+  static constexpr int MAX_SHIFT = 16;
+
+  explicit RegretRow(std::atomic<int>* values) : _values{values} {}
+  RegretRow(std::atomic<int16_t>* q_values, std::atomic<uint8_t>* shift, const int n_values) : _q_values{q_values}, _shift{shift}, _n_values{n_values} {}
+
+  int load(const int idx) const {
+    if(_values) return _values[idx].load(std::memory_order_relaxed);
+    return _q_values[idx].load(std::memory_order_relaxed) * (1 << _shift->load(std::memory_order_relaxed));
+  }
+
+  // the row as plain ints, 32 bit rows are read in place and 16 bit rows are dequantized into buffer
+  const int* values(int* buffer, const int n) const {
+    static_assert(sizeof(std::atomic<int>) == sizeof(int) && std::atomic<int>::is_always_lock_free);
+    if(_values) return reinterpret_cast<const int*>(_values);
+    for(int i = 0; i < n; ++i) buffer[i] = load(i);
+    return buffer;
+  }
+
+  void add(const int idx, const int d) {
+    if(_values) {
+      _values[idx].fetch_add(d, std::memory_order_relaxed);
+      return;
+    }
+    while(true) {
+      const int shift = _shift->load(std::memory_order_relaxed);
+      const long dq = quantize(d, shift);
+      if(dq == 0) return;
+      int16_t q = _q_values[idx].load(std::memory_order_relaxed);
+      const long next = q + dq;
+      if(next >= std::numeric_limits<int16_t>::min() && next <= std::numeric_limits<int16_t>::max()) {
+        if(_q_values[idx].compare_exchange_weak(q, static_cast<int16_t>(next), std::memory_order_relaxed)) return;
+      }
+      else if(shift < MAX_SHIFT) {
+        grow_scale(shift);
+      }
+      else {
+        _q_values[idx].store(saturate(next), std::memory_order_relaxed);
+        return;
+      }
+    }
+  }
+
+  void store(const int idx, const int v) {
+    if(_values) {
+      _values[idx].store(v, std::memory_order_relaxed);
+      return;
+    }
+    int shift = _shift->load(std::memory_order_relaxed);
+    while(shift < MAX_SHIFT && std::abs(static_cast<long>(v) >> shift) > std::numeric_limits<int16_t>::max()) {
+      grow_scale(shift);
+      shift = _shift->load(std::memory_order_relaxed);
+    }
+    _q_values[idx].store(saturate(static_cast<long>(v) >> shift), std::memory_order_relaxed);
+  }
+
+  // 16 bit rows only. Not thread safe, the owning node serializes discounts with its epoch stamp.
+  void discount(const double d) {
+    int max_q = 0;
+    for(int i = 0; i < _n_values; ++i) {
+      const auto q = static_cast<int16_t>(std::lrint(_q_values[i].load(std::memory_order_relaxed) * d));
+      _q_values[i].store(q, std::memory_order_relaxed);
+      max_q = std::max(max_q, std::abs(static_cast<int>(q)));
+    }
+    // regain precision lost by earlier rescales
+    int shift = _shift->load(std::memory_order_relaxed);
+    for(; shift > 0 && max_q <= std::numeric_limits<int16_t>::max() / 2; --shift, max_q *= 2) {
+      for(int i = 0; i < _n_values; ++i) _q_values[i].store(_q_values[i].load(std::memory_order_relaxed) * 2, std::memory_order_relaxed);
+    }
+    _shift->store(shift, std::memory_order_relaxed);
+  }
+
+private:
+  static long quantize(const int d, const int shift) {
+    if(shift == 0) return d;
+    const long q = static_cast<long>(d) >> shift;
+    const uint32_t remainder = static_cast<uint32_t>(d - q * (1L << shift));
+    // drawn from the traversal's random stream, so seeded solves round the same way
+    return q + ((static_cast<uint32_t>(FastRNG::instance()() >> 32) & ((1U << shift) - 1)) < remainder ? 1 : 0);
+  }
+
+  static int16_t saturate(const long q) {
+    return static_cast<int16_t>(std::clamp<long>(q, std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max()));
+  }
+
+  void grow_scale(int shift) {
+    auto expected = static_cast<uint8_t>(shift);
+    if(!_shift->compare_exchange_strong(expected, shift + 1, std::memory_order_relaxed)) return;
+    for(int i = 0; i < _n_values; ++i) {
+      int16_t q = _q_values[i].load(std::memory_order_relaxed);
+      // rounded like increments, a plain shift would bias every odd value towards -inf
+      while(!_q_values[i].compare_exchange_weak(q, static_cast<int16_t>(quantize(q, 1)), std::memory_order_relaxed)) {}
+    }
+  }
+
+  std::atomic<int>* _values = nullptr;
+  std::atomic<int16_t>* _q_values = nullptr;
+  std::atomic<uint8_t>* _shift = nullptr;
+  int _n_values = 0;
+};
+
+}
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <random>
 #include <thread>
+#include <vector>
 #include <gsl/gsl_randist.h>
 #include <gsl/gsl_rng.h>
+#include <omp/Random.h>
 
 namespace pluribus {
 
@@ -50,15 +53,82 @@ public:
   }
 };
 
-class GSLDiscreteDist {
+// splitmix64 finalizer, maps nearby seeds to uncorrelated generator states
+constexpr uint64_t mix_seed(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// Thread local XoroShiro128+ of the MCCFR hot paths. Solvers reseed it from (run_seed, t, i) before every traversal, so the random numbers of
+// a traversal only depend on the run seed and not on the thread or the traversals that ran on it before.
+class FastRNG {
+public:
+  static omp::XoroShiro128Plus& instance() {
+    thread_local omp::XoroShiro128Plus rng = seeded(mix_seed(std::random_device{}()));
+    return rng;
+  }
+
+  // stream > 0 selects an independent generator of the same traversal, e.g. for a subtree that is traversed as a separate task
+  static void seed(const uint64_t run_seed, const long t, const int i, const uint64_t stream = 0) {
+    const uint64_t traversal_seed = mix_seed(mix_seed(run_seed ^ mix_seed(static_cast<uint64_t>(t))) + static_cast<uint64_t>(i));
+    instance() = seeded(stream ? mix_seed(traversal_seed + stream) : traversal_seed);
+  }
+
+  // upper bits only, the lowest bits of XoroShiro128+ are weak
+  static double uniform() { return (instance()() >> 11) * 0x1.0p-53; }
+  static uint64_t uniform_int(const uint64_t n) { return static_cast<uint64_t>((static_cast<unsigned __int128>(instance()()) * n) >> 64); }
+
+private:
+  // the generator starts from the state {~seed, seed}, so its first output is all ones for every seed and is discarded
+  static omp::XoroShiro128Plus seeded(const uint64_t seed) {
+    omp::XoroShiro128Plus rng{seed};
+    rng();
+    return rng;
+  }
+};
+
+// Walker alias table over the weights, samples in constant time from FastRNG
+class DiscreteDist {
 public:
-  explicit GSLDiscreteDist(const std::vector<double>& weights) {
-    _dist = std::shared_ptr<gsl_ran_discrete_t>{gsl_ran_discrete_preproc(weights.size(), weights.data()), [](gsl_ran_discrete_t* p) { gsl_ran_discrete_free(p); }}; 
+  explicit DiscreteDist(const std::vector<double>& weights) : _prob(weights.size()), _alias(weights.size()) {
+    double total = 0.0;
+    for(const double w : weights) total += w;
+    std::vector<double> scaled(weights.size());
+    std::vector<uint32_t> small, large;
+    for(uint32_t idx = 0; idx < weights.size(); ++idx) {
+      scaled[idx] = weights[idx] * weights.size() / total;
+      (scaled[idx] < 1.0 ? small : large).push_back(idx);
+    }
+    while(!small.empty() && !large.empty()) {
+      const uint32_t s = small.back(), l = large.back();
+      small.pop_back();
+      _prob[s] = scaled[s];
+      _alias[s] = l;
+      scaled[l] -= 1.0 - scaled[s];
+      if(scaled[l] < 1.0) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+    // leftovers are 1 up to rounding errors
+    for(const auto& rest : {large, small}) {
+      for(const uint32_t idx : rest) {
+        _prob[idx] = 1.0;
+        _alias[idx] = idx;
+      }
+    }
   }
-  size_t sample() const { return gsl_ran_discrete(GSLGlobalRNG::instance(), _dist.get()); }
-  ~GSLDiscreteDist() {  }
+
+  size_t sample() const {
+    const size_t idx = FastRNG::uniform_int(_prob.size());
+    return FastRNG::uniform() < _prob[idx] ? idx : _alias[idx];
+  }
+
 private:
-  std::shared_ptr<gsl_ran_discrete_t> _dist = nullptr;
+  std::vector<double> _prob;
+  std::vector<uint32_t> _alias;
 };
 
 }
@@ -15,9 +15,10 @@ MarginalRejectionSampler::MarginalRejectionSampler(const std::vector<PokerRange>
   for(const auto& r : dead_ranges) _hand_dists.emplace_back(r.weights());
 }
 
-RoundSample sample_rejection(const int n_players, const uint64_t mask, int* indexes, const std::function<int(int)>& idx_sampler,
+void sample_rejection(RoundSample& sample, const int n_players, const uint64_t mask, int* indexes, const std::function<int(int)>& idx_sampler,
     const std::function<Hand(int,int)>& idx_to_hand) {
-  RoundSample sample{std::vector<Hand>(n_players)};
+  sample.hands.resize(n_players);
+  sample.weight = 1.0;
   int coll;
   int tries = 0;
   do {
@@ -32,14 +33,25 @@ RoundSample sample_rejection(const int n_players, const uint64_t mask, int* inde
       sample.mask |= sample.hands[i].mask();
     }
   } while(coll > 0);
+}
+
+RoundSample sample_rejection(const int n_players, const uint64_t mask, int* indexes, const std::function<int(int)>& idx_sampler,
+    const std::function<Hand(int,int)>& idx_to_hand) {
+  RoundSample sample;
+  sample_rejection(sample, n_players, mask, indexes, idx_sampler, idx_to_hand);
   return sample;
 }
 
 RoundSample MarginalRejectionSampler::sample() {
-  RoundSample sample = sample_rejection(_hand_dists.size(), init_mask(), _hand_idxs, [this](const int i) { return this->_hand_dists[i].sample(); },
+  RoundSample sample;
+  sample_in_place(sample);
+  return sample;
+}
+
+void MarginalRejectionSampler::sample_in_place(RoundSample& sample) {
+  sample_rejection(sample, _hand_dists.size(), init_mask(), _hand_idxs, [this](const int i) { return this->_hand_dists[i].sample(); },
       [](int, const int h_idx) { return HoleCardIndexer::get_instance()->hand(h_idx); });
   sample.hands.resize(_n_players);
-  return sample;
 }
 
 ImportanceSampler::ImportanceSampler(const std::vector<PokerRange>& ranges, const std::vector<uint8_t>& dead_cards) 
@@ -154,7 +166,7 @@ Board sample_board(const std::vector<uint8_t>& init_board, const uint64_t mask)
   int board_idx = init_board.size();
   uint64_t init_mask = mask;
   while(board_idx < 5) {
-    const uint8_t next_card = gsl_rng_uniform_int(GSLGlobalRNG::instance(), MAX_CARDS); // TODO: use Random.h fast uniform int
+    const uint8_t next_card = FastRNG::uniform_int(MAX_CARDS);
     if(const uint64_t curr_mask = card_mask(next_card); !(init_mask & curr_mask)) {
       board.set_card(board_idx++, next_card);
       init_mask |= curr_mask;
@@ -22,6 +22,8 @@ public:
   explicit SamplingAlgorithm(const std::vector<uint8_t>& dead_cards);
 
   virtual RoundSample sample() = 0;
+  // overwrites the sample, reuses its hand buffer
+  virtual void sample_in_place(RoundSample& sample) { sample = this->sample(); }
 
 protected:
   uint64_t init_mask() const { return _init_mask; }
@@ -36,9 +38,10 @@ public:
       const std::vector<PokerRange>& dead_ranges = {});
 
   RoundSample sample() override;
+  void sample_in_place(RoundSample& sample) override;
 
 private:
-  std::vector<GSLDiscreteDist> _hand_dists;
+  std::vector<DiscreteDist> _hand_dists;
   int _hand_idxs[MAX_PLAYERS]{};
   int _n_players;
 };
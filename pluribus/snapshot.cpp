@@ -0,0 +1,161 @@
+#include <chrono>
+#include <exception>
+#include <istream>
+#include <omp.h>
+#include <ostream>
+#include <string>
+#include <pluribus/logging.hpp>
+#include <pluribus/snapshot.hpp>
+
+namespace pluribus {
+
+uint64_t fnv1a(uint64_t hash, const char* data, const size_t n) {
+  for(size_t i = 0; i < n; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+std::streamsize ChecksumOutBuf::xsputn(const char* s, const std::streamsize n) {
+  const std::streamsize written = _dst->sputn(s, n);
+  _hash = fnv1a(_hash, s, written);
+  _bytes += written;
+  return written;
+}
+
+ChecksumOutBuf::int_type ChecksumOutBuf::overflow(const int_type c) {
+  if(traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+  const char ch = traits_type::to_char_type(c);
+  return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+}
+
+std::streamsize ChecksumInBuf::xsgetn(char* s, const std::streamsize n) {
+  const std::streamsize read = _src->sgetn(s, n);
+  _hash = fnv1a(_hash, s, read);
+  _bytes += read;
+  return read;
+}
+
+ChecksumInBuf::int_type ChecksumInBuf::uflow() {
+  char ch;
+  return xsgetn(&ch, 1) == 1 ? traits_type::to_int_type(ch) : traits_type::eof();
+}
+
+std::filesystem::path manifest_path(const std::filesystem::path& dir) { return dir / "manifest.bin"; }
+std::filesystem::path shard_path(const std::filesystem::path& dir, const int file_idx) { return dir / ("shard_" + std::to_string(file_idx) + ".bin"); }
+
+bool is_sharded_snapshot(const std::string& fn) {
+  return std::filesystem::is_directory(fn) && std::filesystem::exists(manifest_path(fn));
+}
+
+std::filesystem::path create_snapshot_dir(const std::string& dir) {
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+ShardedSnapshotWriter::ShardedSnapshotWriter(const std::string& dir, const int min_shards, const int n_threads)
+    : _dir{create_snapshot_dir(dir)}, _min_shards{min_shards}, _n_threads{n_threads > 0 ? n_threads : omp_get_max_threads()}, _manifest{manifest_path(_dir), std::ios::binary}, _archive{_manifest} {
+  if(!_manifest) Logger::error("Failed to create snapshot manifest in " + dir);
+  Logger::log("Saving sharded snapshot to " + dir);
+  _archive(SHARD_MAGIC, SNAPSHOT_VERSION);
+}
+
+ShardEntry write_shard(std::ofstream& os, const int file_idx, const int shard_idx, const std::function<void(cereal::BinaryOutputArchive&)>& writer) {
+  const auto offset = static_cast<uint64_t>(os.tellp());
+  ShardHeader header{SHARD_MAGIC, SNAPSHOT_VERSION, static_cast<uint32_t>(shard_idx), 0, 0};
+  os.write(reinterpret_cast<const char*>(&header), sizeof(ShardHeader));
+  ChecksumOutBuf buf{os.rdbuf()};
+  {
+    std::ostream checksum_os{&buf};
+    cereal::BinaryOutputArchive ar{checksum_os};
+    writer(ar);
+  }
+  header.bytes = buf.bytes();
+  header.checksum = buf.checksum();
+  os.seekp(offset);
+  os.write(reinterpret_cast<const char*>(&header), sizeof(ShardHeader));
+  os.seekp(0, std::ios::end);
+  if(!os) Logger::error("Failed to write shard " + std::to_string(shard_idx));
+  return ShardEntry{file_idx, offset, header.bytes, header.checksum};
+}
+
+void ShardedSnapshotWriter::write_shards() {
+  const auto t_0 = std::chrono::high_resolution_clock::now();
+  std::vector<ShardEntry> entries(_shards.size());
+  std::vector<std::string> errors;
+  #pragma omp parallel num_threads(_n_threads)
+  {
+    const int file_idx = omp_get_thread_num();
+    std::ofstream os{shard_path(_dir, file_idx), std::ios::binary};
+    #pragma omp for schedule(dynamic, 1)
+    for(int shard_idx = 0; shard_idx < _shards.size(); ++shard_idx) {
+      try {
+        entries[shard_idx] = write_shard(os, file_idx, shard_idx, _shards[shard_idx]);
+      }
+      catch(const std::exception& e) {
+        #pragma omp critical
+        errors.emplace_back(e.what());
+      }
+    }
+  }
+  if(!errors.empty()) Logger::error("Failed to write sharded snapshot: " + errors.front());
+  _archive(entries);
+  _manifest.flush();
+  if(!_manifest) Logger::error("Failed to write snapshot manifest in " + _dir.string());
+  const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t_0).count();
+  Logger::log("Saved " + std::to_string(_shards.size()) + " shards in " + std::to_string(duration) + " ms.");
+}
+
+ShardedSnapshotReader::ShardedSnapshotReader(const std::string& dir) : _dir{dir}, _manifest{manifest_path(_dir), std::ios::binary}, _archive{_manifest} {
+  if(!_manifest) Logger::error("Failed to open snapshot manifest in " + dir);
+  Logger::log("Loading sharded snapshot from " + dir);
+  uint64_t magic;
+  _archive(magic, _version);
+  if(magic != SHARD_MAGIC) Logger::error("Invalid snapshot manifest: " + dir);
+  if(_version < 1 || _version > SNAPSHOT_VERSION) Logger::error("Unsupported snapshot version: " + std::to_string(_version));
+}
+
+void read_shard(const std::filesystem::path& dir, const uint32_t version, const int shard_idx, const ShardEntry& entry,
+    const std::function<void(cereal::BinaryInputArchive&)>& reader) {
+  std::ifstream is{shard_path(dir, entry.file_idx), std::ios::binary};
+  is.seekg(entry.offset);
+  ShardHeader header{};
+  is.read(reinterpret_cast<char*>(&header), sizeof(ShardHeader));
+  if(!is || header.magic != SHARD_MAGIC || header.version != version || header.shard_idx != shard_idx) {
+    Logger::error("Invalid header of shard " + std::to_string(shard_idx));
+  }
+  if(header.bytes != entry.bytes || header.checksum != entry.checksum) Logger::error("Shard " + std::to_string(shard_idx) + " does not match the manifest.");
+  ChecksumInBuf buf{is.rdbuf()};
+  {
+    std::istream checksum_is{&buf};
+    cereal::BinaryInputArchive ar{checksum_is};
+    reader(ar);
+  }
+  if(buf.bytes() != header.bytes || buf.checksum() != header.checksum) Logger::error("Checksum mismatch in shard " + std::to_string(shard_idx));
+}
+
+void ShardedSnapshotReader::read_shards() {
+  const auto t_0 = std::chrono::high_resolution_clock::now();
+  std::vector<ShardEntry> entries;
+  _archive(entries);
+  if(entries.size() != _shards.size()) {
+    Logger::error("Shard count mismatch. Manifest=" + std::to_string(entries.size()) + ", Trees=" + std::to_string(_shards.size()));
+  }
+  std::vector<std::string> errors;
+  #pragma omp parallel for schedule(dynamic, 1)
+  for(int shard_idx = 0; shard_idx < _shards.size(); ++shard_idx) {
+    try {
+      read_shard(_dir, _version, shard_idx, entries[shard_idx], _shards[shard_idx]);
+    }
+    catch(const std::exception& e) {
+      #pragma omp critical
+      errors.emplace_back(e.what());
+    }
+  }
+  if(!errors.empty()) Logger::error("Failed to load sharded snapshot: " + errors.front());
+  const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t_0).count();
+  Logger::log("Loaded " + std::to_string(_shards.size()) + " shards in " + std::to_string(duration) + " ms.");
+}
+
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/memory.hpp>
+#include <cereal/types/vector.hpp>
+#include <pluribus/tree_storage.hpp>
+
+namespace pluribus {
+
+// Sharded snapshot layout: a directory holding manifest.bin and one shard_<k>.bin file per writer thread.
+// The manifest holds the caller's state, the top levels of each tree and the shard table. Subtrees at the shard depth are written to the shard
+// files in parallel, each shard is prefixed by a ShardHeader and carries a checksum of its payload.
+constexpr uint64_t SHARD_MAGIC = 0x4452485342554c50ULL; // "PLUBSHRD"
+constexpr uint32_t SNAPSHOT_VERSION = 3; // 2: prune records and baselines of regret trees, 3: regret precision
+constexpr int MAX_SHARD_DEPTH = 4;
+
+struct ShardHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t shard_idx;
+  uint64_t bytes;
+  uint64_t checksum;
+};
+
+struct ShardEntry {
+  int file_idx;
+  uint64_t offset;
+  uint64_t bytes;
+  uint64_t checksum;
+
+  template <class Archive>
+  void serialize(Archive& ar) {
+    ar(file_idx, offset, bytes, checksum);
+  }
+};
+
+uint64_t fnv1a(uint64_t hash, const char* data, size_t n);
+constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+
+// Forwards to another stream buffer and checksums everything that passes through.
+class ChecksumOutBuf : public std::streambuf {
+public:
+  explicit ChecksumOutBuf(std::streambuf* dst) : _dst{dst} {}
+  uint64_t checksum() const { return _hash; }
+  uint64_t bytes() const { return _bytes; }
+
+protected:
+  std::streamsize xsputn(const char* s, std::streamsize n) override;
+  int_type overflow(int_type c) override;
+
+private:
+  std::streambuf* _dst;
+  uint64_t _hash = FNV_OFFSET;
+  uint64_t _bytes = 0;
+};
+
+class ChecksumInBuf : public std::streambuf {
+public:
+  explicit ChecksumInBuf(std::streambuf* src) : _src{src} {}
+  uint64_t checksum() const { return _hash; }
+  uint64_t bytes() const { return _bytes; }
+
+protected:
+  std::streamsize xsgetn(char* s, std::streamsize n) override;
+  int_type underflow() override { return _src->sgetc(); }
+  int_type uflow() override;
+
+private:
+  std::streambuf* _src;
+  uint64_t _hash = FNV_OFFSET;
+  uint64_t _bytes = 0;
+};
+
+bool is_sharded_snapshot(const std::string& fn);
+
+template <class T>
+long count_nodes_at_depth(const TreeStorageNode<T>* node, const int depth) {
+  if(depth == 0) return 1;
+  long count = 0;
+  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
+    if(node->is_allocated(a_idx)) count += count_nodes_at_depth(node->apply_index(a_idx), depth - 1);
+  }
+  return count;
+}
+
+// shallowest depth with at least min_shards subtrees
+template <class T>
+int shard_depth(const TreeStorageNode<T>& root, const int min_shards) {
+  for(int depth = 1; depth < MAX_SHARD_DEPTH; ++depth) {
+    if(count_nodes_at_depth(&root, depth) >= min_shards) return depth;
+  }
+  return MAX_SHARD_DEPTH;
+}
+
+class ShardedSnapshotWriter {
+public:
+  // n_threads = 0 writes with all OpenMP threads
+  ShardedSnapshotWriter(const std::string& dir, int min_shards, int n_threads = 0);
+
+  cereal::BinaryOutputArchive& archive() { return _archive; }
+
+  template <class T>
+  void add_tree(const TreeStorageNode<T>& root) {
+    std::vector<const TreeStorageNode<T>*> shards;
+    root.save_prefix(_archive, shard_depth(root, _min_shards), shards);
+    for(const TreeStorageNode<T>* shard : shards) {
+      _shards.emplace_back([shard](cereal::BinaryOutputArchive& ar) { shard->save_shard(ar); });
+    }
+  }
+
+  // Writes all shards in parallel, followed by the shard table. Must be called last. Tree values are read with relaxed loads, so a tree can be
+  // written while it is being trained. Nodes added to a shard while it is written may or may not be part of the snapshot.
+  void write_shards();
+
+private:
+  std::filesystem::path _dir;
+  int _min_shards;
+  int _n_threads;
+  std::ofstream _manifest;
+  cereal::BinaryOutputArchive _archive;
+  std::vector<std::function<void(cereal::BinaryOutputArchive&)>> _shards;
+};
+
+class ShardedSnapshotReader {
+public:
+  explicit ShardedSnapshotReader(const std::string& dir);
+
+  cereal::BinaryInputArchive& archive() { return _archive; }
+
+  template <class T>
+  void add_tree(TreeStorageNode<T>& root) {
+    std::vector<std::pair<TreeStorageNode<T>*, int>> slots;
+    root.load_prefix(_archive, slots, _version);
+    for(const auto& [node, action_idx] : slots) {
+      _shards.emplace_back([node, action_idx](cereal::BinaryInputArchive& ar) { node->load_shard(ar, action_idx); });
+    }
+  }
+
+  // reads and verifies all shards in parallel. Must be called last.
+  void read_shards();
+
+private:
+  std::filesystem::path _dir;
+  std::ifstream _manifest;
+  cereal::BinaryInputArchive _archive;
+  uint32_t _version = SNAPSHOT_VERSION;
+  std::vector<std::function<void(cereal::BinaryInputArchive&)>> _shards;
+};
+
+}
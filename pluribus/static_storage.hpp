@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cereal/access.hpp>
+#include <cereal/types/memory.hpp>
+#include <omp.h>
+#include <pluribus/actions.hpp>
+#include <pluribus/logging.hpp>
+#include <pluribus/poker.hpp>
+#include <pluribus/regret_row.hpp>
+#include <pluribus/tree_storage.hpp>
+
+namespace pluribus {
+
+template <class T>
+class StaticTree;
+
+// Node of a StaticTree. The children of a node are stored next to each other in the node array, so the child of action a_idx has the id
+// first_child + a_idx. Children that are terminal or past the last round of the tree are empty placeholders. Values are a block of the tree's
+// value array, which is written through relaxed atomics like TreeStorageNode values.
+template <class T>
+class StaticTreeNode {
+public:
+  StaticTreeNode() = default;
+
+  StaticTreeNode* apply_index(const int action_idx) { return const_cast<StaticTreeNode*>(std::as_const(*this).apply_index(action_idx)); }
+  const StaticTreeNode* apply_index(const int action_idx) const {
+    const StaticTreeNode* child = _tree->node(_first_child + action_idx);
+    if(!child->is_stored()) Logger::error("StaticTreeNode is not allocated. Index=" + std::to_string(action_idx));
+    return child;
+  }
+
+  const StaticTreeNode* apply(const Action a) const { return apply_index(_compute_action_index(a, get_branching_actions())); }
+
+  const StaticTreeNode* apply(const std::vector<Action>& actions) const {
+    const StaticTreeNode* node = this;
+    for(const Action a : actions) {
+      node = node->apply(a);
+    }
+    return node;
+  }
+
+  bool is_allocated(const int action_idx) const { return _tree->node(_first_child + action_idx)->is_stored(); }
+  bool is_allocated(const Action a) const { return is_allocated(_compute_action_index(a, get_branching_actions())); }
+
+  std::atomic<T>* get(const int cluster, const int action_idx = 0) { return get_by_index(node_value_index(_n_value_actions, cluster, action_idx)); }
+  const std::atomic<T>* get(const int cluster, const int action_idx = 0) const {
+    return get_by_index(node_value_index(_n_value_actions, cluster, action_idx));
+  }
+  std::atomic<T>* get_by_index(const int index) { return _tree->values() + _value_offset + index; }
+  const std::atomic<T>* get_by_index(const int index) const { return std::as_const(*_tree).values() + _value_offset + index; }
+
+  RegretRow get_regret_row(const int cluster) requires std::is_same_v<T, int> { return RegretRow{get(cluster)}; }
+  const std::atomic<T>* get_row(const int cluster) const { return get(cluster); }
+  T load_by_index(const int index) const { return get_by_index(index)->load(std::memory_order_relaxed); }
+  T load(const int cluster, const int action_idx) const { return load_by_index(node_value_index(_n_value_actions, cluster, action_idx)); }
+
+  const std::vector<Action>& get_branching_actions() const { return ActionSetPool::get_instance()->get(_branching_id); }
+  const std::vector<Action>& get_value_actions() const { return ActionSetPool::get_instance()->get(_value_id); }
+  int get_n_clusters() const { return _n_clusters; }
+  int get_n_values() const { return _n_value_actions * _n_clusters; }
+  uint32_t get_id() const { return static_cast<uint32_t>(this - _tree->node(0)); }
+
+  // discounts the whole tree, only valid at the root
+  void lcfr_discount(const double d) {
+    if(get_id() != 0) Logger::error("StaticTreeNode::lcfr_discount is only valid at the root.");
+    _tree->lcfr_discount(d);
+  }
+
+private:
+  friend class StaticTree<T>;
+
+  bool is_stored() const { return _n_clusters > 0; }
+
+  StaticTree<T>* _tree = nullptr;
+  uint64_t _value_offset = 0;
+  uint32_t _first_child = 0;
+  ActionSetPool::Id _branching_id = 0;
+  ActionSetPool::Id _value_id = 0;
+  uint16_t _n_clusters = 0;
+  uint8_t _n_value_actions = 0;
+};
+
+// Game tree of a fixed action profile, enumerated once into a node array (pre-order, children blocks) and a value array. Training on a static
+// tree never allocates or locks, whole tree operations are linear scans over the value array. Nodes in rounds past max_round are not stored,
+// e.g. max_round=0 for preflop only average strategies. Only blueprint action modes are supported, real time trees end in bias nodes. Regrets
+// are always stored with 32 bits, configs with RegretPrecision::INT16 are rejected.
+template <class T>
+class StaticTree {
+public:
+  static_assert(sizeof(std::atomic<T>) == sizeof(T) && std::atomic<T>::is_always_lock_free, "Static tree values must be lock free atomics.");
+
+  StaticTree(const SlimPokerState& root_state, const std::shared_ptr<const TreeStorageConfig>& config, const int max_round = 3)
+      : _root_state{root_state}, _config{config}, _max_round{max_round} {
+    if(config->regret_precision != RegretPrecision::INT32) Logger::error("Static trees only support 32 bit regrets.");
+    build();
+  }
+
+  StaticTree(const StaticTree&) = delete;
+  StaticTree& operator=(const StaticTree&) = delete;
+
+  StaticTreeNode<T>* root() { return &_nodes[0]; }
+  const StaticTreeNode<T>* root() const { return &_nodes[0]; }
+  StaticTreeNode<T>* node(const size_t id) { return &_nodes[id]; }
+  const StaticTreeNode<T>* node(const size_t id) const { return &_nodes[id]; }
+  std::atomic<T>* values() { return _values.get(); }
+  const std::atomic<T>* values() const { return _values.get(); }
+
+  const std::shared_ptr<const TreeStorageConfig>& get_config() const { return _config; }
+  int get_max_round() const { return _max_round; }
+  size_t n_nodes() const { return _n_nodes; }
+  size_t n_values() const { return _n_values; }
+  size_t bytes() const { return _nodes.size() * sizeof(StaticTreeNode<T>) + _n_values * sizeof(std::atomic<T>); }
+
+  // calls f for every stored node, in parallel
+  template <class F>
+  void for_each_node(F&& f) const {
+    #pragma omp parallel for schedule(static)
+    for(size_t id = 0; id < _nodes.size(); ++id) {
+      if(_nodes[id].is_stored()) f(_nodes[id]);
+    }
+  }
+
+  void lcfr_discount(const double d) {
+    #pragma omp parallel for schedule(static)
+    for(size_t i = 0; i < _n_values; ++i) {
+      _values[i].store(static_cast<T>(_values[i].load(std::memory_order_relaxed) * d), std::memory_order_relaxed);
+    }
+  }
+
+  bool operator==(const StaticTree& other) const {
+    if(_root_state != other._root_state || *_config != *other._config || _max_round != other._max_round || _n_values != other._n_values) return false;
+    for(size_t i = 0; i < _n_values; ++i) {
+      if(_values[i].load(std::memory_order_relaxed) != other._values[i].load(std::memory_order_relaxed)) return false;
+    }
+    return true;
+  }
+
+  template <class Archive>
+  void save(Archive& ar) const {
+    ar(_root_state, *_config, _max_round, static_cast<uint64_t>(_n_values));
+    ar(cereal::binary_data(_values.get(), _n_values * sizeof(T)));
+  }
+
+  template <class Archive>
+  void load(Archive& ar) {
+    TreeStorageConfig config;
+    uint64_t n_values;
+    ar(_root_state, config, _max_round, n_values);
+    _config = std::make_shared<const TreeStorageConfig>(config);
+    build();
+    if(n_values != _n_values) Logger::error("Static tree size mismatch. Snapshot=" + std::to_string(n_values) + ", Tree=" + std::to_string(_n_values));
+    ar(cereal::binary_data(_values.get(), _n_values * sizeof(T)));
+  }
+
+private:
+  friend class cereal::access;
+
+  StaticTree() = default;
+
+  void build() {
+    _nodes.clear();
+    _n_nodes = 0;
+    _n_values = 0;
+    _nodes.emplace_back();
+    init_node(0, _root_state);
+    build_children(0, _root_state);
+    if(_nodes.size() > std::numeric_limits<uint32_t>::max()) Logger::error("Static tree has too many nodes: " + std::to_string(_nodes.size()));
+    _values = std::make_unique<std::atomic<T>[]>(_n_values);
+  }
+
+  void init_node(const size_t id, const SlimPokerState& state) {
+    StaticTreeNode<T>& node = _nodes[id];
+    node._tree = this;
+    node._branching_id = _config->action_mode.branching_id(state);
+    node._value_id = _config->action_mode.value_id(state);
+    node._n_clusters = _config->cluster_spec.n_clusters(state.get_round());
+    node._n_value_actions = node.get_value_actions().size();
+    node._value_offset = _n_values;
+    _n_values += node.get_n_values();
+    ++_n_nodes;
+  }
+
+  void build_children(const size_t id, const SlimPokerState& state) {
+    const std::vector<Action>& actions = _nodes[id].get_branching_actions();
+    const size_t first_child = _nodes.size();
+    _nodes[id]._first_child = static_cast<uint32_t>(first_child);
+    _nodes.resize(first_child + actions.size());
+    std::vector<SlimPokerState> next_states;
+    next_states.reserve(actions.size());
+    for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
+      next_states.push_back(state.apply_copy(actions[a_idx]));
+      if(!next_states[a_idx].is_terminal() && next_states[a_idx].get_round() <= _max_round) init_node(first_child + a_idx, next_states[a_idx]);
+    }
+    for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
+      if(_nodes[first_child + a_idx].is_stored()) build_children(first_child + a_idx, next_states[a_idx]);
+    }
+  }
+
+  SlimPokerState _root_state;
+  std::shared_ptr<const TreeStorageConfig> _config;
+  int _max_round = 3;
+  std::vector<StaticTreeNode<T>> _nodes;
+  std::unique_ptr<std::atomic<T>[]> _values;
+  size_t _n_nodes = 0;
+  size_t _n_values = 0;
+};
+
+}
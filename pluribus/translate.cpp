@@ -36,7 +36,7 @@ TranslationResult pseudo_harmonic_result(const Action a, const std::vector<Actio
 }
 
 Action sample(const TranslationResult& result) {
-  return GSLGlobalRNG::uniform() < result.p_A ? result.A : result.B;
+  return FastRNG::uniform() < result.p_A ? result.A : result.B;
 }
 
 Action translate_pseudo_harmonic(const Action a, const std::vector<Action>& actions, const SlimPokerState& state) {
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <unordered_map>
 #include <vector>
+#include <pluribus/blueprint.hpp>
 #include <pluribus/mccfr.hpp>
 #include <pluribus/poker.hpp>
 #include <pluribus/range.hpp>
@@ -10,8 +11,14 @@
 
 namespace pluribus {
 
-template <class T>
-void traverse(RangeViewer* viewer_p, const DecisionAlgorithm& decision, const TreeStorageNode<T>* root, const SolverConfig& config) {
+// action sets of flat nodes are spans into the mapped file
+template <class NodeT>
+std::vector<Action> value_actions(const NodeT* node) {
+  return {node->get_value_actions().begin(), node->get_value_actions().end()};
+}
+
+template <class NodeT>
+void traverse(RangeViewer* viewer_p, const DecisionAlgorithm& decision, const NodeT* root, const SolverConfig& config) {
   std::string input;
   std::cout << "Board cards: ";
   auto board_cards = config.init_board;
@@ -28,10 +35,10 @@ void traverse(RangeViewer* viewer_p, const DecisionAlgorithm& decision, const Tr
   std::cout << "Board: " << board.to_string() << "\n";
 
   PokerState state = config.init_state;
-  const TreeStorageNode<T>* node = root;
+  const NodeT* node = root;
   std::vector<PokerRange> ranges = config.init_ranges;
   for(int i = 0; i < config.poker.n_players; ++i) ranges.push_back(PokerRange::full());
-  auto action_ranges = build_renderable_ranges(decision, node->get_value_actions(), state, board, ranges[state.get_active()]);
+  auto action_ranges = build_renderable_ranges(decision, value_actions(node), state, board, ranges[state.get_active()]);
   render_ranges(viewer_p, ranges[state.get_active()], action_ranges);
 
   std::cout << state.to_string();
@@ -62,7 +69,7 @@ void traverse(RangeViewer* viewer_p, const DecisionAlgorithm& decision, const Tr
       node = root;
     }
 
-    action_ranges = build_renderable_ranges(decision, node->get_value_actions(), state, board, ranges[state.get_active()]);
+    action_ranges = build_renderable_ranges(decision, value_actions(node), state, board, ranges[state.get_active()]);
     render_ranges(viewer_p, ranges[state.get_active()], action_ranges);
     std::cout << state.to_string();
     std::cout << "\nAction: ";
@@ -72,7 +79,7 @@ void traverse(RangeViewer* viewer_p, const DecisionAlgorithm& decision, const Tr
 void traverse_tree(RangeViewer* viewer_p, const std::string& bp_fn) {
   std::cout << "Loading tree blueprint solver from " << bp_fn << " for traversal... " << std::flush;
   TreeBlueprintSolver bp;
-  cereal_load(bp, bp_fn);
+  bp.load_snapshot(bp_fn);
   std::cout << "Success.\n";
   traverse(viewer_p, TreeDecision{bp.get_strategy(), bp.get_config().init_state, false}, bp.get_strategy(), bp.get_config());
 }
@@ -85,6 +92,13 @@ void traverse_blueprint(RangeViewer* viewer_p, const std::string& bp_fn) {
   traverse(viewer_p, TreeDecision{bp.get_strategy(), bp.get_config().init_state, false}, bp.get_strategy(), bp.get_config());
 }
 
+void traverse_flat_blueprint(RangeViewer* viewer_p, const std::string& bp_fn) {
+  std::cout << "Mapping flat blueprint " << bp_fn << " for traversal... " << std::flush;
+  const MappedLosslessBlueprint bp{bp_fn};
+  std::cout << "Success.\n";
+  traverse(viewer_p, TreeDecision{bp.get_strategy(), bp.get_config().init_state, false}, bp.get_strategy(), bp.get_config());
+}
+
 Action str_to_action(const std::string& str) {
   if(str.starts_with("check") || str.starts_with("call")) return Action::CHECK_CALL;
   if(str.starts_with("fold")) return Action::FOLD;
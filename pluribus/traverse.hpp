@@ -15,6 +15,7 @@ namespace pluribus {
 void traverse_trainer(RangeViewer* viewer_p, const std::string& bp_fn);
 void traverse_tree(RangeViewer* viewer_p, const std::string& bp_fn);
 void traverse_blueprint(RangeViewer* viewer_p, const std::string& bp_fn);
+void traverse_flat_blueprint(RangeViewer* viewer_p, const std::string& bp_fn);
 Action str_to_action(const std::string& str);
 void render_ranges(RangeViewer* viewer_p, const PokerRange& base_range, const std::unordered_map<Action, RenderableRange>& action_ranges);
 PokerRange build_action_range(const PokerRange& base_range, const Action& a, const PokerState& state, const Board& board,
@@ -1,17 +1,96 @@
 #pragma once
 
 #include <atomic>
+#include <cstring>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <pluribus/actions.hpp>
-#include <pluribus/concurrency.hpp>
+#include <pluribus/arena.hpp>
 #include <pluribus/config.hpp>
 #include <pluribus/logging.hpp>
 #include <pluribus/poker.hpp>
+#include <pluribus/regret_row.hpp>
+#include <pluribus/tree_visitor.hpp>
 #include <pluribus/util.hpp>
 
 namespace pluribus {
 
+// Process-wide pool of the distinct action sets used by storage trees. Nodes only store the id of their action sets.
+// Sets are never removed, so ids and references returned by get remain valid for the lifetime of the process.
+class ActionSetPool {
+public:
+  using Id = uint16_t;
+
+  static ActionSetPool* get_instance() {
+    static ActionSetPool instance;
+    return &instance;
+  }
+
+  Id intern(const std::vector<Action>& actions) {
+    const ActionHistory key{actions};
+    {
+      std::shared_lock lock(_mtx);
+      if(const auto it = _ids.find(key); it != _ids.end()) return it->second;
+    }
+    std::unique_lock lock(_mtx);
+    if(const auto it = _ids.find(key); it != _ids.end()) return it->second;
+    if(_sets.size() == MAX_SETS) Logger::error("Action set pool is full. Size=" + std::to_string(_sets.size()));
+    const Id id = _sets.size();
+    _sets.push_back(std::make_unique<const std::vector<Action>>(actions));
+    _ids[key] = id;
+    return id;
+  }
+
+  // lock free, the set storage is reserved up front and never reallocates
+  const std::vector<Action>& get(const Id id) const { return *_sets[id]; }
+
+  size_t size() const {
+    std::shared_lock lock(_mtx);
+    return _sets.size();
+  }
+
+  ActionSetPool(const ActionSetPool&) = delete;
+  ActionSetPool& operator=(const ActionSetPool&) = delete;
+
+private:
+  static constexpr size_t MAX_SETS = 1UL << 16;
+
+  ActionSetPool() {
+    _sets.reserve(MAX_SETS);
+    intern({}); // id 0 is the empty set of default constructed nodes
+  }
+
+  std::vector<std::unique_ptr<const std::vector<Action>>> _sets;
+  std::unordered_map<ActionHistory, Id> _ids;
+  mutable std::shared_mutex _mtx;
+};
+
+// Interned action sets of the profile entries of an ActionMode, keyed by the entry and the mask of its valid actions. Growing a tree only computes
+// the mask of a state instead of building and hashing action vectors.
+class ActionSetCache {
+public:
+  template <class F>
+  ActionSetPool::Id get(const uint64_t key, F&& make_actions) {
+    {
+      std::shared_lock lock(_mtx);
+      if(const auto it = _ids.find(key); it != _ids.end()) return it->second;
+    }
+    const ActionSetPool::Id id = ActionSetPool::get_instance()->intern(make_actions());
+    std::unique_lock lock(_mtx);
+    _ids.emplace(key, id);
+    return id;
+  }
+
+private:
+  std::unordered_map<uint64_t, ActionSetPool::Id> _ids;
+  mutable std::shared_mutex _mtx;
+};
+
 inline std::vector<Action> real_time_actions(const SlimPokerState& state, const ActionProfile& profile, const RealTimeSolverConfig& rt_config,
     const bool branching) {
   if(rt_config.is_state_terminal(state)) {
@@ -38,26 +117,52 @@ public:
   //       For bias sampling, branching actions must be a single action, Action::BIAS_DUMMY, to make each player's choice of bias private information.
   //       (i.e. players cannot choose their bias strategy based on knowledge of the biases chosen by previous players)
   //       In a sampled blueprint, value actions are the biases, values are the sampled action, and branching actions are the actions mapping the game tree.
-  std::vector<Action> branching_actions(const SlimPokerState& state) const { return get_actions(state, true); }
-  std::vector<Action> value_actions(const SlimPokerState& state) const { return get_actions(state, false); }
+  const std::vector<Action>& branching_actions(const SlimPokerState& state) const { return ActionSetPool::get_instance()->get(branching_id(state)); }
+  const std::vector<Action>& value_actions(const SlimPokerState& state) const { return ActionSetPool::get_instance()->get(value_id(state)); }
+  ActionSetPool::Id branching_id(const SlimPokerState& state) const { return get_id(state, true); }
+  ActionSetPool::Id value_id(const SlimPokerState& state) const { return get_id(state, false); }
+
+  // the cache is derived from the other members and shared between copies
+  bool operator==(const ActionMode& other) const {
+    return _rt_config == other._rt_config && _biases == other._biases && _profile == other._profile && _mode == other._mode;
+  }
 
-  bool operator==(const ActionMode& other) const = default;
+  template <class Archive>
+  void save(Archive& ar) const {
+    ar(_rt_config, _biases, _profile, _mode);
+  }
 
   template <class Archive>
-  void serialize(Archive& ar) {
+  void load(Archive& ar) {
     ar(_rt_config, _biases, _profile, _mode);
+    _cache = std::make_shared<ActionSetCache>();
   }
 
 private:
-  std::vector<Action> get_actions(const SlimPokerState& state, const bool branching) const {
+  // cache keys: source of the actions in the top byte, profile entry in the middle, mask of valid actions in the low 16 bits
+  enum KeySource : uint64_t { VALID_ACTIONS = 0, BIAS_PROFILE = 1, BIAS_DUMMY = 2, SAMPLED_BIASES = 3 };
+
+  ActionSetPool::Id get_id(const SlimPokerState& state, const bool branching) const {
     switch(_mode) {
-      case 0: return valid_actions(state, _profile);
-      case 1: return real_time_actions(state, _profile, _rt_config, branching);
-      case 2: return branching ? valid_actions(state, _profile) : _biases;
+      case 0: return valid_actions_id(state);
+      case 1: {
+        if(!_rt_config.is_state_terminal(state)) return valid_actions_id(state);
+        if(branching) return _cache->get(static_cast<uint64_t>(BIAS_DUMMY) << 56, [] { return std::vector{Action::BIAS_DUMMY}; });
+        const ActionProfile& bias_profile = _rt_config.bias_profile;
+        return _cache->get(static_cast<uint64_t>(BIAS_PROFILE) << 56 | static_cast<uint64_t>(bias_profile.get_actions_key(state)) << 16,
+            [&] { return bias_profile.get_actions(state); });
+      }
+      case 2: return branching ? valid_actions_id(state) : _cache->get(static_cast<uint64_t>(SAMPLED_BIASES) << 56, [&] { return _biases; });
       default: Logger::error("Unknown action mode: " + std::to_string(_mode));
     }
   }
 
+  ActionSetPool::Id valid_actions_id(const SlimPokerState& state) const {
+    const std::vector<Action>& actions = _profile.get_actions(state);
+    const uint16_t mask = valid_action_mask(state, actions);
+    return _cache->get(static_cast<uint64_t>(_profile.get_actions_key(state)) << 16 | mask, [&] { return masked_actions(actions, mask); });
+  }
+
   ActionMode(const int mode, const ActionProfile& profile,  const RealTimeSolverConfig& rt_config, const std::vector<Action>& biases)
     : _rt_config{rt_config}, _biases{biases}, _profile{profile}, _mode{mode} {}
 
@@ -74,6 +179,7 @@ private:
   std::vector<Action> _biases;
   ActionProfile _profile;
   int _mode;
+  std::shared_ptr<ActionSetCache> _cache = std::make_shared<ActionSetCache>();
 };
 
 class ClusterSpec {
@@ -97,8 +203,17 @@ private:
 struct TreeStorageConfig {
   ClusterSpec cluster_spec;
   ActionMode action_mode;
-
-  bool operator==(const TreeStorageConfig& other) const = default;
+  // The storage layout fields below only apply to regret trees (TreeStorageNode<int>). They are not part of serialize, sharded snapshots persist
+  // them with the tree and single file archives load as plain 32 bit trees.
+  // Regrets are always written as full 32 bit values and requantized on load.
+  RegretPrecision regret_precision = RegretPrecision::INT32;
+  // Keeps a PruneRecord per value.
+  bool prune_records = false;
+  // Keeps a float baseline per value for variance reduced MCCFR.
+  bool baselines = false;
+
+  // compares the serialized fields, so a config equals itself after a round trip through an archive
+  bool operator==(const TreeStorageConfig& other) const { return cluster_spec == other.cluster_spec && action_mode == other.action_mode; }
 
   template <class Archive>
   void serialize(Archive& ar) {
@@ -116,25 +231,77 @@ inline int node_value_index(const int n_actions, const int cluster, const int ac
   return n_actions * cluster + action_idx;
 }
 
+// LCFR discounts applied to a tree. Discounting only appends to the log, each node records the epoch it was last normalized at and applies the
+// product of the pending discounts on its next mutable access (see TreeStorageNode::sync_discount). Discounts must not be pushed concurrently
+// with traversals, concurrent readers are fine.
+class DiscountLog {
+public:
+  static constexpr int MAX_EPOCHS = (1 << 15) - 1;
+
+  int epoch() const { return _epoch.load(std::memory_order_acquire); }
+
+  // product of the discounts after from_epoch
+  double factor(const int from_epoch) const { return _products[epoch()] / _products[from_epoch]; }
+
+  void push(const double d) {
+    const int curr = epoch();
+    if(curr == MAX_EPOCHS) Logger::error("Discount log is full. Epochs=" + std::to_string(curr));
+    if(!_products) {
+      _products = std::make_unique<double[]>(MAX_EPOCHS + 1);
+      _products[0] = 1.0;
+    }
+    _products[curr + 1] = _products[curr] * d;
+    _epoch.store(curr + 1, std::memory_order_release);
+  }
+
+private:
+  std::unique_ptr<double[]> _products;
+  std::atomic<int> _epoch = 0;
+};
+
+// State shared by all nodes of a tree, owned by the root.
+struct TreeShared {
+  TreeArena arena;
+  DiscountLog discounts;
+};
+
+// Node order of a compacted tree
+enum class TreeLayout : uint8_t {
+  DFS, // preorder, every subtree is contiguous
+  VEB  // van Emde Boas, the tree is split at half its height recursively so that root to leaf walks touch O(log_B n) cache lines
+};
+
+// Tree nodes are allocated from a TreeArena owned by the root. A node is a single block holding the node itself, followed by the child pointers
+// and the values. Nodes are never freed individually, pruned subtrees are destructed but their memory is only released with the root.
+// Children are installed with a compare-and-swap, a thread that loses the race returns its node to the arena.
+// Regret trees configured with RegretPrecision::INT16 store 16 bit regrets followed by one scale per cluster instead of std::atomic<int> values.
+// Their values must be accessed through get_regret_row/get_row/load, get and get_by_index are only valid for full precision trees.
+// Regret trees configured with prune_records or baselines store one PruneRecord and/or one baseline per value after the values.
 template <class T>
 class TreeStorageNode {
 public:
-  TreeStorageNode(const SlimPokerState& state, const std::shared_ptr<const TreeStorageConfig>& config) : TreeStorageNode{state, config, true} {}
+  TreeStorageNode(const SlimPokerState& state, const std::shared_ptr<const TreeStorageConfig>& config)
+      : TreeStorageNode{config->action_mode.branching_id(state),
+                        config->action_mode.value_id(state),
+                        config->cluster_spec.n_clusters(state.get_round()), config, new TreeShared(), nullptr, true} {}
   TreeStorageNode(): _n_clusters(0), _is_root{true} {}
 
   ~TreeStorageNode() {
     free_memory();
+    if(_is_root) delete _shared;
   }
 
   TreeStorageNode* apply_index(int action_idx, const SlimPokerState& next_state) {
     auto& node_atom = _nodes[action_idx];
     TreeStorageNode* next = node_atom.load(std::memory_order_acquire);
     if(!next) {
-      std::lock_guard lock(_locks[action_idx]);
-      next = node_atom.load(std::memory_order_acquire);
-      if(!next) {
-        next = new TreeStorageNode(next_state, _config, false);
-        node_atom.store(next, std::memory_order_release);
+      TreeStorageNode* child = make_child(_config->action_mode.branching_id(next_state), _config->action_mode.value_id(next_state),
+          _config->cluster_spec.n_clusters(next_state.get_round()));
+      if(node_atom.compare_exchange_strong(next, child, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        next = child;
+      }
+      else {
+        discard_child(child); // another thread installed the child first
       }
     }
     return next;
@@ -145,9 +312,10 @@ public:
     if(!next) Logger::error("TreeStorageNode is not allocated. Index=" + std::to_string(action_idx));
     return next;
   }
+  TreeStorageNode* apply_index(const int action_idx) { return const_cast<TreeStorageNode*>(std::as_const(*this).apply_index(action_idx)); }
 
-  TreeStorageNode* apply(const Action a, const SlimPokerState& next_state) { return apply_index(_compute_action_index(a, _branching_actions), next_state); }
-  const TreeStorageNode* apply(const Action a) const { return apply_index(_compute_action_index(a, _branching_actions)); }
+  TreeStorageNode* apply(const Action a, const SlimPokerState& next_state) { return apply_index(_compute_action_index(a, get_branching_actions()), next_state); }
+  const TreeStorageNode* apply(const Action a) const { return apply_index(_compute_action_index(a, get_branching_actions())); }
 
   const TreeStorageNode* apply(const std::vector<Action>& actions) const {
     const TreeStorageNode* node = this;
@@ -157,105 +325,165 @@ public:
     return node;
   }
 
-  std::atomic<T>* get(const int cluster, const int action_idx = 0) { return &_values[node_value_index(_value_actions.size(), cluster, action_idx)]; }
-  const std::atomic<T>* get(const int cluster, const int action_idx = 0) const { return &_values[node_value_index(_value_actions.size(), cluster, action_idx)]; }
+  // Mutable accessors apply pending discounts first. Const pointers and rows see the values as of the node's last normalization, which is
+  // enough for strategies (discounts scale all values of a node equally), load and load_by_index include pending discounts.
+  std::atomic<T>* get(const int cluster, const int action_idx = 0) {
+    sync_discount();
+    return &_values[node_value_index(_n_value_actions, cluster, action_idx)];
+  }
+  const std::atomic<T>* get(const int cluster, const int action_idx = 0) const { return &_values[node_value_index(_n_value_actions, cluster, action_idx)]; }
 
   const std::atomic<T>* get_by_index(const int index) const { return &_values[index]; }
-  std::atomic<T>* get_by_index(const int index) { return &_values[index]; }
+  std::atomic<T>* get_by_index(const int index) {
+    sync_discount();
+    return &_values[index];
+  }
+
+  RegretRow get_regret_row(const int cluster) requires std::is_same_v<T, int> {
+    sync_discount();
+    return raw_regret_row(cluster);
+  }
+  RegretRow get_regret_row(const int cluster) const requires std::is_same_v<T, int> { return raw_regret_row(cluster); }
+
+  // values of a single cluster, for calculate_strategy
+  auto get_row(const int cluster) const {
+    if constexpr(std::is_same_v<T, int>) return get_regret_row(cluster);
+    else return get(cluster);
+  }
+
+  // Reads the stamp like a seqlock: a sync_discount that overlaps the value load changes the stamp and the load is retried, otherwise the
+  // discount it applies would be applied a second time.
+  T load_by_index(const int index) const {
+    while(true) {
+      const uint16_t stamp = stable_epoch();
+      const double d = pending_discount(stamp);
+      T val;
+      if constexpr(std::is_same_v<T, int>) {
+        val = _quantized ? raw_regret_row(index / _n_value_actions).load(index % _n_value_actions) : _values[index].load(std::memory_order_relaxed);
+      }
+      else {
+        val = _values[index].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if(_epoch.load(std::memory_order_relaxed) == stamp) return d == 1.0 ? val : static_cast<T>(val * d);
+    }
+  }
+  T load(const int cluster, const int action_idx) const { return load_by_index(node_value_index(_n_value_actions, cluster, action_idx)); }
 
   void prune(const Action a) {
-    auto& node_atom = _nodes[_compute_action_index(a, _branching_actions)];
-    if(const TreeStorageNode* node = node_atom.load()) {
-      delete node;
+    auto& node_atom = _nodes[_compute_action_index(a, get_branching_actions())];
+    if(TreeStorageNode* node = node_atom.load()) {
+      node->~TreeStorageNode();
       node_atom.store(nullptr);
     }
   }
 
+  // prune records of a cluster, null if the tree does not keep them
+  std::atomic<uint32_t>* get_prune_records(const int cluster) const {
+    if(!(_extras & PRUNE_RECORDS)) return nullptr;
+    return prune_records_data() + node_value_index(_n_value_actions, cluster, 0);
+  }
+
+  // baselines of a cluster, null if the tree does not keep them
+  std::atomic<float>* get_baselines(const int cluster) const {
+    if(!(_extras & BASELINES)) return nullptr;
+    return baselines_data() + node_value_index(_n_value_actions, cluster, 0);
+  }
+
   bool is_allocated(int action_idx) const {
     return _nodes[action_idx].load() != nullptr;
   }
 
   bool is_allocated(const Action a) const {
-    return is_allocated(_compute_action_index(a, _branching_actions));
+    return is_allocated(_compute_action_index(a, get_branching_actions()));
   }
 
   void freeze(const std::vector<int>& regrets, const int cluster) {
     // TODO: freeze the specific action taken, not all actions
-    if(regrets.size() != _value_actions.size()) {
-      Logger::error("Freeze regret amount mismatch: regrets=[" + join_as_strs(regrets, ", ") + "], value_actions=" + actions_to_str(_value_actions));
+    if(regrets.size() != _n_value_actions) {
+      Logger::error("Freeze regret amount mismatch: regrets=[" + join_as_strs(regrets, ", ") + "], value_actions=" + actions_to_str(get_value_actions()));
     }
-    const int idx = node_value_index(_value_actions.size(), cluster, 0);
+    sync_discount();
+    const int idx = node_value_index(_n_value_actions, cluster, 0);
     _frozen.store(idx);
-    for(int a_idx = 0; a_idx < _value_actions.size(); ++a_idx) {
-      _values[idx + a_idx].store(regrets[a_idx]);
+    for(int a_idx = 0; a_idx < _n_value_actions; ++a_idx) {
+      store_by_index(idx + a_idx, regrets[a_idx]);
     }
   }
 
   bool is_frozen(const int cluster, const int action_idx = 0) const {
     const int frozen_idx = _frozen.load();
     if(frozen_idx == -1) return false;
-    const int idx = node_value_index(_value_actions.size(), cluster, action_idx);
-    return idx >= frozen_idx && idx < frozen_idx + _value_actions.size();
+    const int idx = node_value_index(_n_value_actions, cluster, action_idx);
+    return idx >= frozen_idx && idx < frozen_idx + _n_value_actions;
   }
 
-  const std::vector<Action>& get_branching_actions() const { return _branching_actions; }
-  const std::vector<Action>& get_value_actions() const { return _value_actions; }
+  const std::vector<Action>& get_branching_actions() const { return ActionSetPool::get_instance()->get(_branching_id); }
+  const std::vector<Action>& get_value_actions() const { return ActionSetPool::get_instance()->get(_value_id); }
   int get_n_clusters() const { return _n_clusters; }
-  int get_n_values() const { return _value_actions.size() * _n_clusters; }
+  int get_n_values() const { return _n_value_actions * _n_clusters; }
   std::shared_ptr<const TreeStorageConfig> make_config_ptr() const { return _config; }
 
   void set_config(const std::shared_ptr<const TreeStorageConfig>& config) {
     _config = config;
-    for(int a = 0; a < _branching_actions.size(); ++a) {
+    for(int a = 0; a < _n_branching_actions; ++a) {
       if(TreeStorageNode* child = _nodes[a].load()) {
         child->set_config(config);
       }
     }
   }
 
-  void lcfr_discount(double d) {
-    for(int i = 0; i < get_n_values(); ++i) {
-      _values[i].store(_values[i].load(std::memory_order_relaxed) * d, std::memory_order_relaxed);
-    }
-    for(int a = 0; a < _branching_actions.size(); ++a) {
-      if(TreeStorageNode* child = _nodes[a].load()) {
-        child->lcfr_discount(d);
-      }
-    }
+  // O(1), nodes apply the discount lazily. Must not run concurrently with traversals.
+  void lcfr_discount(const double d) {
+    if(!_is_root) Logger::error("Only the root of a storage tree can be discounted.");
+    _shared->discounts.push(d);
   }
 
-  bool operator==(const TreeStorageNode& other) const {
-    if(_n_clusters != other._n_clusters) return false;
-    if(_branching_actions != other._branching_actions) return false;
-    if(_value_actions != other._value_actions) return false;
-    for(int c = 0; c < _n_clusters; ++c) {
-      for(int a = 0; a < _value_actions.size(); ++a) {
-        if(get(c, a)->load() != other.get(c, a)->load()) return false;
-      }
-    }
-    for(int a = 0; a < _branching_actions.size(); ++a) {
-      TreeStorageNode* lhs = _nodes[a].load();
-      TreeStorageNode* rhs = other._nodes[a].load();
-      if(lhs && rhs) {
-        if(!(*lhs == *rhs)) return false;
+  // applies pending discounts to the values of this node, thread safe
+  void sync_discount() {
+    if(!_shared) return;
+    const int epoch = _shared->discounts.epoch();
+    uint16_t stamp = _epoch.load(std::memory_order_acquire);
+    while(stamp != epoch) {
+      if(stamp & EPOCH_BUSY) {
+        stamp = _epoch.load(std::memory_order_acquire);
       }
-      else if(lhs || rhs) {
-        return false;
+      else if(_epoch.compare_exchange_weak(stamp, stamp | EPOCH_BUSY, std::memory_order_acquire)) {
+        apply_discount(_shared->discounts.factor(stamp));
+        _epoch.store(epoch, std::memory_order_release);
+        return;
       }
     }
-    return true;
+  }
+
+  // compares the subtrees in parallel
+  bool operator==(const TreeStorageNode& other) const {
+    std::atomic<bool> equal = true;
+    TreeVisitor<const TreeStorageNode, const TreeStorageNode*> visitor;
+    visitor.set_aux(&other, [](const TreeStorageNode* rhs, const int a_idx) { return rhs->apply_index(a_idx); })
+        ->set_pre([&equal](const TreeStorageNode* lhs, const auto& info) {
+          if(!equal.load(std::memory_order_relaxed)) return false;
+          if(!lhs->node_equals(*info.aux)) {
+            equal.store(false, std::memory_order_relaxed);
+            return false;
+          }
+          return true;
+        });
+    visitor.visit(this);
+    return equal.load();
   }
 
   template <class Archive>
   void save(Archive& ar) const {
-    ar(_branching_actions, _value_actions, _frozen, _n_clusters, _is_root);
+    ar(get_branching_actions(), get_value_actions(), _frozen, _n_clusters, _is_root);
     if(_is_root) ar(_config);
     for(int c = 0; c < _n_clusters; ++c) {
-      for(int a = 0; a < _value_actions.size(); ++a) {
-        ar(_values[node_value_index(_value_actions.size(), c, a)]);
+      for(int a = 0; a < _n_value_actions; ++a) {
+        const T val = load(c, a);
+        ar(val);
       }
     }
-    for(int a = 0; a < _branching_actions.size(); ++a) {
+    for(int a = 0; a < _n_branching_actions; ++a) {
       TreeStorageNode* child = _nodes[a].load();
       bool has_child = child != nullptr;
       ar(has_child);
@@ -266,79 +494,485 @@ public:
   template <class Archive>
   void load(Archive& ar) {
     free_memory();
-    // ar(_branching_actions, _value_actions, _frozen, _n_clusters, _is_root);
-    ar(_branching_actions, _value_actions, _n_clusters, _is_root); // TODO: compatibility
-    if(_is_root) ar(_config);
+    std::vector<Action> branching_actions;
+    std::vector<Action> value_actions;
+    // ar(branching_actions, value_actions, _frozen, _n_clusters, _is_root);
+    ar(branching_actions, value_actions, _n_clusters, _is_root); // TODO: compatibility
+    if(!_is_root) Logger::error("Only the root of a storage tree can be loaded directly.");
+    set_action_ids(ActionSetPool::get_instance()->intern(branching_actions), ActionSetPool::get_instance()->intern(value_actions));
+    ar(_config);
+    delete _shared;
+    _shared = new TreeShared();
+    init_data(nullptr);
+    load_data(ar);
+  }
+
+  // Sharded serialization (see snapshot.hpp). Children at shard_depth are not written inline, they are collected in pre-order as shard roots and
+  // written separately with save_shard. load_prefix returns the matching (parent, action index) slots that load_shard fills in.
+  template <class Archive>
+  void save_prefix(Archive& ar, const int shard_depth, std::vector<const TreeStorageNode*>& shards) const {
+    if(!_is_root) Logger::error("Only the root of a storage tree can be saved as a prefix.");
+    const auto precision = static_cast<uint8_t>(_quantized ? RegretPrecision::INT16 : RegretPrecision::INT32);
+    ar(_config, _extras, precision);
+    save_record(ar, 0, shard_depth, shards);
+  }
+
+  // version is the snapshot format version, prune records and baselines were added in version 2 and the regret precision in version 3
+  template <class Archive>
+  void load_prefix(Archive& ar, std::vector<std::pair<TreeStorageNode*, int>>& slots, const uint32_t version) {
+    if(!_is_root) Logger::error("Only the root of a storage tree can be loaded as a prefix.");
+    free_memory();
+    std::vector<Action> branching_actions;
+    std::vector<Action> value_actions;
+    int frozen;
+    uint8_t extras = 0;
+    auto precision = static_cast<uint8_t>(RegretPrecision::INT32);
+    ar(_config);
+    if(version >= 2) ar(extras);
+    if(version >= 3) ar(precision);
+    if(extras || precision != static_cast<uint8_t>(RegretPrecision::INT32)) {
+      auto config = std::make_shared<TreeStorageConfig>(*_config);
+      config->prune_records = extras & PRUNE_RECORDS;
+      config->baselines = extras & BASELINES;
+      config->regret_precision = static_cast<RegretPrecision>(precision);
+      _config = config;
+    }
+    ar(branching_actions, value_actions, _n_clusters, frozen);
+    set_action_ids(ActionSetPool::get_instance()->intern(branching_actions), ActionSetPool::get_instance()->intern(value_actions));
+    _frozen.store(frozen);
+    delete _shared;
+    _shared = new TreeShared();
+    init_data(nullptr);
+    load_record_data(ar, slots);
+  }
+
+  template <class Archive>
+  void save_shard(Archive& ar) const {
+    std::vector<const TreeStorageNode*> shards;
+    save_record(ar, 0, -1, shards);
+  }
+
+  // thread safe for distinct slots
+  template <class Archive>
+  void load_shard(Archive& ar, const int action_idx) {
+    std::vector<std::pair<TreeStorageNode*, int>> slots;
+    _nodes[action_idx].store(load_child_record(ar, slots));
+  }
+
+  // Moves all nodes into a single arena slab in layout order. Pending discounts are applied. Root only, not thread safe, pointers to other
+  // nodes of the tree are invalidated.
+  void compact(const TreeLayout layout = TreeLayout::DFS) {
+    if(!_is_root) Logger::error("Only the root of a storage tree can be compacted.");
+    if(!_shared) return;
+    std::vector<TreeStorageNode*> order;
+    if(layout == TreeLayout::DFS) collect_dfs(this, order);
+    else collect_veb(this, subtree_height(), order);
+
+    size_t slab_bytes = data_layout(get_n_values(), _n_branching_actions, _n_clusters, _quantized, _extras).bytes + alignof(TreeStorageNode);
+    for(int i = 1; i < order.size(); ++i) slab_bytes += align_up(order[i]->block_bytes(), alignof(TreeStorageNode));
+    // growing the compacted tree continues on regular slabs
+    auto* shared = new TreeShared();
+    shared->arena.reserve(slab_bytes);
+
+    sync_discount();
+    std::atomic<TreeStorageNode*>* old_nodes = _nodes;
+    const std::atomic<T>* old_values = _values;
+    std::swap(_shared, shared);
+    init_data(nullptr);
+    copy_values(old_values);
+
+    std::unordered_map<const TreeStorageNode*, TreeStorageNode*> moved;
+    moved.reserve(order.size());
+    moved[this] = this;
+    for(int i = 1; i < order.size(); ++i) {
+      TreeStorageNode* node = order[i];
+      node->sync_discount();
+      TreeStorageNode* copy = make_child(node->_branching_id, node->_value_id, node->_n_clusters);
+      copy->_frozen.store(node->_frozen.load());
+      copy->copy_values(node->_values);
+      moved[node] = copy;
+    }
+    for(TreeStorageNode* node : order) {
+      std::atomic<TreeStorageNode*>* children = node == this ? old_nodes : node->_nodes;
+      for(int a = 0; a < node->_n_branching_actions; ++a) {
+        if(TreeStorageNode* child = children[a].load()) moved[node]->_nodes[a].store(moved[child]);
+      }
+    }
+
+    for(int a = 0; a < _n_branching_actions; ++a) {
+      if(TreeStorageNode* child = old_nodes[a].load()) child->~TreeStorageNode();
+    }
+    delete shared;
+  }
+
+  const TreeArena* get_arena() const { return &_shared->arena; }
+  // node header and data bytes, the arena block of every node but the root
+  size_t node_bytes() const {
+    return header_bytes() + data_layout(get_n_values(), _n_branching_actions, _n_clusters, _quantized, _extras).bytes;
+  }
+  bool is_quantized() const { return _quantized; }
+  bool has_prune_records() const { return _extras & PRUNE_RECORDS; }
+  bool has_baselines() const { return _extras & BASELINES; }
+
+private:
+  struct DataLayout {
+    size_t values_offset;
+    size_t records_offset;
+    size_t baselines_offset;
+    size_t bytes;
+  };
+
+  static constexpr uint16_t EPOCH_BUSY = 1 << 15;
+
+  static constexpr size_t header_bytes() { return align_up(sizeof(TreeStorageNode), alignof(std::atomic<TreeStorageNode*>)); }
+
+  static bool uses_quantized_regrets(const TreeStorageConfig* config) {
+    return std::is_same_v<T, int> && config && config->regret_precision == RegretPrecision::INT16;
+  }
+
+  // optional per value arrays of regret trees, stored after the values in this order
+  enum Extra : uint8_t { PRUNE_RECORDS = 1, BASELINES = 2 };
+
+  static uint8_t config_extras(const TreeStorageConfig* config) {
+    if(!std::is_same_v<T, int> || !config) return 0;
+    return (config->prune_records ? PRUNE_RECORDS : 0) | (config->baselines ? BASELINES : 0);
+  }
+
+  static DataLayout data_layout(const size_t n_values, const size_t n_branching, const size_t n_clusters, const bool quantized, const uint8_t extras) {
+    const size_t nodes_bytes = n_branching * sizeof(std::atomic<TreeStorageNode*>);
+    size_t values_offset;
+    size_t values_end;
+    if(quantized) {
+      values_offset = align_up(nodes_bytes, alignof(std::atomic<int16_t>));
+      values_end = values_offset + n_values * sizeof(std::atomic<int16_t>) + n_clusters * sizeof(std::atomic<uint8_t>);
+    }
+    else {
+      values_offset = align_up(nodes_bytes, alignof(std::atomic<T>));
+      values_end = values_offset + n_values * sizeof(std::atomic<T>);
+    }
+    const size_t records_offset = align_up(values_end, alignof(std::atomic<uint32_t>));
+    const size_t records_end = extras & PRUNE_RECORDS ? records_offset + n_values * sizeof(std::atomic<uint32_t>) : values_end;
+    const size_t baselines_offset = align_up(records_end, alignof(std::atomic<float>));
+    const size_t baselines_end = extras & BASELINES ? baselines_offset + n_values * sizeof(std::atomic<float>) : records_end;
+    return DataLayout{values_offset, records_offset, baselines_offset, baselines_end};
+  }
+
+  TreeStorageNode(const ActionSetPool::Id branching_id, const ActionSetPool::Id value_id, const int n_clusters,
+      const std::shared_ptr<const TreeStorageConfig>& config, TreeShared* shared, char* data, const bool is_root)
+      : _n_clusters{n_clusters},
+        _config{config},
+        _shared{shared},
+        _is_root{is_root} {
+    set_action_ids(branching_id, value_id);
+    init_data(data);
+  }
+
+  void set_action_ids(const ActionSetPool::Id branching_id, const ActionSetPool::Id value_id) {
+    _branching_id = branching_id;
+    _value_id = value_id;
+    _n_branching_actions = get_branching_actions().size();
+    _n_value_actions = get_value_actions().size();
+  }
+
+  TreeStorageNode* make_child(const ActionSetPool::Id branching_id, const ActionSetPool::Id value_id, const int n_clusters) const {
+    const ActionSetPool* pool = ActionSetPool::get_instance();
+    const DataLayout layout = data_layout(n_clusters * pool->get(value_id).size(), pool->get(branching_id).size(), n_clusters,
+        uses_quantized_regrets(_config.get()), config_extras(_config.get()));
+    char* block = static_cast<char*>(_shared->arena.allocate(header_bytes() + layout.bytes, alignof(TreeStorageNode)));
+    return new (block) TreeStorageNode{branching_id, value_id, n_clusters, _config, _shared, block + header_bytes(), false};
+  }
+
+  void discard_child(TreeStorageNode* child) const {
+    const size_t bytes = child->node_bytes();
+    child->~TreeStorageNode();
+    _shared->arena.release(child, bytes);
+  }
 
-    _values = std::make_unique<std::atomic<T>[]>(get_n_values());
-    _nodes = std::make_unique<std::atomic<TreeStorageNode*>[]>(_branching_actions.size());
-    _locks = std::make_unique<SpinLock[]>(_branching_actions.size());
+  void init_data(char* data) {
+    _quantized = uses_quantized_regrets(_config.get());
+    _extras = config_extras(_config.get());
+    const DataLayout layout = data_layout(get_n_values(), _n_branching_actions, _n_clusters, _quantized, _extras);
+    if(!data) data = static_cast<char*>(_shared->arena.allocate(layout.bytes, alignof(std::atomic<TreeStorageNode*>)));
+    _epoch.store(_shared->discounts.epoch());
+    _nodes = reinterpret_cast<std::atomic<TreeStorageNode*>*>(data);
+    _values = reinterpret_cast<std::atomic<T>*>(data + layout.values_offset);
+    for(int i = 0; i < _n_branching_actions; ++i) new (&_nodes[i]) std::atomic<TreeStorageNode*>{nullptr};
+    if(_quantized) {
+      auto q_values = reinterpret_cast<std::atomic<int16_t>*>(_values);
+      for(int i = 0; i < get_n_values(); ++i) new (&q_values[i]) std::atomic<int16_t>{0};
+      auto shifts = reinterpret_cast<std::atomic<uint8_t>*>(q_values + get_n_values());
+      for(int c = 0; c < _n_clusters; ++c) new (&shifts[c]) std::atomic<uint8_t>{0};
+    }
+    else {
+      for(int i = 0; i < get_n_values(); ++i) new (&_values[i]) std::atomic<T>{T{0}};
+    }
+    if(_extras & PRUNE_RECORDS) {
+      auto records = reinterpret_cast<std::atomic<uint32_t>*>(data + layout.records_offset);
+      for(int i = 0; i < get_n_values(); ++i) new (&records[i]) std::atomic<uint32_t>{0};
+    }
+    if(_extras & BASELINES) {
+      auto baselines = reinterpret_cast<std::atomic<float>*>(data + layout.baselines_offset);
+      for(int i = 0; i < get_n_values(); ++i) new (&baselines[i]) std::atomic<float>{0.0f};
+    }
+  }
+
+  size_t block_bytes() const {
+    return header_bytes() + data_layout(get_n_values(), _n_branching_actions, _n_clusters, _quantized, _extras).bytes;
+  }
+
+  std::atomic<uint32_t>* prune_records_data() const {
+    const DataLayout layout = data_layout(get_n_values(), _n_branching_actions, _n_clusters, _quantized, _extras);
+    return reinterpret_cast<std::atomic<uint32_t>*>(reinterpret_cast<char*>(_nodes) + layout.records_offset);
+  }
+
+  std::atomic<float>* baselines_data() const {
+    const DataLayout layout = data_layout(get_n_values(), _n_branching_actions, _n_clusters, _quantized, _extras);
+    return reinterpret_cast<std::atomic<float>*>(reinterpret_cast<char*>(_nodes) + layout.baselines_offset);
+  }
+
+  // raw copy of the values (and row scales, extras) of a node with the same layout
+  void copy_values(const std::atomic<T>* values) {
+    const DataLayout layout = data_layout(get_n_values(), _n_branching_actions, _n_clusters, _quantized, _extras);
+    std::memcpy(static_cast<void*>(_values), values, layout.bytes - layout.values_offset);
+  }
+
+  int subtree_height() const {
+    int height = 0;
+    for(int a = 0; a < _n_branching_actions; ++a) {
+      if(const TreeStorageNode* child = _nodes[a].load()) height = std::max(height, child->subtree_height());
+    }
+    return height + 1;
+  }
+
+  static void collect_dfs(TreeStorageNode* node, std::vector<TreeStorageNode*>& order) {
+    order.push_back(node);
+    for(int a = 0; a < node->_n_branching_actions; ++a) {
+      if(TreeStorageNode* child = node->_nodes[a].load()) collect_dfs(child, order);
+    }
+  }
+
+  static void collect_at_depth(TreeStorageNode* node, const int depth, std::vector<TreeStorageNode*>& nodes) {
+    if(depth == 0) {
+      nodes.push_back(node);
+      return;
+    }
+    for(int a = 0; a < node->_n_branching_actions; ++a) {
+      if(TreeStorageNode* child = node->_nodes[a].load()) collect_at_depth(child, depth - 1, nodes);
+    }
+  }
+
+  // nodes of the subtree above the given height, top half first followed by each of the bottom subtrees
+  static void collect_veb(TreeStorageNode* node, const int height, std::vector<TreeStorageNode*>& order) {
+    if(height == 1) {
+      order.push_back(node);
+      return;
+    }
+    const int top_height = height / 2;
+    collect_veb(node, top_height, order);
+    std::vector<TreeStorageNode*> bottoms;
+    collect_at_depth(node, top_height, bottoms);
+    for(TreeStorageNode* bottom : bottoms) collect_veb(bottom, height - top_height, order);
+  }
 
+  RegretRow raw_regret_row(const int cluster) const requires std::is_same_v<T, int> {
+    if(!_quantized) return RegretRow{const_cast<std::atomic<int>*>(get(cluster))};
+    auto q_values = reinterpret_cast<std::atomic<int16_t>*>(_values);
+    auto shifts = reinterpret_cast<std::atomic<uint8_t>*>(q_values + get_n_values());
+    return RegretRow{q_values + node_value_index(_n_value_actions, cluster, 0), shifts + cluster, _n_value_actions};
+  }
+
+  // epoch stamp of the node, waits for a concurrent sync_discount
+  uint16_t stable_epoch() const {
+    uint16_t stamp = _epoch.load(std::memory_order_acquire);
+    while(stamp & EPOCH_BUSY) stamp = _epoch.load(std::memory_order_acquire);
+    return stamp;
+  }
+
+  // product of the discounts a node stamped with the given epoch has not applied yet
+  double pending_discount(const uint16_t stamp) const {
+    if(!_shared || stamp == _shared->discounts.epoch()) return 1.0;
+    return _shared->discounts.factor(stamp);
+  }
+
+  void apply_discount(const double d) {
+    if constexpr(std::is_same_v<T, int>) {
+      if(_quantized) {
+        for(int c = 0; c < _n_clusters; ++c) raw_regret_row(c).discount(d);
+        return;
+      }
+    }
+    for(int i = 0; i < get_n_values(); ++i) {
+      _values[i].store(_values[i].load(std::memory_order_relaxed) * d, std::memory_order_relaxed);
+    }
+  }
+
+  void store_by_index(const int index, const T val) {
+    if constexpr(std::is_same_v<T, int>) {
+      if(_quantized) {
+        get_regret_row(index / _n_value_actions).store(index % _n_value_actions, val);
+        return;
+      }
+    }
+    _values[index].store(val);
+  }
+
+  // values and allocated children, without the subtrees
+  bool node_equals(const TreeStorageNode& other) const {
+    if(_n_clusters != other._n_clusters) return false;
+    if(_branching_id != other._branching_id) return false;
+    if(_value_id != other._value_id) return false;
+    for(int c = 0; c < _n_clusters; ++c) {
+      for(int a = 0; a < _n_value_actions; ++a) {
+        if(load(c, a) != other.load(c, a)) return false;
+      }
+    }
+    for(int a = 0; a < _n_branching_actions; ++a) {
+      if(is_allocated(a) != other.is_allocated(a)) return false;
+    }
+    return true;
+  }
+
+  template <class Archive>
+  void load_data(Archive& ar) {
     for(int c = 0; c < _n_clusters; ++c) {
-      for(int a = 0; a < _value_actions.size(); ++a) {
+      for(int a = 0; a < _n_value_actions; ++a) {
         T val;
         ar(val);
-        _values[node_value_index(_value_actions.size(), c, a)].store(val);
+        store_by_index(node_value_index(_n_value_actions, c, a), val);
       }
     }
 
-    for(int a = 0; a < _branching_actions.size(); ++a) {
+    for(int a = 0; a < _n_branching_actions; ++a) {
       bool has_child;
       ar(has_child);
-      if(has_child) {
-        auto child = new TreeStorageNode();
-        ar(*child);
-        _nodes[a].store(child);
+      _nodes[a].store(has_child ? load_child(ar) : nullptr);
+    }
+  }
+
+  template <class Archive>
+  TreeStorageNode* load_child(Archive& ar) const {
+    std::vector<Action> branching_actions;
+    std::vector<Action> value_actions;
+    int n_clusters;
+    bool is_root;
+    ar(branching_actions, value_actions, n_clusters, is_root); // TODO: compatibility
+    ActionSetPool* pool = ActionSetPool::get_instance();
+    TreeStorageNode* child = make_child(pool->intern(branching_actions), pool->intern(value_actions), n_clusters);
+    child->load_data(ar);
+    return child;
+  }
+
+  enum class ChildRecord : uint8_t { NONE, INLINE, SHARD };
+
+  template <class Archive>
+  void save_record(Archive& ar, const int depth, const int shard_depth, std::vector<const TreeStorageNode*>& shards) const {
+    const int frozen = _frozen.load();
+    ar(get_branching_actions(), get_value_actions(), _n_clusters, frozen);
+    for(int i = 0; i < get_n_values(); ++i) {
+      const T val = load_by_index(i);
+      ar(val);
+    }
+    if(_extras & PRUNE_RECORDS) {
+      const std::atomic<uint32_t>* records = prune_records_data();
+      for(int i = 0; i < get_n_values(); ++i) {
+        const uint32_t record = records[i].load(std::memory_order_relaxed);
+        ar(record);
       }
-      else {
-        _nodes[a].store(nullptr);
+    }
+    if(_extras & BASELINES) {
+      const std::atomic<float>* baselines = baselines_data();
+      for(int i = 0; i < get_n_values(); ++i) {
+        const float baseline = baselines[i].load(std::memory_order_relaxed);
+        ar(baseline);
       }
     }
+    for(int a = 0; a < _n_branching_actions; ++a) {
+      const TreeStorageNode* child = _nodes[a].load();
+      const ChildRecord record = !child ? ChildRecord::NONE : depth + 1 == shard_depth ? ChildRecord::SHARD : ChildRecord::INLINE;
+      ar(static_cast<uint8_t>(record));
+      if(record == ChildRecord::INLINE) child->save_record(ar, depth + 1, shard_depth, shards);
+      else if(record == ChildRecord::SHARD) shards.push_back(child);
+    }
+  }
 
-    if(_is_root) set_config(_config);
+  template <class Archive>
+  void load_record_data(Archive& ar, std::vector<std::pair<TreeStorageNode*, int>>& slots) {
+    for(int i = 0; i < get_n_values(); ++i) {
+      T val;
+      ar(val);
+      store_by_index(i, val);
+    }
+    if(_extras & PRUNE_RECORDS) {
+      std::atomic<uint32_t>* records = prune_records_data();
+      for(int i = 0; i < get_n_values(); ++i) {
+        uint32_t record;
+        ar(record);
+        records[i].store(record, std::memory_order_relaxed);
+      }
+    }
+    if(_extras & BASELINES) {
+      std::atomic<float>* baselines = baselines_data();
+      for(int i = 0; i < get_n_values(); ++i) {
+        float baseline;
+        ar(baseline);
+        baselines[i].store(baseline, std::memory_order_relaxed);
+      }
+    }
+    for(int a = 0; a < _n_branching_actions; ++a) {
+      uint8_t byte;
+      ar(byte);
+      const auto record = static_cast<ChildRecord>(byte);
+      if(record == ChildRecord::INLINE) _nodes[a].store(load_child_record(ar, slots));
+      else if(record == ChildRecord::SHARD) slots.emplace_back(this, a);
+    }
   }
 
-private:
-  TreeStorageNode(const SlimPokerState& state, const std::shared_ptr<const TreeStorageConfig>& config, const bool is_root)
-      : _branching_actions{config->action_mode.branching_actions(state)},
-        _value_actions{config->action_mode.value_actions(state)},
-        _n_clusters{config->cluster_spec.n_clusters(state.get_round())},
-        _config{config},
-        _values{std::make_unique<std::atomic<T>[]>(get_n_values())},
-        _nodes{std::make_unique<std::atomic<TreeStorageNode*>[]>(_branching_actions.size())},
-        _locks{std::make_unique<SpinLock[]>(_branching_actions.size())},
-        _is_root{is_root} {
-    for(int i = 0; i < get_n_values(); ++i) _values[i].store(T{0}, std::memory_order_relaxed);
-    for(int i = 0; i < _branching_actions.size(); ++i) _nodes[i].store(nullptr, std::memory_order_relaxed);
+  template <class Archive>
+  TreeStorageNode* load_child_record(Archive& ar, std::vector<std::pair<TreeStorageNode*, int>>& slots) const {
+    std::vector<Action> branching_actions;
+    std::vector<Action> value_actions;
+    int n_clusters;
+    int frozen;
+    ar(branching_actions, value_actions, n_clusters, frozen);
+    ActionSetPool* pool = ActionSetPool::get_instance();
+    TreeStorageNode* child = make_child(pool->intern(branching_actions), pool->intern(value_actions), n_clusters);
+    child->_frozen.store(frozen);
+    child->load_record_data(ar, slots);
+    return child;
   }
 
   void free_memory() {
     if(!_nodes) return;
-    for(int a_idx = 0; a_idx < _branching_actions.size(); ++a_idx) {
+    for(int a_idx = 0; a_idx < _n_branching_actions; ++a_idx) {
       auto& node_atom = _nodes[a_idx];
-      if(const TreeStorageNode* node = node_atom.load()) {
-        delete node;
+      if(TreeStorageNode* node = node_atom.load()) {
+        node->~TreeStorageNode();
         node_atom.store(nullptr);
       }
     }
   }
 
-  std::vector<Action> _branching_actions;
-  std::vector<Action> _value_actions;
   std::atomic<int> _frozen = -1;
   int _n_clusters;
   std::shared_ptr<const TreeStorageConfig> _config;
 
-  std::unique_ptr<std::atomic<T>[]> _values;
-  std::unique_ptr<std::atomic<TreeStorageNode*>[]> _nodes;
-  std::unique_ptr<SpinLock[]> _locks;
+  TreeShared* _shared = nullptr;
+  std::atomic<TreeStorageNode*>* _nodes = nullptr;
+  std::atomic<T>* _values = nullptr;
+  ActionSetPool::Id _branching_id = 0;
+  ActionSetPool::Id _value_id = 0;
+  uint8_t _n_branching_actions = 0;
+  uint8_t _n_value_actions = 0;
   bool _is_root;
+  bool _quantized = false;
+  uint8_t _extras = 0;
+  std::atomic<uint16_t> _epoch = 0;
 };
 
-template<class T>
+template<class T, class NodeT = TreeStorageNode<T>>
 class Strategy : public ConfigProvider {
 public:
-  virtual const TreeStorageNode<T>* get_strategy() const = 0;
+  virtual const NodeT* get_strategy() const = 0;
 };
 
 }
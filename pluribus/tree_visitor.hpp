@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <variant>
+#include <vector>
+#include <omp.h>
+#include <pluribus/actions.hpp>
+#include <pluribus/poker.hpp>
+
+namespace pluribus {
+
+// One slot per OpenMP thread of the current team, combined after the parallel region. Slots are padded to separate cache lines.
+template <class T>
+class PerThread {
+public:
+  explicit PerThread(const T& init = T{}) : _slots(omp_get_max_threads(), Slot{init}) {}
+
+  T& local() { return _slots[omp_get_thread_num()].value; }
+
+  template <class F>
+  void for_each(F&& f) {
+    for(auto& slot : _slots) f(slot.value);
+  }
+
+  template <class F>
+  T reduce(T init, F&& f) const {
+    for(const auto& slot : _slots) init = f(std::move(init), slot.value);
+    return init;
+  }
+
+private:
+  struct alignas(64) Slot {
+    T value;
+  };
+
+  std::vector<Slot> _slots;
+};
+
+// Path information of the visited node. state and history are only set if the visitor tracks them, aux is derived from the parent's aux by the
+// descend hook (e.g. the matching node of a second tree).
+template <class Aux>
+struct VisitInfo {
+  int depth = 0;
+  int action_idx = -1; // branching action index in the parent, -1 at the root
+  std::optional<SlimPokerState> state;
+  std::optional<ActionHistory> history;
+  Aux aux{};
+};
+
+// Parallel pre/post-order walk over the allocated nodes of a storage tree. Children of nodes above the task depth are visited as OpenMP tasks,
+// which idle threads steal from each other, deeper subtrees are walked serially by the task that reached them. Hooks run concurrently and must
+// only write to the visited node, its subtree or thread local state (see PerThread). A pre hook that returns false skips the node's children
+// and its post hook. Children are enumerated after the pre hook, so pre hooks may prune. The first exception thrown by a hook stops the walk
+// and is rethrown by visit.
+template <class NodeT, class Aux = std::monostate>
+class TreeVisitor {
+public:
+  using Info = VisitInfo<Aux>;
+  using PreHook = std::function<bool(NodeT*, const Info&)>;
+  using PostHook = std::function<void(NodeT*, const Info&)>;
+  using DescendHook = std::function<Aux(const Aux&, int)>;
+
+  TreeVisitor* set_pre(PreHook pre) { _pre = std::move(pre); return this; }
+  TreeVisitor* set_post(PostHook post) { _post = std::move(post); return this; }
+  TreeVisitor* set_aux(const Aux& root_aux, DescendHook descend) { _root_aux = root_aux; _descend = std::move(descend); return this; }
+  TreeVisitor* track_state(const SlimPokerState& root_state) { _root_state = root_state; return this; }
+  TreeVisitor* track_history(const ActionHistory& root_history) { _root_history = root_history; return this; }
+  TreeVisitor* set_task_depth(const int depth) { _task_depth = depth; return this; }
+
+  void visit(NodeT* root) const {
+    Info info;
+    info.state = _root_state;
+    info.history = _root_history;
+    info.aux = _root_aux;
+    Run run;
+    #pragma omp parallel
+    #pragma omp single
+    visit_node(root, info, run);
+    if(run.error) std::rethrow_exception(run.error);
+  }
+
+private:
+  struct Run {
+    std::atomic<bool> failed = false;
+    std::exception_ptr error;
+    std::mutex mutex;
+
+    void fail(std::exception_ptr e) {
+      std::lock_guard lock{mutex};
+      if(!error) error = std::move(e);
+      failed.store(true, std::memory_order_relaxed);
+    }
+  };
+
+  Info descend(NodeT* parent, const int action_idx, const Info& info) const {
+    const Action a = parent->get_branching_actions()[action_idx];
+    Info next;
+    next.depth = info.depth + 1;
+    next.action_idx = action_idx;
+    if(info.state) next.state = info.state->apply_copy(a);
+    if(info.history) {
+      next.history = *info.history;
+      next.history->push_back(a);
+    }
+    if(_descend) next.aux = _descend(info.aux, action_idx);
+    return next;
+  }
+
+  void visit_child(NodeT* parent, NodeT* child, const int action_idx, const Info& info, Run& run) const {
+    if(run.failed.load(std::memory_order_relaxed)) return;
+    try {
+      visit_node(child, descend(parent, action_idx, info), run);
+    }
+    catch(...) {
+      run.fail(std::current_exception());
+    }
+  }
+
+  void visit_node(NodeT* node, const Info& info, Run& run) const {
+    if(run.failed.load(std::memory_order_relaxed)) return;
+    try {
+      if(_pre && !_pre(node, info)) return;
+    }
+    catch(...) {
+      run.fail(std::current_exception());
+      return;
+    }
+    const bool spawn = info.depth < _task_depth;
+    const int n_actions = static_cast<int>(node->get_branching_actions().size());
+    for(int a_idx = 0; a_idx < n_actions; ++a_idx) {
+      if(!node->is_allocated(a_idx)) continue;
+      NodeT* child = node->apply_index(a_idx);
+      if(spawn) {
+        #pragma omp task default(shared) firstprivate(child, a_idx)
+        visit_child(node, child, a_idx, info, run);
+      }
+      else {
+        visit_child(node, child, a_idx, info, run);
+      }
+    }
+    if(spawn) {
+      #pragma omp taskwait
+    }
+    if(!_post || run.failed.load(std::memory_order_relaxed)) return;
+    try {
+      _post(node, info);
+    }
+    catch(...) {
+      run.fail(std::current_exception());
+    }
+  }
+
+  PreHook _pre;
+  PostHook _post;
+  DescendHook _descend;
+  Aux _root_aux{};
+  std::optional<SlimPokerState> _root_state;
+  std::optional<ActionHistory> _root_history;
+  int _task_depth = 4;
+};
+
+}
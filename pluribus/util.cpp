@@ -41,7 +41,8 @@ bool create_dir(const std::filesystem::path& path) {
     if(std::filesystem::exists(path)) {
         return true;
     }
-    return std::filesystem::create_directory(path);
+    // another process may create the directory between the two calls
+    return std::filesystem::create_directory(path) || std::filesystem::is_directory(path);
   }
   catch(const std::exception& e) {
     std::cerr << "Error creating directory: " << e.what() << std::endl;
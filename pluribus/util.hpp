@@ -30,8 +30,8 @@ std::string join_as_strs(const std::vector<T>& vals, const std::string& sep) {
   return oss.str();
 }
 
-template <class T> 
-int index_of(T e, const std::vector<T>& v) {
+template <class T, class Range>
+int index_of(T e, const Range& v) {
   auto it = std::find(v.begin(), v.end(), e);
   if(it == v.end()) throw std::runtime_error("Failed to find element in vector of " + std::to_string(v.size()) + " elements."); 
   return std::distance(v.begin(), it);
@@ -1 +1,34 @@
+#include <cstdlib>
+#include <new>
+#include <pluribus/actions.hpp>
+#include <pluribus/profiles.hpp>
 #include <test/lib.hpp>
+
+namespace {
+  thread_local long n_allocations = 0;
+}
+
+long testlib::thread_allocations() {
+  return n_allocations;
+}
+
+testlib::HeadsUpTree testlib::heads_up_tree(const RegretPrecision precision, const bool prune_records, const bool baselines) {
+  const SolverConfig config{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}};
+  const auto tree_config = std::make_shared<const TreeStorageConfig>(TreeStorageConfig{ClusterSpec{169, 200, 200, 200},
+      ActionMode::make_blueprint_mode(config.action_profile), precision, prune_records, baselines});
+  return HeadsUpTree{config, tree_config, SlimPokerState{config.init_state}};
+}
+
+void* operator new(const std::size_t size) {
+  ++n_allocations;
+  if(void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
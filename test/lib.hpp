@@ -1,13 +1,27 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <cereal/cereal.hpp>
 #include <cereal/types/vector.hpp>
+#include <pluribus/config.hpp>
 #include <pluribus/poker.hpp>
+#include <pluribus/tree_storage.hpp>
 
 using namespace pluribus;
 
 namespace testlib {
+  // number of operator new calls on the calling thread, the test binary replaces the global operator new to count them
+  long thread_allocations();
+
+  // heads up spot of the blueprint profile with 100bb stacks, the blueprint tree config over it and its root state
+  struct HeadsUpTree {
+    SolverConfig config;
+    std::shared_ptr<const TreeStorageConfig> tree_config;
+    SlimPokerState state;
+  };
+  HeadsUpTree heads_up_tree(RegretPrecision precision = RegretPrecision::INT32, bool prune_records = false, bool baselines = false);
+
   struct UtilityTestCase {
     SlimPokerState state;
     std::vector<Hand> hands;
@@ -3,11 +3,18 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <random>
 #include <set>
 #include <string>
+#include <thread>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
@@ -19,20 +26,29 @@
 #include <pluribus/actions.hpp>
 #include <pluribus/agent.hpp>
 #include <pluribus/blueprint.hpp>
+#include <pluribus/calc.hpp>
 #include <pluribus/cereal_ext.hpp>
 #include <pluribus/cluster.hpp>
 #include <pluribus/debug.hpp>
+#include <pluribus/distributed.hpp>
 #include <pluribus/dist.hpp>
 #include <pluribus/earth_movers_dist.hpp>
 #include <pluribus/ev.hpp>
+#include <pluribus/flat_storage.hpp>
+#include <pluribus/hash_storage.hpp>
 #include <pluribus/indexing.hpp>
+#include <pluribus/lbr.hpp>
 #include <pluribus/mccfr.hpp>
 #include <pluribus/poker.hpp>
+#include <pluribus/pruning.hpp>
 #include <pluribus/rng.hpp>
 #include <pluribus/sampling.hpp>
 #include <pluribus/simulate.hpp>
+#include <pluribus/snapshot.hpp>
+#include <pluribus/static_storage.hpp>
 #include <pluribus/translate.hpp>
 #include <pluribus/traverse.hpp>
+#include <pluribus/tree_visitor.hpp>
 #include <pluribus/util.hpp>
 
 #include "lib.hpp"
@@ -278,6 +294,49 @@ TEST_CASE("Side pot", "[poker]") {
   REQUIRE(utility_vector(leftover_allin, board, hands, chips, no_rake) == expected_util);
 }
 
+TEST_CASE("Valid action mask", "[poker]") {
+  const RingBlueprintProfile profile{3};
+  const ActionMode mode = ActionMode::make_blueprint_mode(profile);
+  long n_states = 0;
+  std::function<void(const SlimPokerState&, int)> check = [&](const SlimPokerState& state, const int depth) {
+    if(state.is_terminal() || depth == 0) return;
+    ++n_states;
+    const std::vector<Action>& actions = profile.get_actions(state);
+    const uint16_t mask = valid_action_mask(state, actions);
+    for(int a_idx = 0; a_idx < actions.size(); ++a_idx) {
+      REQUIRE(static_cast<bool>(mask >> a_idx & 1) == is_action_valid(actions[a_idx], state));
+    }
+    const std::vector<Action> valid = valid_actions(state, profile);
+    REQUIRE(masked_actions(actions, mask) == valid);
+    REQUIRE(mode.branching_actions(state) == valid);
+    REQUIRE(mode.value_id(state) == ActionSetPool::get_instance()->intern(valid));
+    for(const Action a : valid) check(state.apply_copy(a), depth - 1);
+  };
+  check(SlimPokerState{3, std::vector{10'000, 2'500, 800}}, 7);
+  REQUIRE(n_states > 1'000);
+}
+
+TEST_CASE("Showdown ranks", "[poker]") {
+  const std::vector hands{Hand{"QcQh"}, Hand{"AcAh"}, Hand{"KcKh"}};
+  const Board board{"2c2h7d8s3h"};
+  const omp::HandEvaluator eval;
+  const ShowdownRanks ranks{board, hands, eval};
+  REQUIRE(ranks.score(1) > ranks.score(2));
+  REQUIRE(ranks.score(2) > ranks.score(0));
+
+  const std::vector chips = {2'000, 1'000, 500};
+  const SlimPokerState state{3, chips, 0, false};
+  const SlimPokerState allin = state.apply_copy({
+    Action::CHECK_CALL, Action::CHECK_CALL, Action::CHECK_CALL,
+    Action::ALL_IN, Action::CHECK_CALL, Action::CHECK_CALL
+  });
+  REQUIRE(ranks.best(allin.get_players()) == ranks.score(1));
+  const RakeStructure rake{0.05, 100};
+  for(int i = 0; i < 3; ++i) {
+    REQUIRE(utility(allin, i, ranks, chips[i], rake) == utility(allin, i, board, hands, chips[i], rake, eval));
+  }
+}
+
 std::vector<int> pokerkit_utiltiies(const std::string& line, const int n_players) {
   std::istringstream iss(line);
   std::vector<int> util(n_players);
@@ -510,6 +569,84 @@ TEST_CASE("Round sampler", "[sampling][slow]") {
   test_sampler_mask(sampler, SamplingMode::IMPORTANCE_RANDOM_WALK, dead_cards);
 }
 
+TEST_CASE("Seeded random streams", "[sampling]") {
+  const auto draw = [](const uint64_t seed, const long t, const int i) {
+    FastRNG::seed(seed, t, i);
+    std::vector<uint64_t> values;
+    for(int k = 0; k < 16; ++k) values.push_back(FastRNG::uniform_int(52));
+    values.push_back(FastRNG::uniform() * 1e9);
+    return values;
+  };
+  REQUIRE(draw(7, 3, 1) == draw(7, 3, 1));
+  REQUIRE(draw(7, 3, 1) != draw(7, 3, 2));
+  REQUIRE(draw(7, 3, 1) != draw(7, 4, 1));
+  REQUIRE(draw(7, 3, 1) != draw(8, 3, 1));
+  const auto draw_stream = [](const uint64_t stream) {
+    FastRNG::seed(7, 3, 1, stream);
+    return FastRNG::uniform_int(1UL << 62);
+  };
+  FastRNG::seed(7, 3, 1);
+  const uint64_t unstreamed = FastRNG::uniform_int(1UL << 62);
+  REQUIRE(draw_stream(0) == unstreamed);
+  REQUIRE(draw_stream(5) == draw_stream(5));
+  REQUIRE(draw_stream(5) != draw_stream(6));
+  REQUIRE(draw_stream(5) != draw_stream(0));
+
+  const DiscreteDist dist{{0.0, 1.0, 3.0, 0.0, 4.0}};
+  std::array<int, 5> counts{};
+  const int n = 100'000;
+  for(int k = 0; k < n; ++k) ++counts[dist.sample()];
+  REQUIRE(counts[0] == 0);
+  REQUIRE(counts[3] == 0);
+  REQUIRE_THAT(counts[1] / static_cast<double>(n), WithinAbs(0.125, 0.01));
+  REQUIRE_THAT(counts[2] / static_cast<double>(n), WithinAbs(0.375, 0.01));
+  REQUIRE_THAT(counts[4] / static_cast<double>(n), WithinAbs(0.5, 0.01));
+}
+
+namespace pluribus {
+
+template <template<typename> class StorageT>
+void call_run_iteration(MCCFRSolver<StorageT>* trainer, const long t) {
+  trainer->run_iteration(t, t, std::chrono::high_resolution_clock::now());
+}
+
+}
+
+TEST_CASE("Allocation free training iteration", "[mccfr][slow]") {
+  TreeBlueprintSolver trainer{SolverConfig{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}}};
+  trainer.set_seed(42);
+  // grows the tree and sets up the deal buffers, thread local samplers and interned action sets
+  trainer.solve(100'000);
+  const long n_allocations = thread_allocations();
+  // no strategy update, log or discount step in between
+  for(long t = 100'001; t < 101'000; ++t) call_run_iteration(&trainer, t);
+  REQUIRE(thread_allocations() == n_allocations);
+}
+
+TEST_CASE("Deal buffer", "[sampling]") {
+  const std::vector ranges(3, PokerRange::full());
+  MarginalRejectionSampler sampler{ranges};
+  const auto cluster = [](const int r, const Board& board, const Hand& hand, CachedIndexer& indexer) {
+    return static_cast<int>(indexer.index(board, hand, r) % 200);
+  };
+  DealBuffer deals{8};
+  for(int k = 0; k < 20; ++k) {
+    const IterationScratch& deal = deals.next(sampler, {}, 1, cluster);
+    REQUIRE(deal.sample.hands.size() == 3);
+    REQUIRE(deal.clusters[0].empty());
+    uint64_t mask = deal.board.mask();
+    for(int h_idx = 0; h_idx < 3; ++h_idx) {
+      const Hand& hand = deal.sample.hands[h_idx];
+      REQUIRE((mask & hand.mask()) == 0);
+      mask |= hand.mask();
+      for(int r = 1; r < 4; ++r) {
+        REQUIRE(deal.clusters[r][h_idx] == HandIndexer::get_instance()->index(deal.board, hand, r) % 200);
+      }
+    }
+  }
+  REQUIRE(deals.generation_ns() > 0);
+}
+
 TEST_CASE("Lossless monte carlo EV", "[ev][slow][dependency]") {
   long N = 10'000'000;
   LosslessBlueprint bp;
@@ -528,6 +665,969 @@ TEST_CASE("Lossless monte carlo EV", "[ev][slow][dependency]") {
   REQUIRE(abs(enum_ev - mc_result.ev) / enum_ev < 0.03);
 }
 
+TEST_CASE("Range showdown", "[lbr]") {
+  const Board board{"2c2h7d8s3h"};
+  const omp::HandEvaluator eval;
+  ComboRanks combos;
+  combos.evaluate(board, eval);
+  const std::vector hands{Hand{"QcQh"}, Hand{"AcAh"}, Hand{"KcKh"}, Hand{"QdQs"}};
+  const ShowdownRanks ranks{board, hands, eval};
+  const HoleCardIndexer* indexer = HoleCardIndexer::get_instance();
+  for(int h_idx = 0; h_idx < hands.size(); ++h_idx) REQUIRE(combos.ranks[indexer->index(hands[h_idx])] == ranks.score(h_idx));
+  REQUIRE(combos.live[indexer->index(Hand{"2dAs"})] == 1.0f);
+  REQUIRE(combos.live[indexer->index(Hand{"2cAs"})] == 0.0f);
+
+  std::vector<float> weights(MAX_COMBOS, 0.0f);
+  weights[indexer->index(Hand{"AcAh"})] = 1.0f;
+  weights[indexer->index(Hand{"KcKh"})] = 2.0f;
+  weights[indexer->index(Hand{"QdQs"})] = 1.0f;
+  weights[indexer->index(Hand{"2cAs"})] = 5.0f; // blocked by the board
+  double value = 0.0, total = 0.0;
+  combos.showdown(ranks.score(0), weights.data(), value, total);
+  REQUIRE_THAT(total, WithinAbs(4.0, 1e-6));
+  REQUIRE_THAT(value, WithinAbs(0.5, 1e-6));
+}
+
+// folds whenever it can, checks otherwise
+class FoldingDecision : public DecisionAlgorithm {
+public:
+  explicit FoldingDecision(const ActionProfile& profile) : _profile{profile} {}
+
+  float frequency(const Action a, const PokerState& state, const Board& board, const Hand& hand) const override {
+    const std::vector<Action> actions = valid_actions(state, _profile);
+    const bool can_fold = std::ranges::find(actions, Action::FOLD) != actions.end();
+    return a == (can_fold ? Action::FOLD : Action::CHECK_CALL) ? 1.0f : 0.0f;
+  }
+
+private:
+  const ActionProfile _profile;
+};
+
+TEST_CASE("Local best response", "[lbr]") {
+  const SolverConfig config{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}};
+  const FoldingDecision decision{config.action_profile};
+  LBRConfig lbr_config;
+  lbr_config.hands = 200;
+  const LocalBestResponse lbr{decision, config, lbr_config};
+  const std::vector hands{Hand{"7d2c"}, Hand{"AcAh"}};
+  const Board board{"KsQs3d4h9c"};
+  const omp::HandEvaluator eval;
+  // the small blind raises and wins the big blind, the big blind wins the small blind when it folds
+  const double u_0 = lbr.play(0, hands, board, eval);
+  const double u_1 = lbr.play(1, hands, board, eval);
+  REQUIRE(std::min(u_0, u_1) == 50.0);
+  REQUIRE(std::max(u_0, u_1) == 100.0);
+  const ResultEV result = lbr.evaluate();
+  REQUIRE(result.iterations == 200);
+  REQUIRE_THAT(result.ev, WithinAbs(75.0, 10.0));
+  REQUIRE_THAT(to_mbb(75.0), WithinAbs(750.0, 1e-9));
+}
+
+TEST_CASE("Regret matching kernels", "[calc]") {
+  std::mt19937 rng{42};
+  std::uniform_int_distribution<int> regret_dist{-1'000, 1'000};
+  std::uniform_real_distribution<float> u01{0.0f, 1.0f};
+  for(int n = 1; n <= MAX_ACTIONS; ++n) {
+    for(int k = 0; k < 200; ++k) {
+      std::vector<int> regrets(n);
+      for(int& r : regrets) r = k % 10 == 0 ? -std::abs(regret_dist(rng)) : regret_dist(rng);
+      std::vector<float> expected(n);
+      float sum = 0.0f;
+      for(int a_idx = 0; a_idx < n; ++a_idx) sum += expected[a_idx] = std::max(regrets[a_idx], 0);
+      for(float& f : expected) f = sum > 0 ? f / sum : 1.0f / n;
+
+      float freq[MAX_ACTIONS];
+      regret_matching(regrets.data(), n, freq);
+      const std::vector<float> float_regrets(regrets.begin(), regrets.end());
+      float float_freq[MAX_ACTIONS];
+      regret_matching(float_regrets.data(), n, float_freq);
+      for(int a_idx = 0; a_idx < n; ++a_idx) {
+        REQUIRE_THAT(freq[a_idx], WithinAbs(expected[a_idx], 1e-6));
+        REQUIRE(float_freq[a_idx] == freq[a_idx]);
+      }
+
+      const float threshold = u01(rng) * (sum > 0 ? sum : 1.0f);
+      float cumsum = 0.0f;
+      int expected_idx = n - 1;
+      for(int a_idx = 0; a_idx < n; ++a_idx) {
+        cumsum += std::max(regrets[a_idx], 0);
+        if(cumsum >= threshold) {
+          expected_idx = a_idx;
+          break;
+        }
+      }
+      float weights[MAX_ACTIONS];
+      positive_part(regrets.data(), n, weights);
+      REQUIRE(sample_cumulative(weights, n, threshold) == expected_idx);
+    }
+  }
+
+  const int n_rows = 37, n_cols = 5;
+  std::vector<int> block(n_rows * n_cols);
+  for(int& r : block) r = regret_dist(rng);
+  std::fill_n(block.begin(), n_cols, -1);
+  std::vector<float> rows(block.size());
+  regret_matching_rows(block.data(), n_rows, n_cols, rows.data());
+  std::vector<float> float_rows(block.begin(), block.end());
+  regret_matching_rows(float_rows.data(), n_rows, n_cols, float_rows.data());
+  for(int r = 0; r < n_rows; ++r) {
+    float freq[MAX_ACTIONS];
+    regret_matching(block.data() + r * n_cols, n_cols, freq);
+    for(int c = 0; c < n_cols; ++c) {
+      REQUIRE_THAT(rows[r * n_cols + c], WithinAbs(freq[c], 1e-6));
+      REQUIRE(float_rows[r * n_cols + c] == rows[r * n_cols + c]);
+    }
+  }
+  REQUIRE(rows[0] == 1.0f / n_cols);
+}
+
+#if defined(__AVX2__)
+// only compiled by builds configured with -DNATIVE=ON on an AVX2 host, other builds have no AVX2 kernels
+TEST_CASE("AVX2 regret matching kernels", "[calc]") {
+  std::mt19937 rng{7};
+  std::uniform_int_distribution<int> regret_dist{-1'000'000, 1'000'000};
+  std::uniform_real_distribution<float> u01{0.0f, 1.0f};
+  for(int n = 1; n <= MAX_ACTIONS; ++n) {
+    for(int k = 0; k < 200; ++k) {
+      std::vector<int> regrets(n);
+      for(int& r : regrets) r = k % 10 == 0 ? -std::abs(regret_dist(rng)) : regret_dist(rng);
+      const std::vector<float> float_regrets(regrets.begin(), regrets.end());
+      float expected[MAX_ACTIONS], actual[MAX_ACTIONS];
+      const float sum = kernel::scalar::positive_part(regrets.data(), n, expected);
+      REQUIRE_THAT(kernel::avx2::positive_part(regrets.data(), n, actual), WithinAbs(sum, 1e-6 * std::max(sum, 1.0f)));
+      for(int a_idx = 0; a_idx < n; ++a_idx) REQUIRE(actual[a_idx] == expected[a_idx]);
+
+      kernel::scalar::regret_matching(regrets.data(), n, expected);
+      kernel::avx2::regret_matching(regrets.data(), n, actual);
+      for(int a_idx = 0; a_idx < n; ++a_idx) REQUIRE_THAT(actual[a_idx], WithinAbs(expected[a_idx], 1e-6));
+      kernel::scalar::regret_matching(float_regrets.data(), n, expected);
+      kernel::avx2::regret_matching(float_regrets.data(), n, actual);
+      for(int a_idx = 0; a_idx < n; ++a_idx) REQUIRE_THAT(actual[a_idx], WithinAbs(expected[a_idx], 1e-6));
+
+      // thresholds away from the prefix sums, where the summation order of the kernels could decide the index
+      float weights[MAX_ACTIONS];
+      kernel::scalar::positive_part(regrets.data(), n, weights);
+      float cumsum = 0.0f;
+      for(int a_idx = 0; a_idx < n; ++a_idx) {
+        const float threshold = cumsum + (0.1f + 0.8f * u01(rng)) * weights[a_idx];
+        if(weights[a_idx] > 0.0f) REQUIRE(kernel::avx2::sample_cumulative(weights, n, threshold) == a_idx);
+        cumsum += weights[a_idx];
+      }
+      REQUIRE(kernel::avx2::sample_cumulative(weights, n, cumsum + 1.0f) == kernel::scalar::sample_cumulative(weights, n, cumsum + 1.0f));
+    }
+  }
+}
+#endif
+
+TEST_CASE("Tree storage arena", "[tree]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  TreeStorageNode<int> root{state, tree_config};
+  const long root_bytes = root.get_arena()->bytes_allocated();
+  REQUIRE(root_bytes > 0);
+
+  const int n_actions = root.get_branching_actions().size();
+  std::vector<TreeStorageNode<int>*> children(n_actions * 4);
+  #pragma omp parallel for schedule(static, 1)
+  for(int i = 0; i < children.size(); ++i) {
+    const int a_idx = i % n_actions;
+    children[i] = root.apply_index(a_idx, state.apply_copy(root.get_branching_actions()[a_idx]));
+  }
+  for(int i = 0; i < children.size(); ++i) {
+    REQUIRE(children[i] == children[i % n_actions]);
+    REQUIRE(children[i]->get_n_values() > 0);
+    REQUIRE(children[i]->get(children[i]->get_n_clusters() - 1, children[i]->get_value_actions().size() - 1)->load() == 0);
+  }
+  REQUIRE(root.get_arena()->bytes_allocated() > root_bytes);
+
+  root.get(168, 0)->store(5);
+  children[0]->get(0, 0)->store(7);
+  REQUIRE(root.get(168, 0)->load() == 5);
+  REQUIRE(root.apply_index(0)->get(0, 0)->load() == 7);
+
+  const size_t pruned_bytes = children[0]->node_bytes();
+  root.prune(root.get_branching_actions()[0]);
+  REQUIRE(!root.is_allocated(0));
+  REQUIRE(root.is_allocated(n_actions - 1));
+  // the pruned child's block stays in the arena, node_bytes only counts live nodes
+  size_t live_bytes = root_bytes;
+  for(int a_idx = 1; a_idx < n_actions; ++a_idx) live_bytes += root.apply_index(a_idx)->node_bytes();
+  REQUIRE(root.get_arena()->bytes_allocated() >= live_bytes + pruned_bytes);
+
+  TreeArena arena;
+  arena.allocate(24);
+  const size_t allocated = arena.bytes_allocated();
+  for(int i = 0; i < 4; ++i) {
+    void* ptr = arena.allocate(40, 64);
+    REQUIRE(arena.bytes_allocated() > allocated + 40);
+    REQUIRE(arena.release(ptr, 40));
+    REQUIRE(!arena.release(ptr, 40));
+    REQUIRE(arena.bytes_allocated() == allocated);
+  }
+}
+
+TEST_CASE("Interned action sets", "[tree]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  TreeStorageNode<int> lhs{state, tree_config};
+  TreeStorageNode<int> rhs{state, tree_config};
+  REQUIRE(lhs.get_branching_actions() == valid_actions(state, config.action_profile));
+  REQUIRE(&lhs.get_branching_actions() == &rhs.get_branching_actions());
+  REQUIRE(&lhs.get_value_actions() == &rhs.get_value_actions());
+
+  const size_t pool_size = ActionSetPool::get_instance()->size();
+  const SlimPokerState next_state = state.apply_copy(lhs.get_branching_actions()[0]);
+  const TreeStorageNode<int>* lhs_child = lhs.apply_index(0, next_state);
+  const TreeStorageNode<int>* rhs_child = rhs.apply_index(0, next_state);
+  REQUIRE(&lhs_child->get_branching_actions() == &rhs_child->get_branching_actions());
+  REQUIRE(ActionSetPool::get_instance()->size() <= pool_size + 1);
+  REQUIRE(TreeStorageNode<int>{}.get_branching_actions().empty());
+}
+
+// regret matching self play on a skewed rock paper scissors game, stored in the first two rows of a regret tree. Returns the exploitability
+// of the average strategy of the first player.
+double rps_self_play_exploitability(const RegretPrecision precision, const int iterations, long& regret_bytes) {
+  const std::array<std::array<int, 3>, 3> payoffs{{{0, -1, 2}, {1, 0, -1}, {-2, 1, 0}}};
+  const auto [config, tree_config, state] = heads_up_tree(precision);
+  TreeStorageNode<int> root{state, tree_config};
+  regret_bytes = root.get_arena()->bytes_allocated();
+  std::array<double, 3> avg{0.0, 0.0, 0.0};
+  for(int t = 1; t <= iterations; ++t) {
+    const std::array<std::vector<float>, 2> freq{calculate_strategy(root.get_row(0), 3), calculate_strategy(root.get_row(1), 3)};
+    for(int p = 0; p < 2; ++p) {
+      std::array<double, 3> u{0.0, 0.0, 0.0};
+      double v = 0.0;
+      for(int a = 0; a < 3; ++a) {
+        for(int o = 0; o < 3; ++o) u[a] += 10'000.0 * payoffs[a][o] * freq[1 - p][o];
+        v += freq[p][a] * u[a];
+      }
+      RegretRow regrets = root.get_regret_row(p);
+      for(int a = 0; a < 3; ++a) regrets.add(a, static_cast<int>(std::lrint(u[a] - v)));
+    }
+    for(int a = 0; a < 3; ++a) avg[a] += t * freq[0][a];
+    if(t % 100 == 0 && t <= 2'000) root.lcfr_discount(static_cast<double>(t / 100) / (t / 100 + 1));
+  }
+  const double norm = avg[0] + avg[1] + avg[2];
+  double best_response = 0.0;
+  for(int a = 0; a < 3; ++a) {
+    double u = 0.0;
+    for(int o = 0; o < 3; ++o) u += payoffs[a][o] * avg[o] / norm;
+    best_response = std::max(best_response, u);
+  }
+  return best_response;
+}
+
+TEST_CASE("Quantized regret storage", "[tree]") {
+  const auto [config, tree_config, state] = heads_up_tree(RegretPrecision::INT16);
+  TreeStorageNode<int> root{state, tree_config};
+  REQUIRE(root.is_quantized());
+  RegretRow regrets = root.get_regret_row(3);
+  regrets.add(0, 1'000);
+  regrets.add(1, -25'000);
+  REQUIRE(regrets.load(0) == 1'000);
+  REQUIRE(regrets.load(1) == -25'000);
+  regrets.add(0, 200'000'000);
+  REQUIRE_THAT(regrets.load(0), Catch::Matchers::WithinRel(200'001'000.0, 1e-4));
+  REQUIRE(regrets.load(1) < 0);
+  regrets.store(2, -300'000'000);
+  REQUIRE_THAT(regrets.load(2), Catch::Matchers::WithinRel(-300'000'000.0, 1e-4));
+  root.lcfr_discount(0.5);
+  REQUIRE_THAT(root.load(3, 2), Catch::Matchers::WithinRel(-150'000'000.0, 1e-4));
+  REQUIRE_THAT(root.get_regret_row(3).load(2), Catch::Matchers::WithinRel(-150'000'000.0, 1e-4));
+  REQUIRE(root.get_regret_row(4).load(0) == 0);
+
+  const SlimPokerState next_state = state.apply_copy(root.get_branching_actions()[0]);
+  root.apply_index(0, next_state)->get_regret_row(7).add(1, 5'000);
+  REQUIRE(root.apply_index(0)->load(7, 1) == 5'000);
+
+  // rounding draws from the seeded stream
+  std::array<int, 2> rounded;
+  for(int k = 0; k < rounded.size(); ++k) {
+    FastRNG::seed(42, 7, 0);
+    RegretRow row = root.get_regret_row(5 + k);
+    row.store(0, 1 << 24);
+    for(int n = 0; n < 64; ++n) row.add(0, 1'001);
+    rounded[k] = row.load(0);
+  }
+  REQUIRE(rounded[0] == rounded[1]);
+  REQUIRE_THAT(rounded[0], Catch::Matchers::WithinRel((1 << 24) + 64 * 1'001.0, 1e-3));
+
+  // halving the row on a rescale keeps odd values in expectation
+  std::array<std::atomic<int16_t>, 2> q_values;
+  std::atomic<uint8_t> shift;
+  constexpr int trials = 4'000;
+  long rescaled_sum = 0;
+  for(int t = 0; t < trials; ++t) {
+    q_values[0].store(std::numeric_limits<int16_t>::max());
+    q_values[1].store(1);
+    shift.store(0);
+    RegretRow row{q_values.data(), &shift, 2};
+    row.add(0, 1);
+    REQUIRE(shift.load() == 1);
+    rescaled_sum += row.load(1);
+  }
+  REQUIRE_THAT(static_cast<double>(rescaled_sum) / trials, WithinAbs(1.0, 0.1));
+
+  long wide_bytes, quantized_bytes;
+  const double wide_expl = rps_self_play_exploitability(RegretPrecision::INT32, 20'000, wide_bytes);
+  const double quantized_expl = rps_self_play_exploitability(RegretPrecision::INT16, 20'000, quantized_bytes);
+  REQUIRE(quantized_bytes < 0.6 * wide_bytes);
+  REQUIRE(wide_expl < 0.02);
+  REQUIRE(quantized_expl < 0.04);
+}
+
+TEST_CASE("Lazy LCFR discount", "[tree]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  TreeStorageNode<int> root{state, tree_config};
+  const SlimPokerState next_state = state.apply_copy(root.get_branching_actions()[1]);
+  TreeStorageNode<int>* child = root.apply_index(1, next_state);
+  root.get(5, 0)->store(1'000);
+  child->get(7, 1)->store(-4'000);
+
+  root.lcfr_discount(0.5);
+  root.lcfr_discount(0.5);
+  REQUIRE(std::as_const(*child).get(7, 1)->load() == -4'000);
+  REQUIRE(child->load(7, 1) == -1'000);
+  REQUIRE(root.load(5, 0) == 250);
+
+  #pragma omp parallel for
+  for(int i = 0; i < 64; ++i) child->get_regret_row(7).load(1);
+  REQUIRE(std::as_const(*child).get(7, 1)->load() == -1'000);
+  REQUIRE(child->get(7, 1)->load() == -1'000);
+
+  const SlimPokerState other_state = state.apply_copy(root.get_branching_actions()[2]);
+  TreeStorageNode<int>* new_child = root.apply_index(2, other_state);
+  new_child->get(0, 0)->store(100);
+  REQUIRE(new_child->load(0, 0) == 100);
+  root.lcfr_discount(0.5);
+  REQUIRE(new_child->load(0, 0) == 50);
+  REQUIRE(child->load(7, 1) == -500);
+
+  // readers racing a sync see the discount exactly once
+  for(int round = 0; round < 16; ++round) {
+    new_child->get(0, 0)->store(1 << 20);
+    root.lcfr_discount(0.5);
+    std::atomic<bool> consistent = true;
+    #pragma omp parallel for schedule(static, 1)
+    for(int i = 0; i < 64; ++i) {
+      if(i % 8 == 7) new_child->sync_discount();
+      else if(new_child->load(0, 0) != 1 << 19) consistent = false;
+    }
+    REQUIRE(consistent);
+  }
+}
+
+template <class T>
+bool flat_tree_equals(const TreeStorageNode<T>* node, const FlatTreeNode<T>* flat) {
+  if(!std::ranges::equal(node->get_branching_actions(), flat->get_branching_actions())) return false;
+  if(!std::ranges::equal(node->get_value_actions(), flat->get_value_actions())) return false;
+  if(node->get_n_values() != flat->get_n_values()) return false;
+  for(int i = 0; i < node->get_n_values(); ++i) {
+    if(node->get_by_index(i)->load() != flat->get_by_index(i)->load()) return false;
+  }
+  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
+    if(node->is_allocated(a_idx) != flat->is_allocated(a_idx)) return false;
+    if(node->is_allocated(a_idx) && !flat_tree_equals(node->apply_index(a_idx), flat->apply_index(a_idx))) return false;
+  }
+  return true;
+}
+
+TEST_CASE("Flat tree storage", "[tree][serialize]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  TreeStorageNode<float> root{state, tree_config};
+  for(int a_idx = 0; a_idx < root.get_branching_actions().size(); a_idx += 2) {
+    const SlimPokerState next_state = state.apply_copy(root.get_branching_actions()[a_idx]);
+    TreeStorageNode<float>* child = root.apply_index(a_idx, next_state);
+    if(!next_state.is_terminal()) child->apply_index(0, next_state.apply_copy(child->get_branching_actions()[0]));
+    for(int i = 0; i < child->get_n_values(); ++i) child->get_by_index(i)->store(0.5f * i + a_idx);
+  }
+  root.get(42, 1)->store(3.0f);
+
+  const std::string fn = (std::filesystem::temp_directory_path() / "pluribus_test_tree.flat").string();
+  write_flat_tree(root, fn, "meta");
+  {
+    const FlatTree<float> flat{fn};
+    REQUIRE(flat.metadata() == "meta");
+    REQUIRE(flat_tree_equals(&root, flat.root()));
+    REQUIRE(flat.root()->get(42, 1)->load() == 3.0f);
+    REQUIRE(flat.root()->apply(root.get_branching_actions()[0]) == flat.root()->apply_index(0));
+  }
+
+  // child offsets of the root that leave the mapping or point into a record are rejected on open
+  FlatHeader header;
+  std::ifstream{fn, std::ios::binary}.read(reinterpret_cast<char*>(&header), sizeof(header));
+  for(const int64_t offset : {int64_t{1} << 40, static_cast<int64_t>(sizeof(FlatTreeNode<float>)) + 8}) {
+    {
+      std::fstream file{fn, std::ios::binary | std::ios::in | std::ios::out};
+      file.seekp(static_cast<std::streamoff>(header.root_offset + sizeof(FlatTreeNode<float>)));
+      file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    }
+    REQUIRE_THROWS(FlatTree<float>{fn});
+    REQUIRE_NOTHROW(FlatTree<float>(fn, false));
+  }
+  std::filesystem::remove(fn);
+}
+
+template <class T>
+void grow_tree(TreeStorageNode<T>* node, const SlimPokerState& state, const int depth) {
+  for(int i = 0; i < node->get_n_values(); ++i) node->get_by_index(i)->store(static_cast<T>(GlobalRNG::instance()() % 1000));
+  if(depth == 0) return;
+  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
+    const SlimPokerState next_state = state.apply_copy(node->get_branching_actions()[a_idx]);
+    if(!next_state.is_terminal()) grow_tree(node->apply_index(a_idx, next_state), next_state, depth - 1);
+  }
+}
+
+TEST_CASE("Sharded snapshot", "[tree][serialize]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  TreeStorageNode<int> regrets{state, tree_config};
+  TreeStorageNode<float> phi{state, tree_config};
+  grow_tree(&regrets, state, 3);
+  grow_tree(&phi, state, 2);
+  REQUIRE(shard_depth(regrets, 2) == 1);
+  REQUIRE(shard_depth(regrets, count_nodes_at_depth(&regrets, 1) + 1) == 2);
+  REQUIRE(shard_depth(regrets, 1'000'000) == MAX_SHARD_DEPTH);
+
+  const std::string dir = (std::filesystem::temp_directory_path() / "pluribus_test_snapshot").string();
+  std::filesystem::remove_all(dir);
+  {
+    ShardedSnapshotWriter writer{dir, 16};
+    writer.archive()(std::string{"state"});
+    writer.add_tree(regrets);
+    writer.add_tree(phi);
+    writer.write_shards();
+  }
+  REQUIRE(is_sharded_snapshot(dir));
+
+  TreeStorageNode<int> loaded_regrets;
+  TreeStorageNode<float> loaded_phi;
+  {
+    ShardedSnapshotReader reader{dir};
+    std::string loaded_state;
+    reader.archive()(loaded_state);
+    REQUIRE(loaded_state == "state");
+    reader.add_tree(loaded_regrets);
+    reader.add_tree(loaded_phi);
+    reader.read_shards();
+  }
+  REQUIRE(loaded_regrets == regrets);
+  REQUIRE(loaded_phi == phi);
+
+  std::filesystem::path shard_fn;
+  for(const auto& entry : std::filesystem::directory_iterator(dir)) {
+    if(entry.path().filename() != "manifest.bin" && (shard_fn.empty() || entry.file_size() > std::filesystem::file_size(shard_fn))) shard_fn = entry.path();
+  }
+  REQUIRE(std::filesystem::file_size(shard_fn) > sizeof(ShardHeader) + 64);
+  {
+    std::fstream file{shard_fn, std::ios::binary | std::ios::in | std::ios::out};
+    file.seekg(sizeof(ShardHeader) + 64);
+    const char byte = static_cast<char>(file.get());
+    file.seekp(sizeof(ShardHeader) + 64);
+    file.put(static_cast<char>(byte ^ 0x5a));
+  }
+  TreeStorageNode<int> corrupted_regrets;
+  TreeStorageNode<float> corrupted_phi;
+  ShardedSnapshotReader reader{dir};
+  std::string loaded_state;
+  reader.archive()(loaded_state);
+  reader.add_tree(corrupted_regrets);
+  reader.add_tree(corrupted_phi);
+  REQUIRE_THROWS(reader.read_shards());
+  std::filesystem::remove_all(dir);
+}
+
+long count_nodes(const TreeStorageNode<int>* node) {
+  long count = 1;
+  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
+    if(node->is_allocated(a_idx)) count += count_nodes(node->apply_index(a_idx));
+  }
+  return count;
+}
+
+TEST_CASE("Sharded snapshot during training", "[tree][serialize]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  TreeStorageNode<int> regrets{state, tree_config};
+  grow_tree(&regrets, state, 2);
+  const long initial_nodes = count_nodes(&regrets);
+
+  const std::string dir = (std::filesystem::temp_directory_path() / "pluribus_test_async_snapshot").string();
+  std::filesystem::remove_all(dir);
+  auto writer = std::make_shared<ShardedSnapshotWriter>(dir, 8, 2);
+  writer->add_tree(regrets);
+  auto pending = std::async(std::launch::async, [writer] { writer->write_shards(); });
+  grow_tree(&regrets, state, 3);
+  pending.get();
+
+  TreeStorageNode<int> loaded;
+  {
+    ShardedSnapshotReader reader{dir};
+    reader.add_tree(loaded);
+    reader.read_shards();
+  }
+  REQUIRE(count_nodes(&loaded) >= initial_nodes);
+  REQUIRE(count_nodes(&loaded) <= count_nodes(&regrets));
+  REQUIRE(loaded.get_branching_actions() == regrets.get_branching_actions());
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Prune record schedule", "[mccfr]") {
+  constexpr int cutoff = -1000;
+  std::atomic<uint32_t> record = 0;
+  REQUIRE_FALSE(PruneRecord::skip(record, 0, cutoff));
+  REQUIRE_FALSE(PruneRecord::is_pruned(record.load()));
+  for(int level = 0; level < 3; ++level) {
+    for(int v = 0; v < PruneRecord::SKIP_VISITS << level; ++v) REQUIRE(PruneRecord::skip(record, -2000, cutoff));
+    REQUIRE(PruneRecord::level(record.load()) == level);
+    REQUIRE(PruneRecord::is_pruned(record.load()));
+    for(int v = 0; v < PruneRecord::EXPLORE_VISITS; ++v) REQUIRE_FALSE(PruneRecord::skip(record, -2000, cutoff));
+    REQUIRE(PruneRecord::is_exploring(record.load()));
+    REQUIRE_FALSE(PruneRecord::is_pruned(record.load()));
+  }
+  // the regret recovered while the branch was explored
+  REQUIRE(PruneRecord::skip(record, -2000, cutoff));
+  for(int v = 1; v < PruneRecord::SKIP_VISITS << 3; ++v) PruneRecord::skip(record, -2000, cutoff);
+  for(int v = 0; v < PruneRecord::EXPLORE_VISITS; ++v) PruneRecord::skip(record, 0, cutoff);
+  REQUIRE_FALSE(PruneRecord::skip(record, 0, cutoff));
+  REQUIRE_FALSE(PruneRecord::is_pruned(record.load()));
+}
+
+TEST_CASE("Sharded snapshot prune records", "[tree][serialize]") {
+  const auto [config, tree_config, state] = heads_up_tree(RegretPrecision::INT32, true);
+  TreeStorageNode<int> regrets{state, tree_config};
+  grow_tree(&regrets, state, 2);
+  TreeStorageNode<int>* child = regrets.apply_index(1);
+  REQUIRE(regrets.has_prune_records());
+  REQUIRE(child->has_prune_records());
+  REQUIRE(child->get_prune_records(5)[0].load() == 0);
+  PruneRecord::skip(child->get_prune_records(5)[1], -2000, -1000);
+  PruneRecord::skip(regrets.get_prune_records(7)[0], -2000, -1000);
+  const uint32_t child_record = child->get_prune_records(5)[1].load();
+  REQUIRE(PruneRecord::is_pruned(child_record));
+
+  const std::string dir = (std::filesystem::temp_directory_path() / "pluribus_test_prune_records").string();
+  std::filesystem::remove_all(dir);
+  {
+    ShardedSnapshotWriter writer{dir, 2};
+    writer.add_tree(regrets);
+    writer.write_shards();
+  }
+  TreeStorageNode<int> loaded;
+  {
+    ShardedSnapshotReader reader{dir};
+    reader.add_tree(loaded);
+    reader.read_shards();
+  }
+  REQUIRE(loaded == regrets);
+  REQUIRE(loaded.has_prune_records());
+  REQUIRE(loaded.apply_index(1)->get_prune_records(5)[1].load() == child_record);
+  REQUIRE(loaded.get_prune_records(7)[0].load() == regrets.get_prune_records(7)[0].load());
+  REQUIRE(loaded.apply_index(1)->get_prune_records(5)[0].load() == 0);
+  loaded.compact();
+  REQUIRE(loaded.apply_index(1)->get_prune_records(5)[1].load() == child_record);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Sharded snapshot quantized regrets", "[tree][serialize]") {
+  const auto [config, tree_config, state] = heads_up_tree(RegretPrecision::INT16);
+  TreeStorageNode<int> regrets{state, tree_config};
+  grow_tree(&regrets, state, 2);
+  regrets.get_regret_row(3).store(0, 1'000);
+  regrets.apply_index(1)->get_regret_row(5).store(1, -25'000);
+
+  const std::string dir = (std::filesystem::temp_directory_path() / "pluribus_test_quantized_regrets").string();
+  std::filesystem::remove_all(dir);
+  {
+    ShardedSnapshotWriter writer{dir, 2};
+    writer.add_tree(regrets);
+    writer.write_shards();
+  }
+  TreeStorageNode<int> loaded;
+  {
+    ShardedSnapshotReader reader{dir};
+    reader.add_tree(loaded);
+    reader.read_shards();
+  }
+  REQUIRE(loaded.make_config_ptr()->regret_precision == RegretPrecision::INT16);
+  REQUIRE(*loaded.make_config_ptr() == *tree_config);
+  REQUIRE(loaded.is_quantized());
+  REQUIRE(loaded.apply_index(1)->is_quantized());
+  REQUIRE(loaded == regrets);
+  REQUIRE(loaded.apply_index(1)->load(5, 1) == -25'000);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Baseline corrected sampled values", "[mccfr]") {
+  const float freq[] = {0.2f, 0.3f, 0.5f};
+  const std::array values{-300, 100, 700};
+  const int exact = 320; // 0.2 * -300 + 0.3 * 100 + 0.5 * 700
+  std::array<std::atomic<float>, 3> baselines{};
+  const auto set_baselines = [&baselines](const std::array<float, 3>& b) {
+    for(int a_idx = 0; a_idx < 3; ++a_idx) baselines[a_idx].store(b[a_idx]);
+  };
+  REQUIRE(sampled_value(100, 1, freq, 3, nullptr) == 100);
+
+  // the expectation over the sampled action is exact for any baselines, and every sample is exact if the baselines are
+  double expected = 0.0;
+  for(int a_idx = 0; a_idx < 3; ++a_idx) {
+    set_baselines({50.0f, -20.0f, 400.0f});
+    expected += freq[a_idx] * sampled_value(values[a_idx], a_idx, freq, 3, baselines.data());
+    set_baselines({-300.0f, 100.0f, 700.0f});
+    REQUIRE(sampled_value(values[a_idx], a_idx, freq, 3, baselines.data()) == exact);
+  }
+  REQUIRE_THAT(expected, WithinAbs(exact, 1.0));
+
+  // only the sampled baseline moves, toward the sampled value
+  set_baselines({0.0f, 0.0f, 0.0f});
+  sampled_value(100, 1, freq, 3, baselines.data());
+  REQUIRE(baselines[0].load() == 0.0f);
+  REQUIRE(baselines[1].load() > 0.0f);
+  REQUIRE(baselines[1].load() < 100.0f);
+  for(int k = 0; k < 100; ++k) sampled_value(100, 1, freq, 3, baselines.data());
+  REQUIRE_THAT(baselines[1].load(), WithinAbs(100.0, 1.0));
+}
+
+TEST_CASE("Sharded snapshot baselines", "[tree][serialize]") {
+  const auto [config, tree_config, state] = heads_up_tree(RegretPrecision::INT32, true, true);
+  TreeStorageNode<int> regrets{state, tree_config};
+  grow_tree(&regrets, state, 2);
+  TreeStorageNode<int>* child = regrets.apply_index(1);
+  REQUIRE(child->has_baselines());
+  REQUIRE(child->get_baselines(5)[0].load() == 0.0f);
+  child->get_baselines(5)[1].store(-1250.5f);
+  regrets.get_baselines(7)[0].store(300.0f);
+  PruneRecord::skip(child->get_prune_records(5)[1], -2000, -1000);
+
+  const std::string dir = (std::filesystem::temp_directory_path() / "pluribus_test_baselines").string();
+  std::filesystem::remove_all(dir);
+  {
+    ShardedSnapshotWriter writer{dir, 2};
+    writer.add_tree(regrets);
+    writer.write_shards();
+  }
+  TreeStorageNode<int> loaded;
+  {
+    ShardedSnapshotReader reader{dir};
+    reader.add_tree(loaded);
+    reader.read_shards();
+  }
+  REQUIRE(loaded == regrets);
+  REQUIRE(loaded.has_baselines());
+  REQUIRE(loaded.apply_index(1)->get_baselines(5)[1].load() == -1250.5f);
+  REQUIRE(loaded.get_baselines(7)[0].load() == 300.0f);
+  REQUIRE(loaded.apply_index(1)->get_prune_records(5)[1].load() == child->get_prune_records(5)[1].load());
+  loaded.compact();
+  REQUIRE(loaded.apply_index(1)->get_baselines(5)[1].load() == -1250.5f);
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Merge worker deltas", "[tree]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  TreeStorageNode<int> base{state, tree_config};
+  grow_tree(&base, state, 1);
+  // both workers continue from base, worker b reaches nodes that worker a did not allocate
+  auto worker_a = tree_delta<int>(&base, nullptr, state);
+  auto worker_b = tree_delta<int>(&base, nullptr, state);
+  REQUIRE(*worker_a == base);
+  grow_tree(worker_a.get(), state, 1);
+  grow_tree(worker_b.get(), state, 2);
+  const long a_nodes = count_nodes(worker_a.get());
+  std::vector<int> expected(base.get_n_values());
+  for(int i = 0; i < base.get_n_values(); ++i) expected[i] = worker_a->load_by_index(i) + worker_b->load_by_index(i) - base.load_by_index(i);
+  const auto delta_b = tree_delta<int>(worker_b.get(), &base, state);
+  add_tree_values(worker_a.get(), delta_b.get(), state);
+
+  REQUIRE(count_nodes(worker_a.get()) == count_nodes(worker_b.get()));
+  REQUIRE(count_nodes(worker_a.get()) > a_nodes);
+  for(int i = 0; i < base.get_n_values(); ++i) REQUIRE(worker_a->load_by_index(i) == expected[i]);
+  // allocated by the merge, base and worker a are zero there
+  const TreeStorageNode<int>* grandchild = worker_b->apply_index(1)->apply_index(1);
+  for(int i = 0; i < grandchild->get_n_values(); ++i) {
+    REQUIRE(worker_a->apply_index(1)->apply_index(1)->load_by_index(i) == grandchild->load_by_index(i));
+  }
+}
+
+TEST_CASE("Distributed run directory", "[blueprint][slow]") {
+  const SolverConfig config{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}};
+  REQUIRE_THROWS(DistributedTreeBlueprintSolver{DistributedConfig{}, config});
+  DistributedConfig dist_config;
+  dist_config.sync_dir = std::filesystem::temp_directory_path() / "pluribus_test_sync";
+  dist_config.run_id = "run";
+  dist_config.sync_interval = 50'000;
+  std::filesystem::remove_all(dist_config.sync_dir);
+  {
+    DistributedTreeBlueprintSolver solver{dist_config, config};
+    solver.solve(100'000);
+  }
+  // the last round is removed once every worker has merged it
+  REQUIRE(std::filesystem::is_empty(dist_config.sync_dir));
+
+  // deltas left behind by an interrupted run with the same id must not be merged
+  const std::filesystem::path stale_round = dist_config.sync_dir / dist_config.run_id / "round_1";
+  std::filesystem::create_directories(stale_round);
+  std::ofstream{(stale_round / "worker_0.done").string()}.close();
+  DistributedTreeBlueprintSolver solver{dist_config, config};
+  REQUIRE_THROWS(solver.solve(100'000));
+  std::filesystem::remove_all(dist_config.sync_dir);
+}
+
+TEST_CASE("Distributed workers", "[blueprint][slow]") {
+  const SolverConfig config{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}};
+  const SlimPokerState root_state{config.init_state};
+  constexpr long T = 20'000;
+  DistributedConfig dist_config;
+  dist_config.sync_dir = std::filesystem::temp_directory_path() / "pluribus_test_workers";
+  dist_config.n_workers = 2;
+  std::filesystem::remove_all(dist_config.sync_dir);
+  // one thread per solver, seeded solves are only reproducible with a single OpenMP thread
+  const auto solve_concurrently = [](const std::vector<TreeBlueprintSolver*>& solvers) {
+    std::vector<std::thread> threads;
+    for(int s_idx = 0; s_idx < solvers.size(); ++s_idx) {
+      threads.emplace_back([solver = solvers[s_idx], s_idx] {
+        omp_set_num_threads(1);
+        solver->set_seed(42 + s_idx);
+        solver->solve(T);
+      });
+    }
+    for(std::thread& thread : threads) thread.join();
+  };
+  const auto run_workers = [&](const std::string& run_id, const long sync_interval) {
+    std::vector<std::unique_ptr<DistributedTreeBlueprintSolver>> workers;
+    for(int w = 0; w < dist_config.n_workers; ++w) {
+      DistributedConfig worker_config = dist_config;
+      worker_config.worker_idx = w;
+      worker_config.run_id = run_id;
+      worker_config.sync_interval = sync_interval;
+      workers.push_back(std::make_unique<DistributedTreeBlueprintSolver>(worker_config, config));
+    }
+    solve_concurrently({workers[0].get(), workers[1].get()});
+    return workers;
+  };
+
+  // a single merge at the end, both workers hold the sum of two independent solves with the same seeds
+  TreeBlueprintSolver solo_0{config}, solo_1{config};
+  solve_concurrently({&solo_0, &solo_1});
+  const auto expected = tree_delta<int>(solo_0.get_strategy(), nullptr, root_state);
+  add_tree_values(expected.get(), solo_1.get_strategy(), root_state);
+  REQUIRE_FALSE(*expected == *solo_0.get_strategy());
+  for(const auto& worker : run_workers("single", T)) REQUIRE(*worker->get_strategy() == *expected);
+
+  // full precision workers continue from the same merged regrets after every round
+  const auto workers = run_workers("rounds", T / 4);
+  REQUIRE(*workers[0]->get_strategy() == *workers[1]->get_strategy());
+  REQUIRE(std::filesystem::is_empty(dist_config.sync_dir));
+  std::filesystem::remove_all(dist_config.sync_dir);
+}
+
+// dst must have the same structure as src
+template <class T>
+void copy_tree_values(TreeStorageNode<T>* dst, const TreeStorageNode<T>* src) {
+  TreeVisitor<TreeStorageNode<T>, const TreeStorageNode<T>*> copier;
+  copier.set_aux(src, [](const TreeStorageNode<T>* node, const int a_idx) { return node->apply_index(a_idx); })
+      ->set_pre([](TreeStorageNode<T>* node, const auto& info) {
+        for(int i = 0; i < node->get_n_values(); ++i) node->get_by_index(i)->store(info.aux->load_by_index(i));
+        return true;
+      });
+  copier.visit(dst);
+}
+
+TEST_CASE("Parallel tree visitor", "[tree]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  TreeStorageNode<int> regrets{state, tree_config};
+  grow_tree(&regrets, state, 3);
+
+  PerThread<long> visited{0L};
+  std::atomic<bool> paths_match = true;
+  std::mutex mutex;
+  std::set<const TreeStorageNode<int>*> done;
+  bool post_order = true;
+  TreeVisitor<const TreeStorageNode<int>> visitor;
+  visitor.track_state(state)->track_history(ActionHistory{})->set_task_depth(1)
+      ->set_pre([&](const TreeStorageNode<int>* node, const auto& info) {
+        ++visited.local();
+        if(regrets.apply(info.history->get_history()) != node || info.history->size() != info.depth || info.state->is_terminal()) paths_match = false;
+        return true;
+      })
+      ->set_post([&](const TreeStorageNode<int>* node, const auto&) {
+        std::lock_guard lock{mutex};
+        for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
+          if(node->is_allocated(a_idx) && !done.contains(node->apply_index(a_idx))) post_order = false;
+        }
+        done.insert(node);
+      });
+  visitor.visit(&regrets);
+  REQUIRE(visited.reduce(0L, std::plus{}) == count_nodes(&regrets));
+  REQUIRE(done.size() == count_nodes(&regrets));
+  REQUIRE(paths_match);
+  REQUIRE(post_order);
+
+  TreeVisitor<const TreeStorageNode<int>> failing;
+  failing.set_pre([](const TreeStorageNode<int>*, const auto& info) {
+    if(info.depth == 2) Logger::error("Visitor test error.");
+    return true;
+  });
+  REQUIRE_THROWS(failing.visit(&regrets));
+
+  TreeStorageNode<int> copy{state, tree_config};
+  grow_tree(&copy, state, 3);
+  copy_tree_values(&copy, &regrets);
+  REQUIRE(copy == regrets);
+  const auto first_child = [](TreeStorageNode<int>* node) {
+    int a_idx = 0;
+    while(!node->is_allocated(a_idx)) ++a_idx;
+    return std::make_pair(node->get_branching_actions()[a_idx], node->apply_index(a_idx));
+  };
+  TreeStorageNode<int>* child = first_child(&copy).second;
+  TreeStorageNode<int>* deep = first_child(child).second;
+  deep->get_by_index(0)->fetch_add(1);
+  REQUIRE_FALSE(copy == regrets);
+  deep->get_by_index(0)->fetch_sub(1);
+  REQUIRE(copy == regrets);
+  child->prune(first_child(child).first);
+  REQUIRE_FALSE(copy == regrets);
+}
+
+void collect_preorder(const TreeStorageNode<float>* node, std::vector<const TreeStorageNode<float>*>& nodes) {
+  nodes.push_back(node);
+  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
+    if(node->is_allocated(a_idx)) collect_preorder(node->apply_index(a_idx), nodes);
+  }
+}
+
+TEST_CASE("Compact strategy tree", "[tree]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  TreeStorageNode<float> reference{state, tree_config};
+  grow_tree(&reference, state, 3);
+
+  for(const TreeLayout layout : {TreeLayout::DFS, TreeLayout::VEB}) {
+    TreeStorageNode<float> tree{state, tree_config};
+    grow_tree(&tree, state, 3);
+    copy_tree_values(&tree, &reference);
+    tree.lcfr_discount(0.5);
+    tree.compact(layout);
+    reference.lcfr_discount(0.5);
+    REQUIRE(tree == reference);
+    REQUIRE(tree.get_arena()->bytes_reserved() < tree.get_arena()->bytes_allocated() + 4096);
+
+    std::vector<const TreeStorageNode<float>*> nodes;
+    collect_preorder(&tree, nodes);
+    REQUIRE(std::ranges::min(std::vector(nodes.begin() + 1, nodes.end())) == nodes[1]);
+    if(layout == TreeLayout::DFS) REQUIRE(std::ranges::is_sorted(nodes.begin() + 1, nodes.end()));
+
+    // the compacted tree is smaller than a regular slab, so the slab of a new node is sized by the regular schedule
+    const size_t reserved = tree.get_arena()->bytes_reserved();
+    REQUIRE(reserved < (1UL << 20));
+    grow_tree(&tree, state, 4);
+    REQUIRE(tree.get_arena()->bytes_reserved() >= reserved + (1UL << 20));
+  }
+  int a_idx = 0;
+  while(!reference.is_allocated(a_idx)) ++a_idx;
+  REQUIRE_THROWS(reference.apply_index(a_idx)->compact());
+}
+
+TEST_CASE("Static tree storage", "[tree][serialize]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  const auto tree = std::make_unique<StaticTree<int>>(config.init_state, tree_config, 0);
+  REQUIRE(tree->n_nodes() == count_infosets(config.init_state, config.action_profile, 0));
+  std::atomic<long> n_actionsets = 0;
+  std::atomic<long> n_values = 0;
+  tree->for_each_node([&](const StaticTreeNode<int>& node) {
+    n_actionsets += node.get_n_clusters();
+    n_values += node.get_n_values();
+  });
+  REQUIRE(n_actionsets == count_actionsets(config.init_state, config.action_profile, 0));
+  REQUIRE(n_values == tree->n_values());
+
+  StaticTreeNode<int>* root = tree->root();
+  REQUIRE(root->get_branching_actions() == valid_actions(config.init_state, config.action_profile));
+  const SlimPokerState fold_state = SlimPokerState{config.init_state}.apply_copy(Action::FOLD);
+  REQUIRE(fold_state.is_terminal());
+  REQUIRE_FALSE(root->is_allocated(Action::FOLD));
+  const StaticTreeNode<int>* limp = root->apply(Action::CHECK_CALL);
+  const int call_idx = index_of(Action::CHECK_CALL, root->get_branching_actions());
+  REQUIRE(root->apply_index(call_idx + 1)->get_id() == limp->get_id() + 1);
+  REQUIRE_FALSE(limp->is_allocated(Action::CHECK_CALL)); // flop is past max_round
+  REQUIRE(std::as_const(*limp).apply(std::vector<Action>{}) == limp);
+
+  root->get_regret_row(5).add(1, 1'000);
+  root->apply_index(1)->get(7, 0)->store(-4'000);
+  root->lcfr_discount(0.5);
+  REQUIRE(root->load(5, 1) == 500);
+  REQUIRE(root->apply_index(1)->load(7, 0) == -2'000);
+  REQUIRE_THROWS(root->apply_index(1)->lcfr_discount(0.5));
+
+  const std::string fn = (std::filesystem::temp_directory_path() / "pluribus_test_static_tree.bin").string();
+  cereal_save(tree, fn);
+  std::unique_ptr<StaticTree<int>> loaded;
+  cereal_load(loaded, fn);
+  REQUIRE(*loaded == *tree);
+  REQUIRE(loaded->root()->apply_index(1)->load(7, 0) == -2'000);
+  std::filesystem::remove(fn);
+  const auto int16_config = std::make_shared<const TreeStorageConfig>(
+      TreeStorageConfig{tree_config->cluster_spec, tree_config->action_mode, RegretPrecision::INT16});
+  REQUIRE_THROWS(StaticTree<int>{config.init_state, int16_config, 0});
+}
+
+template <class T>
+void insert_preflop(HashedInfoset<T>* node, const SlimPokerState& state) {
+  for(int a_idx = 0; a_idx < node->get_branching_actions().size(); ++a_idx) {
+    const SlimPokerState next_state = state.apply_copy(node->get_branching_actions()[a_idx]);
+    if(!next_state.is_terminal() && next_state.get_round() == 0) insert_preflop(node->apply_index(a_idx, next_state), next_state);
+  }
+}
+
+TEST_CASE("Hashed infoset storage", "[tree][serialize]") {
+  const auto [config, tree_config, state] = heads_up_tree();
+  const long n_infosets = count_infosets(config.init_state, config.action_profile, 0);
+  const size_t n_values = StaticTree<int>{config.init_state, tree_config, 0}.n_values();
+  HashTableConfig table_config{0, 1};
+  while(table_config.n_slots() < 2 * n_infosets) ++table_config.slot_bits;
+  table_config.memory_budget = table_config.n_slots() * sizeof(HashedInfoset<int>) + n_values * sizeof(int);
+  const auto table = std::make_unique<HashTable<int>>(config.init_state, tree_config, table_config);
+
+  HashedInfoset<int>* root = table->root();
+  REQUIRE(root->get_branching_actions() == valid_actions(config.init_state, config.action_profile));
+  const int call_idx = index_of(Action::CHECK_CALL, root->get_branching_actions());
+  REQUIRE_FALSE(root->is_allocated(call_idx));
+  // the lookup gives up after the child keys of the current and every later round
+  REQUIRE_THROWS(std::as_const(*root).apply_index(call_idx));
+  const SlimPokerState limp_state = SlimPokerState{config.init_state}.apply_copy(Action::CHECK_CALL);
+  HashedInfoset<int>* limp = root->apply_index(call_idx, limp_state);
+  REQUIRE(std::as_const(*root).apply(Action::CHECK_CALL) == limp);
+  REQUIRE(root->apply(Action::CHECK_CALL, limp_state) == limp);
+  const SlimPokerState flop_state = limp_state.apply_copy(Action::CHECK_CALL);
+  HashedInfoset<int>* flop = limp->apply(Action::CHECK_CALL, flop_state);
+  REQUIRE(flop->get_round() == 1);
+  REQUIRE(flop->get_n_clusters() == 200);
+  REQUIRE(std::as_const(*limp).apply(Action::CHECK_CALL) == flop);
+  REQUIRE(flop->get_key().hash != limp->get_key().hash);
+
+  root->get_regret_row(5).add(1, 1'000);
+  limp->get(7, 0)->store(-4'000);
+  root->lcfr_discount(0.5);
+  REQUIRE(root->load(5, 1) == 500);
+  REQUIRE(limp->load(7, 0) == -2'000);
+  REQUIRE_THROWS(limp->lcfr_discount(0.5));
+
+  const auto preflop_table = std::make_unique<HashTable<int>>(config.init_state, tree_config, table_config);
+  insert_preflop(preflop_table->root(), SlimPokerState{config.init_state});
+  const HashTableStats stats = preflop_table->get_stats();
+  REQUIRE(stats.used_slots == n_infosets);
+  REQUIRE(stats.n_values == n_values);
+  REQUIRE(stats.collisions == 0);
+  REQUIRE(stats.load_factor() <= 0.5);
+  REQUIRE(stats.max_probe < stats.n_slots);
+  // the flop slot takes values that the preflop tree does not have
+  const auto full_table = std::make_unique<HashTable<int>>(config.init_state, tree_config, table_config);
+  full_table->root()->apply(Action::CHECK_CALL, limp_state)->apply(Action::CHECK_CALL, flop_state);
+  REQUIRE_THROWS(insert_preflop(full_table->root(), SlimPokerState{config.init_state}));
+
+  const std::string fn = (std::filesystem::temp_directory_path() / "pluribus_test_hash_table.bin").string();
+  cereal_save(table, fn);
+  std::unique_ptr<HashTable<int>> loaded;
+  cereal_load(loaded, fn);
+  REQUIRE(*loaded == *table);
+  REQUIRE(loaded->root()->apply(Action::CHECK_CALL)->load(7, 0) == -2'000);
+  std::filesystem::remove(fn);
+}
+
 TEST_CASE("Serialize Hand", "[serialize]") {
   REQUIRE(test_serialization(Hand{"Ac2s"}));
   REQUIRE(test_serialization(Hand{"3h5h"}));
@@ -546,6 +1646,26 @@ TEST_CASE("Serialize PokerState", "[serialize]") {
   state = state.apply(actions);
 
   REQUIRE(test_serialization(state));
+
+  const std::vector chips = {2'000, 1'000, 500};
+  const PokerState side_pots = PokerState{3, chips}.apply({
+    Action::CHECK_CALL, Action::CHECK_CALL, Action::CHECK_CALL, Action::ALL_IN, Action::CHECK_CALL, Action::CHECK_CALL
+  });
+  REQUIRE(side_pots.get_pot().has_side_pots());
+  REQUIRE(test_serialization(side_pots));
+  REQUIRE(test_serialization(PokerState{3}.apply_biases({Action::BIAS_FOLD, Action::BIAS_CALL, Action::BIAS_RAISE})));
+}
+
+TEST_CASE("Fixed vector serialization", "[serialize]") {
+  // inline containers are read and written like the std::vectors of older snapshots
+  const std::vector<int> idxs{0, 2, 5};
+  const std::string fn = "test_serialization.bin";
+  cereal_save(idxs, fn);
+  FixedVector<int, MAX_PLAYERS> loaded;
+  cereal_load(loaded, fn);
+  REQUIRE(loaded.to_vector() == idxs);
+  REQUIRE(test_serialization(loaded));
+  REQUIRE(std::is_trivially_copyable_v<SlimPokerState>);
 }
 
 TEST_CASE("Serialize ActionHistory", "[serialize]") {
@@ -558,6 +1678,13 @@ TEST_CASE("Serialize ActionHistory", "[serialize]") {
   REQUIRE(test_serialization(actions));
 }
 
+TEST_CASE("Serialize RealTimeSolverConfig", "[serialize]") {
+  RealTimeSolverConfig config;
+  config.terminal_round = 2;
+  config.task_depth = 3;
+  REQUIRE(test_serialization(config));
+}
+
 TEST_CASE("Serialize TreeBlueprintSolver", "[serialize][blueprint][slow]") {
   TreeBlueprintSolver trainer{SolverConfig{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}}};
   trainer.solve(1'000'000);
@@ -565,6 +1692,30 @@ TEST_CASE("Serialize TreeBlueprintSolver", "[serialize][blueprint][slow]") {
   REQUIRE(test_serialization(trainer));
 }
 
+TEST_CASE("Task parallel traversal", "[blueprint][slow]") {
+  const auto solve = [](const int task_depth) {
+    auto trainer = std::make_unique<TreeBlueprintSolver>(SolverConfig{PokerConfig{2, 0, false}, HeadsUpBlueprintProfile{10'000}});
+    trainer->set_seed(42);
+    trainer->set_task_depth(task_depth);
+    trainer->solve(100'000);
+    return trainer;
+  };
+  const int n_threads = omp_get_max_threads();
+  omp_set_num_threads(1);
+  const auto tasks = solve(2);
+  const auto tasks_replay = solve(2);
+  const auto sequential = solve(0);
+  omp_set_num_threads(n_threads);
+
+  REQUIRE(*tasks == *tasks_replay);
+  // tasks draw from their own streams, so the solves sample different trajectories of the same distribution
+  REQUIRE(tasks->get_iteration() == sequential->get_iteration());
+  REQUIRE(!(*tasks == *sequential));
+  const long task_nodes = count_nodes(tasks->get_strategy());
+  const long sequential_nodes = count_nodes(sequential->get_strategy());
+  REQUIRE_THAT(static_cast<double>(task_nodes), Catch::Matchers::WithinRel(static_cast<double>(sequential_nodes), 0.1));
+}
+
 TEST_CASE("EMD heuristic - partial mass", "[emd]") {
     constexpr int C = 2;
     const std::vector x = {0, 0}; // both points in cluster 0